@@ -0,0 +1,542 @@
+/** @file
+  Implementation of the allocation layer of the polynomial library.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+#include "cancel.h"
+#include "error_handler.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+/// Size of the emergency reserve.
+#define MEM_RESERVE_SIZE (16u << 20)
+
+/// Emergency reserve or NULL if it is not allocated.
+static _Atomic(void *) reserve = NULL;
+
+/// Do allocations of the calling thread recover from running out of memory.
+static _Thread_local bool recovering = false;
+
+/// Is counting of allocations turned on.
+static bool counting = false;
+
+/// Counters of the calling thread.
+static _Thread_local MemCounters thread_counters;
+
+/// Number of allocations of all of the threads.
+static atomic_uint_least64_t total_allocs;
+
+/// Number of reallocations of all of the threads.
+static atomic_uint_least64_t total_reallocs;
+
+/// Number of freed blocks of all of the threads.
+static atomic_uint_least64_t total_frees;
+
+/// Bytes allocated by all of the threads.
+static atomic_uint_least64_t total_bytes_allocated;
+
+/// Bytes freed by all of the threads.
+static atomic_uint_least64_t total_bytes_freed;
+
+/// Highest number of live bytes.
+static atomic_uint_least64_t total_peak_bytes;
+
+/**
+ * Returns the real size of an allocated block if the C library can tell it.
+ * @param[in] ptr : allocated memory
+ * @param[in] size : requested size, used if the real one is not known
+ * @return size of the block
+ */
+static size_t MemBlockSize(void *ptr, size_t size) {
+#ifdef __GLIBC__
+    (void) size;
+    return malloc_usable_size(ptr);
+#else
+    (void) ptr;
+    return size;
+#endif
+}
+
+/**
+ * Counts memory taken from the system.
+ * @param[in] bytes : number of bytes
+ */
+static void MemCountAllocated(size_t bytes) {
+    thread_counters.bytes_allocated += bytes;
+    uint64_t allocated = atomic_fetch_add_explicit(&total_bytes_allocated,
+                                                   bytes,
+                                                   memory_order_relaxed)
+                         + bytes;
+    uint64_t freed = atomic_load_explicit(&total_bytes_freed,
+                                          memory_order_relaxed);
+    uint64_t live = allocated > freed ? allocated - freed : 0;
+
+    if (live > thread_counters.peak_bytes) {
+        thread_counters.peak_bytes = live;
+    }
+    uint64_t peak = atomic_load_explicit(&total_peak_bytes,
+                                         memory_order_relaxed);
+    while (live > peak
+           && !atomic_compare_exchange_weak_explicit(&total_peak_bytes, &peak,
+                                                     live,
+                                                     memory_order_relaxed,
+                                                     memory_order_relaxed)) {
+    }
+}
+
+/**
+ * Counts memory given back to the system.
+ * @param[in] bytes : number of bytes
+ */
+static void MemCountFreed(size_t bytes) {
+    thread_counters.bytes_freed += bytes;
+    atomic_fetch_add_explicit(&total_bytes_freed, bytes, memory_order_relaxed);
+}
+
+/**
+ * Tries again an allocation or reallocation for which there was not enough
+ * memory, first after giving free memory back to the system. If that fails
+ * too in a watched operation of a thread which recovers from running out of
+ * memory (see #MemRefillReserve) and the memory may be missing, the
+ * operation is cancelled (see #CancelRequest) and NULL is returned.
+ * Otherwise the emergency reserve is freed to complete it, which cancels
+ * the operation as well. Exits if there is still not enough memory.
+ * @param[in] ptr : memory or NULL, unchanged by the failed attempt
+ * @param[in] size : new number of bytes
+ * @param[in] soft : may the memory be missing
+ * @return reallocated memory or NULL
+ */
+static void *MemRetry(void *ptr, size_t size, bool soft) {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+    bool cancel = soft && recovering && CancelWatching();
+    void *result = realloc(ptr, size);
+
+    if (result == NULL && cancel) {
+        CancelRequest(CANCEL_NO_MEMORY);
+    }
+    else if (result == NULL) {
+        void *freed = atomic_exchange(&reserve, NULL);
+        if (freed != NULL) {
+            free(freed);
+            CancelRequest(CANCEL_NO_MEMORY);
+            result = realloc(ptr, size);
+        }
+        CHECK_PTR(result);
+    }
+    return result;
+}
+
+/**
+ * Allocates memory, counting it if counting is turned on.
+ * @param[in] size : number of bytes
+ * @param[in] soft : may the memory be missing, see #MemRetry
+ * @return allocated memory or NULL
+ */
+static void *MemAllocate(size_t size, bool soft) {
+    void *ptr = malloc(size);
+    if (ptr == NULL) {
+        ptr = MemRetry(NULL, size, soft);
+    }
+
+    if (counting && ptr != NULL) {
+        thread_counters.allocs++;
+        atomic_fetch_add_explicit(&total_allocs, 1, memory_order_relaxed);
+        MemCountAllocated(MemBlockSize(ptr, size));
+    }
+    return ptr;
+}
+
+/**
+ * Reallocates memory, counting it if counting is turned on.
+ * @param[in] ptr : memory or NULL
+ * @param[in] size : new number of bytes
+ * @return reallocated memory
+ */
+static void *MemReallocate(void *ptr, size_t size) {
+    if (!counting) {
+        void *result = realloc(ptr, size);
+        return result != NULL ? result : MemRetry(ptr, size, false);
+    }
+
+    bool resized = ptr != NULL;
+    size_t old_size = resized ? MemBlockSize(ptr, 0) : 0;
+    void *result = realloc(ptr, size);
+    ptr = result != NULL ? result : MemRetry(ptr, size, false);
+
+    if (resized) {
+        thread_counters.reallocs++;
+        atomic_fetch_add_explicit(&total_reallocs, 1, memory_order_relaxed);
+    }
+    else {      // a new block
+        thread_counters.allocs++;
+        atomic_fetch_add_explicit(&total_allocs, 1, memory_order_relaxed);
+    }
+    MemCountFreed(old_size);
+    MemCountAllocated(MemBlockSize(ptr, size));
+    return ptr;
+}
+
+#ifdef ALLOC_PROFILE
+
+/// Maximal number of recorded call sites, the last one gathers the rest.
+#define PROFILE_SITES 128
+
+/// Number of buckets of histograms of sizes and lifetimes.
+#define PROFILE_BUCKETS 40
+
+/// Number of buckets of the histogram of shrinking reallocations.
+#define PROFILE_SHRINK_BUCKETS 10
+
+/// Number of lists of the table of live blocks.
+#define PROFILE_TABLE_SIZE (1 << 16)
+
+/**
+ * Data recorded for a single call site.
+ */
+typedef struct ProfileSite {
+    const char *file;                       ///< source file
+    int line;                               ///< line
+    uint64_t allocs;                        ///< allocations
+    uint64_t reallocs;                      ///< reallocations
+    uint64_t frees;                         ///< frees of blocks from here
+    uint64_t grows;                         ///< growing reallocations
+    uint64_t sizes[PROFILE_BUCKETS];        ///< requested sizes
+    uint64_t shrinks[PROFILE_SHRINK_BUCKETS];   ///< shrinking reallocations
+    uint64_t lifetimes[PROFILE_BUCKETS];    ///< lifetimes in commands
+} ProfileSite;
+
+/**
+ * Live block allocated through the allocation layer.
+ */
+typedef struct ProfileBlock {
+    void *ptr;                  ///< the block
+    size_t size;                ///< requested size
+    size_t site;                ///< index of the allocating site
+    uint64_t birth;             ///< number of the allocating command
+    struct ProfileBlock *next;  ///< next block of the list
+} ProfileBlock;
+
+/// Recorded call sites.
+static ProfileSite sites[PROFILE_SITES];
+
+/// Number of recorded call sites.
+static size_t site_count = 0;
+
+/// Live blocks, hashed by their addresses.
+static ProfileBlock *blocks[PROFILE_TABLE_SIZE];
+
+/// Guards the data of the profiler.
+static atomic_flag profile_lock = ATOMIC_FLAG_INIT;
+
+/// Number of started commands.
+static atomic_uint_least64_t commands;
+
+/**
+ * Takes the lock of the profiler.
+ */
+static void ProfileLock(void) {
+    while (atomic_flag_test_and_set_explicit(&profile_lock,
+                                             memory_order_acquire)) {
+    }
+}
+
+/**
+ * Releases the lock of the profiler.
+ */
+static void ProfileUnlock(void) {
+    atomic_flag_clear_explicit(&profile_lock, memory_order_release);
+}
+
+/**
+ * Computes a histogram bucket of a value.
+ * @param value : value
+ * @return index of the bucket
+ */
+static size_t ProfileBucket(uint64_t value) {
+    size_t bucket = 0;
+    while (value > 1 && bucket + 1 < PROFILE_BUCKETS) {
+        value >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/**
+ * Finds a call site, adding it if it is new. Requires the lock.
+ * @param file : source file
+ * @param line : line
+ * @return index of the site
+ */
+static size_t ProfileSiteIndex(const char *file, int line) {
+    for (size_t i = 0; i < site_count; i++) {
+        if (sites[i].line == line && strcmp(sites[i].file, file) == 0) {
+            return i;
+        }
+    }
+    if (site_count == PROFILE_SITES) {
+        return PROFILE_SITES - 1;
+    }
+    sites[site_count].file = file;
+    sites[site_count].line = line;
+    return site_count++;
+}
+
+/**
+ * Computes the list of the table of live blocks for a block.
+ * @param ptr : block
+ * @return index of the list
+ */
+static size_t ProfileHash(const void *ptr) {
+    return ((uintptr_t) ptr >> 4) % PROFILE_TABLE_SIZE;
+}
+
+/**
+ * Removes a block from the table of live blocks. Requires the lock.
+ * @param ptr : block
+ * @return removed entry or NULL if the block is not in the table
+ */
+static ProfileBlock *ProfileTake(const void *ptr) {
+    ProfileBlock **place = &blocks[ProfileHash(ptr)];
+
+    while (*place != NULL && (*place)->ptr != ptr) {
+        place = &(*place)->next;
+    }
+    ProfileBlock *block = *place;
+    if (block != NULL) {
+        *place = block->next;
+    }
+    return block;
+}
+
+/**
+ * Adds a block to the table of live blocks. Requires the lock.
+ * @param block : entry of the block, its pointer set
+ */
+static void ProfilePut(ProfileBlock *block) {
+    size_t hash = ProfileHash(block->ptr);
+    block->next = blocks[hash];
+    blocks[hash] = block;
+}
+
+/**
+ * Records the end of the life of a block. Requires the lock.
+ * @param block : entry of the block, which is freed
+ */
+static void ProfileDie(ProfileBlock *block) {
+    ProfileSite *site = &sites[block->site];
+    site->frees++;
+    site->lifetimes[ProfileBucket(atomic_load(&commands) - block->birth)]++;
+    free(block);
+}
+
+/**
+ * Records a new block.
+ * @param ptr : the block
+ * @param size : requested size
+ * @param file : source file of the call site
+ * @param line : line of the call site
+ */
+static void ProfileBirth(void *ptr, size_t size, const char *file, int line) {
+    ProfileBlock *block = malloc(sizeof(ProfileBlock));
+    CHECK_PTR(block);
+
+    ProfileLock();
+    size_t index = ProfileSiteIndex(file, line);
+    sites[index].allocs++;
+    sites[index].sizes[ProfileBucket(size)]++;
+    *block = (ProfileBlock) {.ptr = ptr, .size = size, .site = index,
+                             .birth = atomic_load(&commands)};
+    ProfilePut(block);
+    ProfileUnlock();
+}
+
+void *MemAllocAt(size_t size, const char *file, int line) {
+    void *ptr = MemAllocate(size, false);
+    ProfileBirth(ptr, size, file, line);
+    return ptr;
+}
+
+void *MemTryAllocAt(size_t size, const char *file, int line) {
+    void *ptr = MemAllocate(size, true);
+    if (ptr != NULL) {
+        ProfileBirth(ptr, size, file, line);
+    }
+    return ptr;
+}
+
+void *MemReallocAt(void *ptr, size_t size, const char *file, int line) {
+    if (ptr == NULL) {
+        return MemAllocAt(size, file, line);
+    }
+
+    ProfileLock();
+    ProfileBlock *block = ProfileTake(ptr);
+    ProfileUnlock();
+
+    void *result = MemReallocate(ptr, size);
+    if (block == NULL) {    // allocated outside of the layer
+        ProfileBirth(result, size, file, line);
+        return result;
+    }
+
+    ProfileLock();
+    ProfileSite *site = &sites[ProfileSiteIndex(file, line)];
+    site->reallocs++;
+    if (size < block->size) {
+        site->shrinks[size * PROFILE_SHRINK_BUCKETS / block->size]++;
+    }
+    else if (size > block->size) {
+        site->grows++;
+    }
+    block->ptr = result;
+    block->size = size;
+    ProfilePut(block);
+    ProfileUnlock();
+    return result;
+}
+
+/**
+ * Writes a histogram without its trailing empty buckets.
+ * @param file : file to write to
+ * @param name : JSON key
+ * @param histogram : buckets
+ * @param size : number of buckets
+ */
+static void ProfileWriteHistogram(FILE *file, const char *name,
+                                  const uint64_t *histogram, size_t size) {
+    while (size > 0 && histogram[size - 1] == 0) {
+        size--;
+    }
+
+    fprintf(file, ", \"%s\": [", name);
+    for (size_t i = 0; i < size; i++) {
+        fprintf(file, "%s%" PRIu64, i > 0 ? ", " : "", histogram[i]);
+    }
+    fprintf(file, "]");
+}
+
+void MemWriteProfile(FILE *file) {
+    ProfileLock();
+
+    fprintf(file, "[");
+    for (size_t i = 0; i < site_count; i++) {
+        ProfileSite *site = &sites[i];
+        const char *name = strrchr(site->file, '/');
+
+        fprintf(file, "%s\n    {\"site\": \"%s:%d\", \"allocs\": %" PRIu64
+                ", \"reallocs\": %" PRIu64 ", \"frees\": %" PRIu64
+                ", \"grows\": %" PRIu64, i > 0 ? "," : "",
+                name != NULL ? name + 1 : site->file, site->line,
+                site->allocs, site->reallocs, site->frees, site->grows);
+        ProfileWriteHistogram(file, "sizes", site->sizes, PROFILE_BUCKETS);
+        ProfileWriteHistogram(file, "shrinks", site->shrinks,
+                              PROFILE_SHRINK_BUCKETS);
+        ProfileWriteHistogram(file, "lifetimes", site->lifetimes,
+                              PROFILE_BUCKETS);
+        fprintf(file, "}");
+    }
+    fprintf(file, "\n  ]");
+
+    ProfileUnlock();
+}
+
+void MemNextCommand(void) {
+    atomic_fetch_add_explicit(&commands, 1, memory_order_relaxed);
+}
+
+#else
+
+void *MemAlloc(size_t size) {
+    return MemAllocate(size, false);
+}
+
+void *MemTryAlloc(size_t size) {
+    return MemAllocate(size, true);
+}
+
+void *MemRealloc(void *ptr, size_t size) {
+    return MemReallocate(ptr, size);
+}
+
+void MemNextCommand(void) {
+}
+
+#endif
+
+void MemFree(void *ptr) {
+#ifdef ALLOC_PROFILE
+    if (ptr != NULL) {
+        ProfileLock();
+        ProfileBlock *block = ProfileTake(ptr);
+        if (block != NULL) {
+            ProfileDie(block);
+        }
+        ProfileUnlock();
+    }
+#endif
+
+    if (counting && ptr != NULL) {
+        thread_counters.frees++;
+        atomic_fetch_add_explicit(&total_frees, 1, memory_order_relaxed);
+        MemCountFreed(MemBlockSize(ptr, 0));
+    }
+    free(ptr);
+}
+
+void MemEnableCounting(void) {
+    counting = true;
+}
+
+MemCounters MemThreadCounters(void) {
+    return thread_counters;
+}
+
+void MemResetThreadPeak(void) {
+    MemCounters total = MemTotalCounters();
+    thread_counters.peak_bytes = total.bytes_allocated > total.bytes_freed
+                                 ? total.bytes_allocated - total.bytes_freed
+                                 : 0;
+}
+
+MemCounters MemTotalCounters(void) {
+    return (MemCounters) {
+        .allocs = atomic_load(&total_allocs),
+        .reallocs = atomic_load(&total_reallocs),
+        .frees = atomic_load(&total_frees),
+        .bytes_allocated = atomic_load(&total_bytes_allocated),
+        .bytes_freed = atomic_load(&total_bytes_freed),
+        .peak_bytes = atomic_load(&total_peak_bytes)
+    };
+}
+
+void MemRefillReserve(void) {
+    recovering = true;
+    if (atomic_load_explicit(&reserve, memory_order_relaxed) != NULL) {
+        return;
+    }
+
+    void *block = malloc(MEM_RESERVE_SIZE);
+    void *expected = NULL;
+    if (block == NULL) {
+        return;
+    }
+    // touches the pages, so freeing the reserve gives back real memory
+    // and not only address space
+    memset(block, 0, MEM_RESERVE_SIZE);
+    if (!atomic_compare_exchange_strong(&reserve, &expected, block)) {
+        free(block);    // another thread was faster
+    }
+}
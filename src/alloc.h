@@ -0,0 +1,168 @@
+/** @file
+  Interface of the allocation layer of the polynomial library.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Numbers of calls to the allocation layer and of bytes passing through it.
+ */
+typedef struct MemCounters {
+    uint64_t allocs;            ///< number of allocations
+    uint64_t reallocs;          ///< number of reallocations
+    uint64_t frees;             ///< number of freed blocks
+    uint64_t bytes_allocated;   ///< bytes taken from the system
+    uint64_t bytes_freed;       ///< bytes given back to the system
+    uint64_t peak_bytes;        ///< highest number of live bytes
+} MemCounters;
+
+/**
+ * @brief Allocates memory like malloc.
+ * @details When there is not enough memory, free memory of the C library is
+ * given back to the system and the allocation is tried again. If that
+ * fails too, the emergency reserve (see #MemRefillReserve) is freed to
+ * complete it and the current operation of the thread is cancelled (see
+ * #CancelPoll), so that it is unwound. Exits only if there is not enough
+ * memory even then.
+ * @param[in] size : number of bytes, greater than 0
+ * @return allocated memory
+ */
+void *MemAlloc(size_t size);
+
+/**
+ * @brief Allocates memory which may be missing.
+ * @details Works like #MemAlloc, but when there is not enough memory during
+ * a watched operation (see #CancelBegin) of a thread which recovers from
+ * running out of it (see #MemRefillReserve), the operation is cancelled
+ * and NULL is returned instead of drawing on the emergency reserve. Used
+ * for the big arrays of the library, whose callers unwind on NULL.
+ * @param[in] size : number of bytes, greater than 0
+ * @return allocated memory or NULL
+ */
+void *MemTryAlloc(size_t size);
+
+/**
+ * Changes the size of allocated memory like realloc. Runs out of memory
+ * like #MemAlloc.
+ * @param[in] ptr : memory from #MemAlloc or #MemRealloc, or NULL
+ * @param[in] size : new number of bytes, greater than 0
+ * @return reallocated memory
+ */
+void *MemRealloc(void *ptr, size_t size);
+
+/**
+ * Frees memory from #MemAlloc or #MemRealloc.
+ * @param[in] ptr : memory or NULL
+ */
+void MemFree(void *ptr);
+
+/**
+ * Marks the beginning of the next command, which is the unit of lifetimes
+ * of the allocation profiler.
+ */
+void MemNextCommand(void);
+
+#ifdef ALLOC_PROFILE
+
+/**
+ * @brief Allocates memory on behalf of a call site.
+ * @details In builds with the allocation profiler #MemAlloc passes its
+ * call site here, so sizes and lifetimes are recorded per site.
+ * @param[in] size : number of bytes, greater than 0
+ * @param[in] file : source file of the call site
+ * @param[in] line : line of the call site
+ * @return allocated memory
+ */
+void *MemAllocAt(size_t size, const char *file, int line);
+
+/**
+ * Reallocates memory on behalf of a call site, see #MemAllocAt.
+ * @param[in] ptr : memory from #MemAlloc or #MemRealloc, or NULL
+ * @param[in] size : new number of bytes, greater than 0
+ * @param[in] file : source file of the call site
+ * @param[in] line : line of the call site
+ * @return reallocated memory
+ */
+void *MemReallocAt(void *ptr, size_t size, const char *file, int line);
+
+/**
+ * Allocates memory which may be missing on behalf of a call site, see
+ * #MemTryAlloc and #MemAllocAt.
+ * @param[in] size : number of bytes, greater than 0
+ * @param[in] file : source file of the call site
+ * @param[in] line : line of the call site
+ * @return allocated memory or NULL
+ */
+void *MemTryAllocAt(size_t size, const char *file, int line);
+
+/// Allocates memory, recording the call site.
+#define MemAlloc(size) MemAllocAt((size), __FILE__, __LINE__)
+
+/// Allocates memory which may be missing, recording the call site.
+#define MemTryAlloc(size) MemTryAllocAt((size), __FILE__, __LINE__)
+
+/// Reallocates memory, recording the call site.
+#define MemRealloc(ptr, size) MemReallocAt((ptr), (size), __FILE__, __LINE__)
+
+/**
+ * @brief Writes the data of the allocation profiler as a JSON array.
+ * @details For every call site there are numbers of allocations,
+ * reallocations and frees of the blocks allocated there, a histogram of
+ * requested sizes (bucket @f$i@f$ counts sizes from @f$2^i@f$ to
+ * @f$2^{i+1} - 1@f$ bytes), a histogram of shrinking reallocations by
+ * the new size as tenths of the old one, the number of growing
+ * reallocations and a histogram of lifetimes in commands (buckets like
+ * for the sizes, bucket 0 also counts 0).
+ * @param file : file to write to
+ */
+void MemWriteProfile(FILE *file);
+
+#endif
+
+/**
+ * @brief Turns on counting of allocations.
+ * @details It should be called before any other thread is started. Until
+ * then the allocation layer costs a single branch per call.
+ */
+void MemEnableCounting(void);
+
+/**
+ * Returns the counters of the calling thread. They only change while
+ * counting is turned on. Their peak is the highest number of live bytes
+ * of the whole process seen by allocations of the thread since
+ * #MemResetThreadPeak.
+ * @return counters of the calling thread
+ */
+MemCounters MemThreadCounters(void);
+
+/**
+ * Sets the peak of the calling thread to the current number of live bytes.
+ */
+void MemResetThreadPeak(void);
+
+/**
+ * Returns the counters summed over all of the threads. Their peak is
+ * the high-water mark of live bytes.
+ * @return counters of the whole process
+ */
+MemCounters MemTotalCounters(void);
+
+/**
+ * Allocates the emergency reserve if it is not allocated, which is freed
+ * when memory runs out so that the operation which ran out of it can be
+ * unwound, and makes the calling thread recover from running out of memory
+ * (see #MemTryAlloc). Called before every command of sequential execution;
+ * without it running out of memory exits the program.
+ */
+void MemRefillReserve(void);
+
+#endif //ALLOC_H
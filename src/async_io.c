@@ -0,0 +1,705 @@
+/** @file
+  Implementation of asynchronous file input-output.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef _GNU_SOURCE
+/// Directive necessary for fopencookie to work.
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sched.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#include "async_io.h"
+#include "error_handler.h"
+
+/// Number of threads performing blocking I/O when io_uring is not available.
+#define AIO_POOL_THREADS 2
+
+/// Number of entries of the io_uring submission queue.
+#define AIO_RING_ENTRIES 64
+
+/// Amount of queued bytes of a single file above which writers wait.
+#define AIO_MAX_PENDING_BYTES (1 << 24)
+
+/// Largest transfer passed to a single io_uring request.
+#define AIO_MAX_CHUNK (1U << 30)
+
+/// Permissions of created files (before applying umask).
+#define AIO_FILE_MODE 0666
+
+/**
+ * Kind of an I/O request.
+ */
+typedef enum AioOp {
+    AIO_READ,   ///< read into a buffer
+    AIO_WRITE   ///< write a buffer
+} AioOp;
+
+/**
+ * File opened by this module. It is the cookie of the returned streams.
+ */
+struct AsyncFile {
+    int fd;                   ///< descriptor, -1 after it was closed
+    bool regular;             ///< can the file be read in the background
+    off_t offset;             ///< offset of the next write
+    size_t pending_bytes;     ///< number of bytes being written
+    size_t pending_requests;  ///< number of unfinished requests
+    int error;                ///< first error of a request, 0 if none
+    char *buffer;             ///< contents of a file being read
+    size_t size;              ///< number of bytes in the buffer
+    size_t position;          ///< position of the stream in the buffer
+};
+
+/**
+ * Single read or write queued to the I/O service.
+ */
+typedef struct AioRequest {
+    struct AioRequest *next;  ///< next request in the queue
+    AsyncFile *file;          ///< file of the request
+    AioOp op;                 ///< kind of the request
+    char *buf;                ///< transferred data
+    size_t len;               ///< number of bytes to transfer
+    size_t done;              ///< number of already transferred bytes
+    off_t offset;             ///< offset in the file
+    int error;                ///< error of the request, 0 if none
+} AioRequest;
+
+/**
+ * Queue of requests shared by the threads submitting and performing them.
+ */
+typedef struct AioService {
+    pthread_mutex_t lock;     ///< protects the queue and the pending counters
+    pthread_cond_t submitted; ///< signalled when a request is queued
+    pthread_cond_t completed; ///< broadcast when a request is completed
+    AioRequest *head;         ///< first queued request
+    AioRequest *tail;         ///< last queued request
+    bool synchronous;         ///< no thread could be started
+} AioService;
+
+/// The I/O service of the program.
+static AioService service = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .submitted = PTHREAD_COND_INITIALIZER,
+    .completed = PTHREAD_COND_INITIALIZER,
+    .head = NULL,
+    .tail = NULL,
+    .synchronous = false
+};
+
+/// Guard starting the threads of the service only once.
+static pthread_once_t service_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Takes up to @p max requests from the queue, waits if it is empty.
+ * Requires the lock of the service.
+ * @param batch : array for the taken requests
+ * @param max : length of @p batch
+ * @return number of taken requests
+ */
+static size_t AioTake(AioRequest **batch, size_t max) {
+    while (service.head == NULL) {
+        pthread_cond_wait(&service.submitted, &service.lock);
+    }
+
+    size_t count = 0;
+    while (count < max && service.head != NULL) {
+        batch[count++] = service.head;
+        service.head = service.head->next;
+    }
+    if (service.head == NULL) {
+        service.tail = NULL;
+    }
+    return count;
+}
+
+/**
+ * Finishes a request - updates its file and frees it.
+ * Requires the lock of the service.
+ * @param req : finished request
+ */
+static void AioComplete(AioRequest *req) {
+    AsyncFile *file = req->file;
+
+    if (req->op == AIO_WRITE) {
+        file->pending_bytes -= req->len;
+        free(req->buf);
+    }
+    else {
+        file->size = req->done;
+    }
+    if (req->error != 0 && file->error == 0) {
+        file->error = req->error;
+    }
+    file->pending_requests--;
+    free(req);
+
+    pthread_cond_broadcast(&service.completed);
+}
+
+/**
+ * Performs a request with blocking system calls.
+ * @param req : request to perform
+ */
+static void AioPerform(AioRequest *req) {
+    while (req->done < req->len) {
+        ssize_t result;
+        if (req->op == AIO_WRITE) {
+            result = pwrite(req->file->fd, req->buf + req->done,
+                            req->len - req->done, req->offset + req->done);
+        }
+        else {
+            result = pread(req->file->fd, req->buf + req->done,
+                           req->len - req->done, req->offset + req->done);
+        }
+
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        else if (result < 0) {
+            req->error = errno;
+            return;
+        }
+        else if (result == 0) {   // end of a file that shrank
+            if (req->op == AIO_WRITE) {
+                req->error = EIO;
+            }
+            return;
+        }
+        req->done += result;
+    }
+}
+
+/**
+ * Thread of the blocking fallback. Performs requests one by one.
+ * @param arg : unused
+ * @return never returns
+ */
+static void *AioPoolWorker(void *arg) {
+    (void) arg;
+    AioRequest *req;
+
+    pthread_mutex_lock(&service.lock);
+    for (;;) {
+        AioTake(&req, 1);
+        pthread_mutex_unlock(&service.lock);
+        AioPerform(req);
+        pthread_mutex_lock(&service.lock);
+        AioComplete(req);
+    }
+    return NULL;
+}
+
+#ifdef HAVE_IO_URING
+
+/**
+ * Submission and completion queues of io_uring mapped into memory.
+ */
+typedef struct AioRing {
+    int fd;                     ///< descriptor of the ring
+    unsigned entries;           ///< length of the submission queue
+    unsigned *sq_tail;          ///< tail of the submission queue
+    unsigned *sq_mask;          ///< mask of the submission queue
+    unsigned *sq_array;         ///< indices of submitted entries
+    struct io_uring_sqe *sqes;  ///< submission queue entries
+    unsigned *cq_head;          ///< head of the completion queue
+    unsigned *cq_tail;          ///< tail of the completion queue
+    unsigned *cq_mask;          ///< mask of the completion queue
+    struct io_uring_cqe *cqes;  ///< completion queue entries
+} AioRing;
+
+/// The ring used by the service if it could be created.
+static AioRing ring;
+
+/**
+ * Creates an io_uring instance and maps its queues.
+ * @param r : ring to initialize
+ * @return could the ring be created
+ */
+static bool AioRingInit(AioRing *r) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int fd = (int) syscall(__NR_io_uring_setup, AIO_RING_ENTRIES, &params);
+    if (fd < 0) {
+        return false;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes
+                     + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        sq_size = cq_size = sq_size > cq_size ? sq_size : cq_size;
+    }
+
+    char *sq = mmap(NULL, sq_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    char *cq = sq;
+    if (!single_mmap && sq != MAP_FAILED) {
+        cq = mmap(NULL, cq_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    }
+    size_t sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = MAP_FAILED;
+    if (cq != MAP_FAILED) {
+        sqes = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    }
+
+    if (sqes == MAP_FAILED) {
+        if (cq != MAP_FAILED && cq != sq) {
+            munmap(cq, cq_size);
+        }
+        if (sq != MAP_FAILED) {
+            munmap(sq, sq_size);
+        }
+        close(fd);
+        return false;
+    }
+
+    r->fd = fd;
+    r->entries = params.sq_entries;
+    r->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+    r->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+    r->sq_array = (unsigned *) (sq + params.sq_off.array);
+    r->sqes = sqes;
+    r->cq_head = (unsigned *) (cq + params.cq_off.head);
+    r->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+    r->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+    return true;
+}
+
+/**
+ * Puts the remaining part of a request into the submission queue.
+ * @param r : ring
+ * @param req : request
+ */
+static void AioRingPrepare(AioRing *r, AioRequest *req) {
+    unsigned tail = *r->sq_tail;
+    unsigned index = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[index];
+    size_t len = req->len - req->done;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = req->op == AIO_WRITE ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = req->file->fd;
+    sqe->addr = (uintptr_t) (req->buf + req->done);
+    sqe->len = len > AIO_MAX_CHUNK ? AIO_MAX_CHUNK : (unsigned) len;
+    sqe->off = req->offset + req->done;
+    sqe->user_data = (uintptr_t) req;
+
+    r->sq_array[index] = index;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Applies a completion to its request.
+ * @param req : request
+ * @param result : result of the transfer
+ * @return is the request finished
+ */
+static bool AioRingApply(AioRequest *req, int result) {
+    if (result == -EINTR || result == -EAGAIN) {
+        return false;
+    }
+    else if (result < 0) {
+        req->error = -result;
+        return true;
+    }
+    else if (result == 0) {     // end of a file that shrank
+        if (req->op == AIO_WRITE) {
+            req->error = EIO;
+        }
+        return true;
+    }
+    req->done += result;
+    return req->done == req->len;
+}
+
+/**
+ * Submits a batch of requests with a single system call and waits until
+ * all of them are finished, resubmitting short transfers. If the ring
+ * fails, the requests which the kernel didn't take are taken back, those
+ * which it took are awaited, since it may still use their buffers, and
+ * the rest of the batch is performed with blocking system calls.
+ * @param r : ring
+ * @param batch : requests
+ * @param count : number of requests, at most the length of the queue
+ * @return can the ring still be used
+ */
+static bool AioRingRun(AioRing *r, AioRequest **batch, size_t count) {
+    bool broken = false;
+
+    while (count > 0 && !broken) {
+        for (size_t i = 0; i < count; i++) {
+            AioRingPrepare(r, batch[i]);
+        }
+
+        size_t to_submit = count, reaped = 0, unfinished = 0;
+        while (reaped < count) {
+            int submitted = broken ? 0
+                            : (int) syscall(__NR_io_uring_enter, r->fd,
+                                            to_submit, 1,
+                                            IORING_ENTER_GETEVENTS, NULL, 0);
+            if (submitted < 0 && errno != EINTR && errno != EAGAIN
+                && errno != EBUSY) {
+                fprintf(stderr, "poly: io_uring_enter failed: %s, "
+                                "using blocking I/O\n", strerror(errno));
+                broken = true;
+                // the last requests of the batch were not submitted
+                __atomic_store_n(r->sq_tail, *r->sq_tail - (unsigned) to_submit,
+                                 __ATOMIC_RELEASE);
+                count -= to_submit;
+                for (size_t i = count; i < count + to_submit; i++) {
+                    batch[unfinished++] = batch[i];
+                }
+                to_submit = 0;
+            }
+            else if (submitted > 0) {
+                to_submit -= submitted;
+            }
+            else if (broken) {
+                sched_yield();  // the kernel still performs the submitted ones
+            }
+
+            unsigned head = *r->cq_head;
+            while (head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+                struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+                AioRequest *req = (AioRequest *) (uintptr_t) cqe->user_data;
+
+                if (!AioRingApply(req, cqe->res)) {
+                    batch[unfinished++] = req;
+                }
+                else {
+                    pthread_mutex_lock(&service.lock);
+                    AioComplete(req);
+                    pthread_mutex_unlock(&service.lock);
+                }
+                head++;
+                reaped++;
+            }
+            __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+        }
+        count = unfinished;
+    }
+
+    for (size_t i = 0; i < count; i++) {   // left by a broken ring
+        AioPerform(batch[i]);
+        pthread_mutex_lock(&service.lock);
+        AioComplete(batch[i]);
+        pthread_mutex_unlock(&service.lock);
+    }
+    return !broken;
+}
+
+/**
+ * Thread submitting queued requests to io_uring in batches. When the ring
+ * fails, it becomes a thread of the blocking fallback.
+ * @param arg : ring
+ * @return never returns
+ */
+static void *AioRingWorker(void *arg) {
+    AioRing *r = arg;
+    AioRequest *batch[AIO_RING_ENTRIES];
+    size_t max = r->entries < AIO_RING_ENTRIES ? r->entries : AIO_RING_ENTRIES;
+    bool usable = true;
+
+    while (usable) {
+        pthread_mutex_lock(&service.lock);
+        size_t count = AioTake(batch, max);
+        pthread_mutex_unlock(&service.lock);
+        usable = AioRingRun(r, batch, count);
+    }
+    return AioPoolWorker(NULL);
+}
+
+#endif
+
+/**
+ * Starts a detached thread of the service.
+ * @param routine : routine of the thread
+ * @param arg : argument of the routine
+ * @return was the thread started
+ */
+static bool AioStartThread(void *(*routine)(void *), void *arg) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, routine, arg) != 0) {
+        return false;
+    }
+    pthread_detach(thread);
+    return true;
+}
+
+/**
+ * Starts the threads of the service - the io_uring submitter if possible,
+ * else the pool of blocking threads. If no thread can be started, requests
+ * are performed synchronously.
+ */
+static void AioServiceStart(void) {
+#ifdef HAVE_IO_URING
+    if (AioRingInit(&ring) && AioStartThread(AioRingWorker, &ring)) {
+        return;
+    }
+#endif
+    size_t started = 0;
+    for (size_t i = 0; i < AIO_POOL_THREADS; i++) {
+        started += AioStartThread(AioPoolWorker, NULL);
+    }
+    service.synchronous = started == 0;
+}
+
+/**
+ * Queues a request. Requires the lock of the service.
+ * @param req : request
+ */
+static void AioSubmit(AioRequest *req) {
+    req->file->pending_requests++;
+
+    if (service.synchronous) {
+        pthread_mutex_unlock(&service.lock);
+        AioPerform(req);
+        pthread_mutex_lock(&service.lock);
+        AioComplete(req);
+        return;
+    }
+
+    req->next = NULL;
+    if (service.tail == NULL) {
+        service.head = req;
+    }
+    else {
+        service.tail->next = req;
+    }
+    service.tail = req;
+    pthread_cond_signal(&service.submitted);
+}
+
+/**
+ * Creates a new request.
+ * @param file : file of the request
+ * @param op : kind of the request
+ * @param buf : transferred data
+ * @param len : number of bytes to transfer
+ * @param offset : offset in the file
+ * @return request
+ */
+static AioRequest *AioNewRequest(AsyncFile *file, AioOp op, char *buf,
+                                 size_t len, off_t offset) {
+    AioRequest *req = malloc(sizeof(AioRequest));
+    CHECK_PTR(req);
+
+    *req = (AioRequest) {.next = NULL, .file = file, .op = op, .buf = buf,
+                         .len = len, .done = 0, .offset = offset, .error = 0};
+    return req;
+}
+
+/**
+ * Creates a new file with a given descriptor.
+ * @param fd : descriptor
+ * @return file
+ */
+static AsyncFile *AsyncFileNew(int fd) {
+    AsyncFile *file = calloc(1, sizeof(AsyncFile));
+    CHECK_PTR(file);
+
+    file->fd = fd;
+    file->regular = true;
+    return file;
+}
+
+/**
+ * Waits until all requests of a file are finished.
+ * @param file : file
+ * @return first error of the requests, 0 if there was none
+ */
+static int AsyncWait(AsyncFile *file) {
+    pthread_mutex_lock(&service.lock);
+    while (file->pending_requests > 0) {
+        pthread_cond_wait(&service.completed, &service.lock);
+    }
+    int error = file->error;
+    pthread_mutex_unlock(&service.lock);
+    return error;
+}
+
+/**
+ * Write function of a stream - copies the data and queues it.
+ * @param cookie : file
+ * @param buf : data
+ * @param size : number of bytes
+ * @return @p size, or -1 if an earlier write failed
+ */
+static ssize_t AsyncWrite(void *cookie, const char *buf, size_t size) {
+    AsyncFile *file = cookie;
+    if (size == 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&service.lock);
+    while (file->pending_bytes > AIO_MAX_PENDING_BYTES) {
+        pthread_cond_wait(&service.completed, &service.lock);
+    }
+    if (file->error != 0) {
+        errno = file->error;
+        pthread_mutex_unlock(&service.lock);
+        return -1;
+    }
+    pthread_mutex_unlock(&service.lock);
+
+    char *copy = malloc(size);
+    CHECK_PTR(copy);
+    memcpy(copy, buf, size);
+    AioRequest *req = AioNewRequest(file, AIO_WRITE, copy, size, file->offset);
+    file->offset += size;
+
+    pthread_mutex_lock(&service.lock);
+    file->pending_bytes += size;
+    AioSubmit(req);
+    pthread_mutex_unlock(&service.lock);
+
+    return size;
+}
+
+/**
+ * Read function of a stream - copies the data read in the background.
+ * @param cookie : file
+ * @param buf : destination
+ * @param size : maximal number of bytes
+ * @return number of copied bytes, 0 at the end of the file
+ */
+static ssize_t AsyncReadFromMemory(void *cookie, char *buf, size_t size) {
+    AsyncFile *file = cookie;
+    size_t left = file->size - file->position;
+    if (size > left) {
+        size = left;
+    }
+
+    memcpy(buf, file->buffer + file->position, size);
+    file->position += size;
+    return size;
+}
+
+/**
+ * Close function of a stream - waits for the requests and frees the file.
+ * @param cookie : file
+ * @return 0 on success, -1 if any request failed
+ */
+static int AsyncClose(void *cookie) {
+    AsyncFile *file = cookie;
+    int error = AsyncWait(file);
+
+    if (file->fd >= 0 && close(file->fd) != 0 && error == 0) {
+        error = errno;
+    }
+    free(file->buffer);
+    free(file);
+
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+FILE *AsyncOpenWrite(const char *path) {
+    pthread_once(&service_once, AioServiceStart);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                  AIO_FILE_MODE);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    AsyncFile *file = AsyncFileNew(fd);
+    cookie_io_functions_t functions = {.read = NULL, .write = AsyncWrite,
+                                       .seek = NULL, .close = AsyncClose};
+    FILE *stream = fopencookie(file, "w", functions);
+    if (stream == NULL) {
+        close(fd);
+        free(file);
+    }
+    return stream;
+}
+
+AsyncFile *AsyncReadStart(const char *path) {
+    pthread_once(&service_once, AioServiceStart);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    AsyncFile *file = AsyncFileNew(fd);
+    if (!S_ISREG(st.st_mode)) {     // pipes have to be read as they come
+        file->regular = false;
+        return file;
+    }
+
+    file->buffer = malloc(st.st_size > 0 ? st.st_size : 1);
+    CHECK_PTR(file->buffer);
+    if (st.st_size > 0) {
+        AioRequest *req = AioNewRequest(file, AIO_READ, file->buffer,
+                                        st.st_size, 0);
+        pthread_mutex_lock(&service.lock);
+        AioSubmit(req);
+        pthread_mutex_unlock(&service.lock);
+    }
+    return file;
+}
+
+FILE *AsyncReadFinish(AsyncFile *file) {
+    if (!file->regular) {
+        FILE *stream = fdopen(file->fd, "r");
+        if (stream == NULL) {
+            close(file->fd);
+        }
+        free(file);
+        return stream;
+    }
+
+    int error = AsyncWait(file);
+    close(file->fd);
+    file->fd = -1;
+    if (error != 0) {
+        free(file->buffer);
+        free(file);
+        errno = error;
+        return NULL;
+    }
+
+    cookie_io_functions_t functions = {.read = AsyncReadFromMemory,
+                                       .write = NULL, .seek = NULL,
+                                       .close = AsyncClose};
+    FILE *stream = fopencookie(file, "r", functions);
+    if (stream == NULL) {
+        free(file->buffer);
+        free(file);
+    }
+    return stream;
+}
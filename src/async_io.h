@@ -0,0 +1,48 @@
+/** @file
+  Interface of asynchronous file input-output.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <stdio.h>
+
+/**
+ * File that is being read asynchronously.
+ */
+typedef struct AsyncFile AsyncFile;
+
+/**
+ * @brief Opens a file for writing whose writes are done asynchronously.
+ * @details Everything written to the stream is copied and queued to the I/O
+ * service, so the thread that writes can keep computing. Requests queued
+ * by all of the streams are submitted in batches - to io_uring if it is
+ * available, else to a pool of threads performing blocking writes.
+ * Closing the stream waits until all of its writes are done and reports
+ * their errors.
+ * @param path : path of the file
+ * @return stream or NULL if the file couldn't be opened
+ */
+FILE *AsyncOpenWrite(const char *path);
+
+/**
+ * @brief Starts reading a whole file in the background.
+ * @details The file should be later passed to #AsyncReadFinish.
+ * @param path : path of the file
+ * @return file being read or NULL if the file couldn't be opened
+ */
+AsyncFile *AsyncReadStart(const char *path);
+
+/**
+ * Waits until reading of the file is done and returns a stream
+ * reading its contents from memory. Takes over the file.
+ * @param file : file started by #AsyncReadStart
+ * @return stream or NULL if the file couldn't be read
+ */
+FILE *AsyncReadFinish(AsyncFile *file);
+
+#endif //ASYNC_IO_H
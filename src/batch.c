@@ -0,0 +1,176 @@
+/** @file
+  Implementation of the calculator's batch mode.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef _POSIX_C_SOURCE
+/// Directive necessary for sysconf to work.
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "async_io.h"
+#include "batch.h"
+#include "calc.h"
+#include "error_handler.h"
+#include "streams.h"
+
+/// Size of the buffer of an output file of a script.
+#define BATCH_BUFFER_SIZE (1 << 16)
+
+/**
+ * State shared by all of the workers of a batch.
+ */
+typedef struct Batch {
+    char **files;            ///< paths of the scripts
+    size_t count;            ///< number of scripts
+    atomic_size_t next;      ///< index of the next script to run
+    atomic_bool failed;      ///< did any script fail to run
+} Batch;
+
+/**
+ * Opens for writing a file whose path is @p path with @p suffix appended.
+ * @param path : path of the script
+ * @param suffix : suffix to append
+ * @return opened file or NULL if it couldn't be opened
+ */
+static FILE *OpenWithSuffix(const char *path, const char *suffix) {
+    size_t path_len = strlen(path);
+    size_t suffix_len = strlen(suffix);
+    char *name = malloc(path_len + suffix_len + 1);
+    CHECK_PTR(name);
+
+    memcpy(name, path, path_len);
+    memcpy(name + path_len, suffix, suffix_len + 1);
+
+    FILE *file = AsyncOpenWrite(name);
+    free(name);
+    return file;
+}
+
+/**
+ * Runs a single script with its own streams.
+ * @param path : path of the script
+ * @param script : the script being read in the background, NULL if it
+ * couldn't be opened
+ * @return could the script be run
+ */
+static bool BatchRunScript(const char *path, AsyncFile *script) {
+    FILE *in = script != NULL ? AsyncReadFinish(script) : NULL;
+    if (in == NULL) {
+        fprintf(stderr, "poly: cannot open %s\n", path);
+        return false;
+    }
+
+    FILE *out = OpenWithSuffix(path, BATCH_OUT_SUFFIX);
+    FILE *err = OpenWithSuffix(path, BATCH_ERR_SUFFIX);
+    if (out == NULL || err == NULL) {
+        fprintf(stderr, "poly: cannot create output files for %s\n", path);
+        fclose(in);
+        if (out != NULL) {
+            fclose(out);
+        }
+        if (err != NULL) {
+            fclose(err);
+        }
+        return false;
+    }
+    setvbuf(out, NULL, _IOFBF, BATCH_BUFFER_SIZE);
+
+    SetStreams(in, out, err);
+    CalcRun();
+    SetStreams(NULL, NULL, NULL);
+
+    fclose(in);
+    bool ok = fclose(out) == 0;
+    ok = fclose(err) == 0 && ok;
+    if (!ok) {
+        fprintf(stderr, "poly: cannot write results of %s\n", path);
+    }
+    return ok;
+}
+
+/**
+ * Starts reading the script with a given index in the background.
+ * @param batch : batch
+ * @param index : index of the script
+ * @return the script being read or NULL
+ */
+static AsyncFile *BatchPrefetch(Batch *batch, size_t index) {
+    return index < batch->count ? AsyncReadStart(batch->files[index]) : NULL;
+}
+
+/**
+ * Worker of a batch. Takes scripts one by one until there are none left.
+ * The next script is read in the background while the current one is run.
+ * @param arg : batch shared by the workers
+ * @return NULL
+ */
+static void *BatchWorker(void *arg) {
+    Batch *batch = arg;
+    size_t index = atomic_fetch_add(&batch->next, 1);
+    AsyncFile *script = BatchPrefetch(batch, index);
+
+    while (index < batch->count) {
+        size_t next = atomic_fetch_add(&batch->next, 1);
+        AsyncFile *next_script = BatchPrefetch(batch, next);
+
+        if (!BatchRunScript(batch->files[index], script)) {
+            atomic_store(&batch->failed, true);
+        }
+        index = next;
+        script = next_script;
+    }
+    return NULL;
+}
+
+/**
+ * Returns the default number of workers - one per online CPU.
+ * @return number of workers
+ */
+static size_t DefaultWorkers(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (size_t) cpus : 1;
+}
+
+bool BatchRun(size_t count, char **files, size_t workers) {
+    Batch batch = {.files = files, .count = count};
+    atomic_init(&batch.next, 0);
+    atomic_init(&batch.failed, false);
+
+    if (workers == 0) {
+        workers = DefaultWorkers();
+    }
+    if (workers > count) {
+        workers = count;
+    }
+    if (workers <= 1) {
+        BatchWorker(&batch);
+        return !atomic_load(&batch.failed);
+    }
+
+    pthread_t *threads = malloc(workers * sizeof(pthread_t));
+    CHECK_PTR(threads);
+
+    size_t started = 0;
+    while (started < workers &&
+           pthread_create(&threads[started], NULL, BatchWorker, &batch) == 0) {
+        started++;
+    }
+    if (started == 0) {     // no threads available, run everything here
+        BatchWorker(&batch);
+    }
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    free(threads);
+    return !atomic_load(&batch.failed);
+}
@@ -0,0 +1,35 @@
+/** @file
+  Interface of the calculator's batch mode.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/// Suffix of a file to which results of a script are written.
+#define BATCH_OUT_SUFFIX ".out"
+
+/// Suffix of a file to which error messages of a script are written.
+#define BATCH_ERR_SUFFIX ".err"
+
+/**
+ * @brief Runs independent calculator scripts on a pool of worker threads.
+ * @details Every script is run with its own stack. Results of a script
+ * @p file are written to @p file.out and error messages to @p file.err.
+ * Workers live for the whole batch, so allocator caches warmed up by one
+ * script are reused by the following ones. Scripts are read and results
+ * are written asynchronously, overlapping with the computation.
+ * @param count : number of scripts
+ * @param files : paths of the scripts
+ * @param workers : number of worker threads, 0 means one per online CPU
+ * @return true if every script could be run, else false
+ */
+bool BatchRun(size_t count, char **files, size_t workers);
+
+#endif //BATCH_H
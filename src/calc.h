@@ -0,0 +1,19 @@
+/** @file
+  Interface of multivariable polynomial calculator.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef CALC_H
+#define CALC_H
+
+/**
+ * Runs the calculator on the input stream of the calling thread.
+ * Creates a new stack, reads lines until the end of the input stream and
+ * after that destroys the stack with its contents.
+ */
+void CalcRun(void);
+
+#endif //CALC_H
@@ -0,0 +1,129 @@
+/** @file
+  Implementation of cooperative cancellation of long operations on
+  polynomials.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef _POSIX_C_SOURCE
+/// Directive necessary for clock_gettime to work.
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <time.h>
+#include "cancel.h"
+#include "streams.h"
+
+/// Products of terms computed between reads of the clock.
+#define CANCEL_CLOCK_PERIOD 4096
+
+/// Highest percent reported before an operation ends, as its total is
+/// often only estimated.
+#define CANCEL_MAX_PERCENT 99
+
+/// Nanoseconds in a second.
+#define NS_PER_SECOND 1000000000u
+
+/**
+ * State of the watched operation of a thread.
+ */
+typedef struct CancelState {
+    CancelWatch watch;      ///< parameters of the operation
+    bool watching;          ///< is an operation watched
+    bool timed;             ///< does it have a time limit or reports
+    CancelReason reason;    ///< reason of cancellation
+    bool started;           ///< was the first checkpoint reached
+    uint64_t first;         ///< products of terms at the first checkpoint
+    uint64_t polled;        ///< products of terms when the clock was read
+    uint64_t deadline;      ///< time at which it runs out of time
+    uint64_t next_report;   ///< time of the next progress report
+} CancelState;
+
+/// Watched operation of the calling thread.
+static _Thread_local CancelState state;
+
+/**
+ * Reads the monotonic clock.
+ * @return time in nanoseconds
+ */
+static uint64_t CancelNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * NS_PER_SECOND + (uint64_t) ts.tv_nsec;
+}
+
+void CancelBegin(const CancelWatch *watch) {
+    state = (CancelState) {.watch = *watch, .watching = true,
+                           .reason = CANCEL_NONE,
+                           .timed = watch->timeout_ns > 0
+                                    || watch->progress_ns > 0};
+    if (state.timed) {
+        uint64_t now = CancelNow();
+        state.deadline = now + watch->timeout_ns;
+        state.next_report = now + watch->progress_ns;
+    }
+}
+
+/**
+ * Writes a progress report of the watched operation.
+ * @param products : products of terms computed by the calling thread
+ */
+static void CancelReport(uint64_t products) {
+    double done = (double) (products - state.first);
+    int percent = 0;
+
+    if (state.watch.total > 0) {
+        double part = done * 100 / state.watch.total;
+        percent = part < CANCEL_MAX_PERCENT ? (int) part : CANCEL_MAX_PERCENT;
+    }
+    fprintf(ErrorStream(), "PROGRESS %zu %s %d%%\n",
+            state.watch.line_number, state.watch.name, percent);
+    fflush(ErrorStream());
+}
+
+bool CancelPoll(uint64_t products) {
+    if (state.reason != CANCEL_NONE) {
+        return true;
+    }
+    if (!state.timed) {
+        return false;
+    }
+    if (!state.started) {
+        state.started = true;
+        state.first = state.polled = products;
+    }
+    if (products - state.polled < CANCEL_CLOCK_PERIOD) {
+        return false;
+    }
+
+    state.polled = products;
+    uint64_t now = CancelNow();
+    if (state.watch.timeout_ns > 0 && now >= state.deadline) {
+        state.reason = CANCEL_TIMEOUT;
+        return true;
+    }
+    if (state.watch.progress_ns > 0 && now >= state.next_report) {
+        CancelReport(products);
+        state.next_report = now + state.watch.progress_ns;
+    }
+    return false;
+}
+
+void CancelRequest(CancelReason reason) {
+    if (state.watching && state.reason == CANCEL_NONE) {
+        state.reason = reason;
+    }
+}
+
+bool CancelWatching(void) {
+    return state.watching;
+}
+
+CancelReason CancelEnd(void) {
+    CancelReason reason = state.reason;
+    state = (CancelState) {.watching = false, .reason = CANCEL_NONE};
+    return reason;
+}
@@ -0,0 +1,76 @@
+/** @file
+  Interface of cooperative cancellation of long operations on polynomials.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef CANCEL_H
+#define CANCEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Reason for which an operation was cancelled.
+ */
+typedef enum CancelReason {
+    CANCEL_NONE,            ///< the operation was not cancelled
+    CANCEL_TIMEOUT,         ///< it ran out of time
+    CANCEL_NO_MEMORY,       ///< it ran out of memory
+} CancelReason;
+
+/**
+ * Parameters of a watched operation.
+ */
+typedef struct CancelWatch {
+    uint64_t timeout_ns;    ///< time limit, 0 for none
+    uint64_t progress_ns;   ///< period of progress reports, 0 for none
+    double total;           ///< expected number of products of terms
+    const char *name;       ///< name of the operation in progress reports
+    size_t line_number;     ///< line of the operation in progress reports
+} CancelWatch;
+
+/**
+ * Starts watching an operation of the calling thread. Until #CancelEnd
+ * its checkpoints stop it when it runs out of time and report its progress
+ * to the error stream as lines `PROGRESS line name percent%`, where the
+ * percent is the part of @p total products of terms computed so far.
+ * @param[in] watch : parameters of the operation
+ */
+void CancelBegin(const CancelWatch *watch);
+
+/**
+ * @brief Checkpoint of a long operation on polynomials.
+ * @details Called from hot loops of the library (see #PolyMul and
+ * #PolyCompose), which stop as soon as it returns true, free what they
+ * computed and return a result which has to be thrown away. It reads the clock only
+ * once in a while, so it is cheap enough to be called for every product
+ * of monomials.
+ * @param products : products of terms computed by the calling thread
+ * @return should the operation stop
+ */
+bool CancelPoll(uint64_t products);
+
+/**
+ * Cancels the watched operation of the calling thread, if there is one and
+ * it was not cancelled yet. Its next checkpoint stops it.
+ * @param reason : reason of cancellation
+ */
+void CancelRequest(CancelReason reason);
+
+/**
+ * Tells if an operation of the calling thread is watched.
+ * @return is the calling thread between #CancelBegin and #CancelEnd
+ */
+bool CancelWatching(void);
+
+/**
+ * Finishes watching an operation of the calling thread.
+ * @return reason for which it was cancelled, #CANCEL_NONE if it wasn't
+ */
+CancelReason CancelEnd(void);
+
+#endif //CANCEL_H
@@ -0,0 +1,1428 @@
+/** @file
+  Implementation of parsed calculator commands.
+
+  @authors Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef _POSIX_C_SOURCE
+/// Directive necessary for getline to work.
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <ctype.h>
+#include "alloc.h"
+#include "cancel.h"
+#include "command.h"
+#include "input_output.h"
+#include "mono_array.h"
+#include "perf.h"
+#include "shape.h"
+#include "stats.h"
+#include "workload.h"
+
+/// String representing ZERO command.
+#define ZERO_STRING "ZERO\0"
+
+/// String representing IS_COEFF command.
+#define IS_COEFF_STRING "IS_COEFF\0"
+
+/// String representing IS_ZERO command.
+#define IS_ZERO_STRING "IS_ZERO\0"
+
+/// String representing CLONE command.
+#define CLONE_STRING "CLONE\0"
+
+/// String representing ADD command.
+#define ADD_STRING "ADD\0"
+
+/// String representing MUL command.
+#define MUL_STRING "MUL\0"
+
+/// String representing NEG command.
+#define NEG_STRING "NEG\0"
+
+/// String representing SUB command.
+#define SUB_STRING "SUB\0"
+
+/// String representing IS_EQ command.
+#define IS_EQ_STRING "IS_EQ\0"
+
+/// String representing DEG command.
+#define DEG_STRING "DEG\0"
+
+/// String representing PRINT command.
+#define PRINT_STRING "PRINT\0"
+
+/// String representing POP command.
+#define POP_STRING "POP\0"
+
+/// String representing DEG_BY command.
+#define DEG_BY_STRING "DEG_BY"
+
+/// String representing DEG_BY command with a space.
+#define DEG_BY_WITH_SPACE_STRING "DEG_BY "
+
+/// Length of DEG_BY command.
+#define DEG_BY_LEN 6
+
+/// String representing AT command.
+#define AT_STRING "AT"
+
+/// String representing AT command with a space.
+#define AT_WITH_SPACE_STRING "AT "
+
+/// Length of AT command.
+#define AT_LEN 2
+
+/// String representing COMPOSE command with a space.
+#define COMPOSE_STRING "COMPOSE"
+
+/// String representing COMPOSE command with a space.
+#define COMPOSE_WITH_SPACE_STRING "COMPOSE "
+
+/// Length of COMPOSE command.
+#define COMPOSE_LEN 7
+
+/// String representing SWAP command.
+#define SWAP_STRING "SWAP"
+
+/// String representing ROT command.
+#define ROT_STRING "ROT"
+
+/// String representing PICK command.
+#define PICK_STRING "PICK"
+
+/// String representing PICK command with a space.
+#define PICK_WITH_SPACE_STRING "PICK "
+
+/// Length of PICK command.
+#define PICK_LEN 4
+
+/// String representing ROLL command.
+#define ROLL_STRING "ROLL"
+
+/// String representing ROLL command with a space.
+#define ROLL_WITH_SPACE_STRING "ROLL "
+
+/// Length of ROLL command.
+#define ROLL_LEN 4
+
+/// String representing REPEAT command.
+#define REPEAT_STRING "REPEAT"
+
+/// String representing REPEAT command with a space.
+#define REPEAT_WITH_SPACE_STRING "REPEAT "
+
+/// Length of REPEAT command.
+#define REPEAT_LEN 6
+
+/// String representing END command.
+#define END_STRING "END"
+
+/// String representing DEF command.
+#define DEF_STRING "DEF"
+
+/// Length of DEF command.
+#define DEF_LEN 3
+
+/// String representing CALL command.
+#define CALL_STRING "CALL"
+
+/// Length of CALL command.
+#define CALL_LEN 4
+
+/// String representing ADD_N command.
+#define ADD_N_STRING "ADD_N"
+
+/// String representing ADD_N command with a space.
+#define ADD_N_WITH_SPACE_STRING "ADD_N "
+
+/// Length of ADD_N command.
+#define ADD_N_LEN 5
+
+/// String representing MUL_N command.
+#define MUL_N_STRING "MUL_N"
+
+/// String representing MUL_N command with a space.
+#define MUL_N_WITH_SPACE_STRING "MUL_N "
+
+/// Length of MUL_N command.
+#define MUL_N_LEN 5
+
+/// String representing LINCOMB command.
+#define LINCOMB_STRING "LINCOMB"
+
+/// String representing LINCOMB command with a space.
+#define LINCOMB_WITH_SPACE_STRING "LINCOMB "
+
+/// Length of LINCOMB command.
+#define LINCOMB_LEN 7
+
+/// String representing COEFF command.
+#define COEFF_STRING "COEFF"
+
+/// String representing COEFF command with a space.
+#define COEFF_WITH_SPACE_STRING "COEFF "
+
+/// Length of COEFF command.
+#define COEFF_LEN 5
+
+/// String representing TRUNC command.
+#define TRUNC_STRING "TRUNC"
+
+/// String representing TRUNC command with a space.
+#define TRUNC_WITH_SPACE_STRING "TRUNC "
+
+/// Length of TRUNC command.
+#define TRUNC_LEN 5
+
+/// String representing LEAD command.
+#define LEAD_STRING "LEAD"
+
+/// String representing STATS command.
+#define STATS_STRING "STATS"
+
+/// String representing MEM command.
+#define MEM_STRING "MEM"
+
+/// String representing MEM command with a space.
+#define MEM_WITH_SPACE_STRING "MEM "
+
+/// Length of MEM command.
+#define MEM_LEN 3
+
+/// String representing SHAPE command.
+#define SHAPE_STRING "SHAPE"
+
+/// String representing STORE command.
+#define STORE_STRING "STORE"
+
+/// Length of STORE command.
+#define STORE_LEN 5
+
+/// String representing LOAD command.
+#define LOAD_STRING "LOAD"
+
+/// Length of LOAD command.
+#define LOAD_LEN 4
+
+/// String representing DROP command.
+#define DROP_STRING "DROP"
+
+/// Length of DROP command.
+#define DROP_LEN 4
+
+/// Char separating a command from its parameter.
+#define SPACE ' '
+
+/// Char allowed in register names aside from letters and digits.
+#define UNDERSCORE '_'
+
+/// Char distinguishing a comment.
+#define COMMENT_CHAR '#'
+
+/// Getline error code.
+#define GETLINE_ERROR (-1)
+
+/// When increasing an array's size, this is the multiplier.
+#define SIZE_EXPAND_CONST 2
+
+/// Nanoseconds in a millisecond.
+#define NS_PER_MS 1000000u
+
+/// Highest number of terms of results, 0 for no limit.
+static size_t max_terms = 0;
+
+/// Highest number of bytes of results, 0 for no limit.
+static size_t max_bytes = 0;
+
+/// Time limit of long commands in nanoseconds, 0 for no limit.
+static uint64_t timeout_ns = 0;
+
+/// Period of progress reports of long commands in nanoseconds, 0 for none.
+static uint64_t progress_ns = 0;
+
+/// Names of the types of commands, as written in the input.
+static const char *const command_names[CMD_TYPE_COUNT] = {
+  [CMD_NONE] = "NONE", [CMD_ERROR] = "ERROR", [CMD_POLY] = "POLY",
+  [CMD_ZERO] = ZERO_STRING, [CMD_IS_COEFF] = IS_COEFF_STRING,
+  [CMD_IS_ZERO] = IS_ZERO_STRING, [CMD_CLONE] = CLONE_STRING,
+  [CMD_ADD] = ADD_STRING, [CMD_MUL] = MUL_STRING, [CMD_NEG] = NEG_STRING,
+  [CMD_SUB] = SUB_STRING, [CMD_IS_EQ] = IS_EQ_STRING,
+  [CMD_DEG] = DEG_STRING, [CMD_DEG_BY] = DEG_BY_STRING,
+  [CMD_PRINT] = PRINT_STRING, [CMD_POP] = POP_STRING, [CMD_AT] = AT_STRING,
+  [CMD_COMPOSE] = COMPOSE_STRING, [CMD_STORE] = STORE_STRING,
+  [CMD_LOAD] = LOAD_STRING, [CMD_DROP] = DROP_STRING,
+  [CMD_SWAP] = SWAP_STRING, [CMD_ROT] = ROT_STRING,
+  [CMD_PICK] = PICK_STRING, [CMD_ROLL] = ROLL_STRING,
+  [CMD_REPEAT] = REPEAT_STRING, [CMD_DEF] = DEF_STRING,
+  [CMD_END] = END_STRING, [CMD_CALL] = CALL_STRING,
+  [CMD_ADD_N] = ADD_N_STRING, [CMD_MUL_N] = MUL_N_STRING,
+  [CMD_LINCOMB] = LINCOMB_STRING, [CMD_COEFF] = COEFF_STRING,
+  [CMD_TRUNC] = TRUNC_STRING, [CMD_LEAD] = LEAD_STRING,
+  [CMD_STATS] = STATS_STRING, [CMD_MEM] = MEM_STRING,
+  [CMD_SHAPE] = SHAPE_STRING
+};
+
+const char *CommandName(CommandType type) {
+  return command_names[type];
+}
+
+/**
+* Function that determines if an input string matches a given command.
+* Checks if two strings (char arrays) are the same
+* up to the last char - it expects that if one string ends, the other will
+* still contain a newline char, but does enable both strings to be exactly
+* the same.
+* When global variable feof is true, it means that reading input is done and
+* the current command is the last one.
+* @param instr : instrukcja
+* @param to_cmp : wczytany napis
+* @return czy napis reprezentuje daną instrukcję
+*/
+static bool InstrCmp(const char *instr, const char *to_cmp) {
+  assert(instr != NULL && to_cmp != NULL);
+
+  int index = 0;
+  while (instr[index] != NULL_CHAR) {
+    if (instr[index] != to_cmp[index]) {
+      return false;
+    }
+    index++;
+  }
+
+  if (instr[index] == NULL_CHAR && to_cmp[index] == NULL_CHAR) {
+    if (!feof(InputStream())) {
+      return false;
+    }
+    return true;
+  } else if (instr[index] == NULL_CHAR && to_cmp[index] == NEWLINE
+      && to_cmp[index + 1] == NULL_CHAR) {
+    return true;
+  } else {
+    return false;
+  }
+}
+
+/**
+ * Checks if a parameter of a command ends where it should - with '\n', or
+ * with '\0' if it is the last line of the input.
+ * @param last : first char after the parameter
+ * @return does the parameter end correctly
+ */
+static bool IsParamEnd(const char *last) {
+  return *last == NEWLINE || (feof(InputStream()) && *last == NULL_CHAR);
+}
+
+/**
+ * Changes a command into an error with a given code.
+ * @param cmd : command
+ * @param code : error code
+ */
+static void CommandSetError(Command *cmd, int code) {
+  cmd->type = CMD_ERROR;
+  cmd->error_code = code;
+}
+
+/**
+ * Checks if a name of a parametric command is followed by exactly one space
+ * and a beginning of a number. If it isn't, changes the command into an
+ * error - WRONG COMMAND if the name is followed by something else than
+ * a whitespace, else an error with a given code.
+ * @param cmd : command
+ * @param instruction : read line
+ * @param with_space : name of the command with a space
+ * @param len : length of the name
+ * @param is_signed : can the number be negative
+ * @param code : error code of a wrong parameter
+ * @return beginning of the parameter or NULL
+ */
+static char *ParamBegin(Command *cmd, char *instruction,
+                        const char *with_space, size_t len, bool is_signed,
+                        int code) {
+  if (strncmp(instruction, with_space, len + 1) == 0
+      && (isdigit(instruction[len + 1])
+          || (is_signed && instruction[len + 1] == MINUS_SIGN))) {
+    return &instruction[len + 1];
+  }
+
+  if (!isspace(instruction[len])) {
+    CommandSetError(cmd, WRONG_COMMAND_CODE);
+  } else {
+    CommandSetError(cmd, code);
+  }
+  return NULL;
+}
+
+/**
+ * Parses commands which take a parameter. First it checks which of the known
+ * commands match. Next it checks if there is exactly one space after a
+ * command. After that it converts the number and checks if the last read
+ * character is '\n' or '\0' (the second one only if it detects end of file).
+ * If anything is not valid, the command becomes an appropriate error.
+ * This function requires that the beginning of the string (instruction
+ * without a parameter) was matching to any of the known commands.
+ * @param cmd : command
+ * @param instruction : name of the instruction
+ */
+static void ParseParametric(Command *cmd, char *instruction) {
+  char *param;
+  char *last;
+
+  if (strncmp(instruction, DEG_BY_STRING, DEG_BY_LEN) == 0) {
+    param = ParamBegin(cmd, instruction, DEG_BY_WITH_SPACE_STRING, DEG_BY_LEN,
+                       false, DEG_BY_WRONG_VAR_CODE);
+    if (param != NULL) {
+      errno = 0;
+      size_t var_idx = strtoull(param, &last, NUMBER_BASE);
+
+      if (!IsParamEnd(last) || !IsDegByValid(var_idx)) {
+        CommandSetError(cmd, DEG_BY_WRONG_VAR_CODE);
+      } else {
+        cmd->type = CMD_DEG_BY;
+        cmd->param = var_idx;
+      }
+    }
+  } else if (strncmp(instruction, AT_STRING, AT_LEN) == 0) {
+    param = ParamBegin(cmd, instruction, AT_WITH_SPACE_STRING, AT_LEN,
+                       true, AT_WRONG_VAL_CODE);
+    if (param != NULL) {
+      errno = 0;
+      poly_coeff_t coeff = strtol(param, &last, NUMBER_BASE);
+
+      if (!IsParamEnd(last) || !IsCoeffOrAtArgValid(coeff)) {
+        CommandSetError(cmd, AT_WRONG_VAL_CODE);
+      } else {
+        cmd->type = CMD_AT;
+        cmd->value = coeff;
+      }
+    }
+  } else if (strncmp(instruction, COMPOSE_STRING, COMPOSE_LEN) == 0) {
+    param = ParamBegin(cmd, instruction, COMPOSE_WITH_SPACE_STRING,
+                       COMPOSE_LEN, false, COMPOSE_WRONG_PARAM_CODE);
+    if (param != NULL) {
+      errno = 0;
+      size_t count = strtoull(param, &last, NUMBER_BASE);
+
+      if (!IsParamEnd(last) || !IsComposeValid(count)) {
+        CommandSetError(cmd, COMPOSE_WRONG_PARAM_CODE);
+      } else {
+        cmd->type = CMD_COMPOSE;
+        cmd->param = count;
+      }
+    }
+  } else if (strncmp(instruction, PICK_STRING, PICK_LEN) == 0
+             || strncmp(instruction, ROLL_STRING, ROLL_LEN) == 0
+             || strncmp(instruction, MEM_STRING, MEM_LEN) == 0) {
+    CommandType type = CMD_MEM;
+    const char *with_space = MEM_WITH_SPACE_STRING;
+    size_t len = MEM_LEN;
+    int code = MEM_WRONG_PARAM_CODE;
+
+    if (strncmp(instruction, PICK_STRING, PICK_LEN) == 0) {
+      type = CMD_PICK;
+      with_space = PICK_WITH_SPACE_STRING;
+      len = PICK_LEN;
+      code = PICK_WRONG_PARAM_CODE;
+    } else if (strncmp(instruction, ROLL_STRING, ROLL_LEN) == 0) {
+      type = CMD_ROLL;
+      with_space = ROLL_WITH_SPACE_STRING;
+      len = ROLL_LEN;
+      code = ROLL_WRONG_PARAM_CODE;
+    }
+
+    param = ParamBegin(cmd, instruction, with_space, len, false, code);
+    if (param != NULL) {
+      errno = 0;
+      size_t depth = strtoull(param, &last, NUMBER_BASE);
+
+      if (!IsParamEnd(last) || !IsStackDepthValid(depth)) {
+        CommandSetError(cmd, code);
+      } else {
+        cmd->type = type;
+        cmd->param = depth;
+      }
+    }
+  } else if (strncmp(instruction, REPEAT_STRING, REPEAT_LEN) == 0) {
+    param = ParamBegin(cmd, instruction, REPEAT_WITH_SPACE_STRING, REPEAT_LEN,
+                       false, REPEAT_WRONG_PARAM_CODE);
+    if (param != NULL) {
+      errno = 0;
+      size_t count = strtoull(param, &last, NUMBER_BASE);
+
+      if (!IsParamEnd(last) || !IsRepeatValid(count)) {
+        CommandSetError(cmd, REPEAT_WRONG_PARAM_CODE);
+      } else {
+        cmd->type = CMD_REPEAT;
+        cmd->param = count;
+      }
+    }
+  } else if (strncmp(instruction, ADD_N_STRING, ADD_N_LEN) == 0
+             || strncmp(instruction, MUL_N_STRING, MUL_N_LEN) == 0) {
+    bool add = strncmp(instruction, ADD_N_STRING, ADD_N_LEN) == 0;
+    int code = add ? ADD_N_WRONG_PARAM_CODE : MUL_N_WRONG_PARAM_CODE;
+
+    param = ParamBegin(cmd, instruction,
+                       add ? ADD_N_WITH_SPACE_STRING : MUL_N_WITH_SPACE_STRING,
+                       add ? ADD_N_LEN : MUL_N_LEN, false, code);
+    if (param != NULL) {
+      errno = 0;
+      size_t count = strtoull(param, &last, NUMBER_BASE);
+
+      if (!IsParamEnd(last) || !IsComposeValid(count)) {
+        CommandSetError(cmd, code);
+      } else {
+        cmd->type = add ? CMD_ADD_N : CMD_MUL_N;
+        cmd->param = count;
+      }
+    }
+  } else if (strncmp(instruction, COEFF_STRING, COEFF_LEN) == 0
+             || strncmp(instruction, TRUNC_STRING, TRUNC_LEN) == 0) {
+    bool coeff = strncmp(instruction, COEFF_STRING, COEFF_LEN) == 0;
+    int code = coeff ? COEFF_WRONG_PARAM_CODE : TRUNC_WRONG_PARAM_CODE;
+
+    param = ParamBegin(cmd, instruction,
+                       coeff ? COEFF_WITH_SPACE_STRING : TRUNC_WITH_SPACE_STRING,
+                       coeff ? COEFF_LEN : TRUNC_LEN, false, code);
+    if (param != NULL) {
+      errno = 0;
+      long exp = strtol(param, &last, NUMBER_BASE);
+
+      if (!IsParamEnd(last) || !IsExpValid(exp)) {
+        CommandSetError(cmd, code);
+      } else {
+        cmd->type = coeff ? CMD_COEFF : CMD_TRUNC;
+        cmd->exp = (poly_exp_t) exp;
+      }
+    }
+  }
+}
+
+/**
+ * Parses LINCOMB command - the number of polynomials @f$k@f$ followed by
+ * exactly @f$k@f$ coefficients, each after a single space. If anything is not
+ * valid, the command becomes an appropriate error.
+ * @param cmd : command
+ * @param instruction : read line
+ */
+static void ParseLinComb(Command *cmd, char *instruction) {
+  char *last;
+  char *param = ParamBegin(cmd, instruction, LINCOMB_WITH_SPACE_STRING,
+                           LINCOMB_LEN, false, LINCOMB_WRONG_PARAM_CODE);
+  if (param == NULL) {
+    return;
+  }
+
+  errno = 0;
+  size_t count = strtoull(param, &last, NUMBER_BASE);
+  bool valid = IsComposeValid(count);
+  poly_coeff_t *coeffs = NULL;
+  size_t read = 0, reserved = 0;
+
+  while (valid && read < count && last[0] == SPACE
+         && (isdigit(last[1]) || last[1] == MINUS_SIGN)) {
+    errno = 0;
+    poly_coeff_t coeff = strtol(&last[1], &last, NUMBER_BASE);
+    valid = IsCoeffOrAtArgValid(coeff);
+
+    if (read == reserved) {
+      reserved = reserved * SIZE_EXPAND_CONST + 1;
+      coeffs = realloc(coeffs, reserved * sizeof(poly_coeff_t));
+      CHECK_PTR(coeffs);
+    }
+    coeffs[read++] = coeff;
+  }
+
+  if (!valid || read != count || !IsParamEnd(last)) {
+    free(coeffs);
+    CommandSetError(cmd, LINCOMB_WRONG_PARAM_CODE);
+  } else {
+    cmd->type = CMD_LINCOMB;
+    cmd->count = count;
+    cmd->coeffs = coeffs;
+  }
+}
+
+/**
+ * Parses a command taking a name of a register or a macro, which is made of
+ * letters, digits and underscores. If the name is not valid, the command
+ * becomes an appropriate error.
+ * @param cmd : command
+ * @param instruction : read line
+ * @param len : length of the name of the command
+ * @param type : type of the command
+ * @param code : error code of a wrong name
+ */
+static void ParseName(Command *cmd, char *instruction, size_t len,
+                      CommandType type, int code) {
+  if (instruction[len] != SPACE) {
+    if (!isspace(instruction[len])) {
+      CommandSetError(cmd, WRONG_COMMAND_CODE);
+    } else {
+      CommandSetError(cmd, code);
+    }
+    return;
+  }
+
+  char *name = &instruction[len + 1];
+  size_t name_len = 0;
+  while (isalnum(name[name_len]) || name[name_len] == UNDERSCORE) {
+    name_len++;
+  }
+  if (name_len == 0 || !IsParamEnd(&name[name_len])) {
+    CommandSetError(cmd, code);
+    return;
+  }
+
+  cmd->type = type;
+  cmd->name = malloc(name_len + 1);
+  CHECK_PTR(cmd->name);
+  memcpy(cmd->name, name, name_len);
+  cmd->name[name_len] = NULL_CHAR;
+}
+
+/**
+ * A big if tree recognizing a string and setting an appropriate type of the
+ * command. If it isn't able to match the input to any of the known commands,
+ * the command becomes a WRONG COMMAND error.
+ * @param cmd : command
+ * @param instruction : string representing an instruction
+ */
+static void ParseInstruction(Command *cmd, char *instruction) {
+  if (InstrCmp(ZERO_STRING, instruction)) {
+    cmd->type = CMD_ZERO;
+  } else if (InstrCmp(IS_COEFF_STRING, instruction)) {
+    cmd->type = CMD_IS_COEFF;
+  } else if (InstrCmp(IS_ZERO_STRING, instruction)) {
+    cmd->type = CMD_IS_ZERO;
+  } else if (InstrCmp(CLONE_STRING, instruction)) {
+    cmd->type = CMD_CLONE;
+  } else if (InstrCmp(ADD_STRING, instruction)) {
+    cmd->type = CMD_ADD;
+  } else if (InstrCmp(MUL_STRING, instruction)) {
+    cmd->type = CMD_MUL;
+  } else if (InstrCmp(NEG_STRING, instruction)) {
+    cmd->type = CMD_NEG;
+  } else if (InstrCmp(SUB_STRING, instruction)) {
+    cmd->type = CMD_SUB;
+  } else if (InstrCmp(IS_EQ_STRING, instruction)) {
+    cmd->type = CMD_IS_EQ;
+  } else if (InstrCmp(DEG_STRING, instruction)) {
+    cmd->type = CMD_DEG;
+  } else if (InstrCmp(PRINT_STRING, instruction)) {
+    cmd->type = CMD_PRINT;
+  } else if (InstrCmp(POP_STRING, instruction)) {
+    cmd->type = CMD_POP;
+  } else if (InstrCmp(SWAP_STRING, instruction)) {
+    cmd->type = CMD_SWAP;
+  } else if (InstrCmp(ROT_STRING, instruction)) {
+    cmd->type = CMD_ROT;
+  } else if (InstrCmp(END_STRING, instruction)) {
+    cmd->type = CMD_END;
+  } else if (InstrCmp(LEAD_STRING, instruction)) {
+    cmd->type = CMD_LEAD;
+  } else if (InstrCmp(STATS_STRING, instruction)) {
+    cmd->type = CMD_STATS;
+  } else if (InstrCmp(SHAPE_STRING, instruction)) {
+    cmd->type = CMD_SHAPE;
+  } else if (strncmp(instruction, DEG_BY_STRING, DEG_BY_LEN) == 0
+             || strncmp(instruction, AT_STRING, AT_LEN) == 0
+             || strncmp(instruction, COMPOSE_STRING, COMPOSE_LEN) == 0
+             || strncmp(instruction, PICK_STRING, PICK_LEN) == 0
+             || strncmp(instruction, ROLL_STRING, ROLL_LEN) == 0
+             || strncmp(instruction, MEM_STRING, MEM_LEN) == 0
+             || strncmp(instruction, REPEAT_STRING, REPEAT_LEN) == 0
+             || strncmp(instruction, ADD_N_STRING, ADD_N_LEN) == 0
+             || strncmp(instruction, MUL_N_STRING, MUL_N_LEN) == 0
+             || strncmp(instruction, COEFF_STRING, COEFF_LEN) == 0
+             || strncmp(instruction, TRUNC_STRING, TRUNC_LEN) == 0) {
+    ParseParametric(cmd, instruction);
+  } else if (strncmp(instruction, LINCOMB_STRING, LINCOMB_LEN) == 0) {
+    ParseLinComb(cmd, instruction);
+  } else if (strncmp(instruction, STORE_STRING, STORE_LEN) == 0) {
+    ParseName(cmd, instruction, STORE_LEN, CMD_STORE,
+              REGISTER_WRONG_NAME_CODE);
+  } else if (strncmp(instruction, LOAD_STRING, LOAD_LEN) == 0) {
+    ParseName(cmd, instruction, LOAD_LEN, CMD_LOAD, REGISTER_WRONG_NAME_CODE);
+  } else if (strncmp(instruction, DROP_STRING, DROP_LEN) == 0) {
+    ParseName(cmd, instruction, DROP_LEN, CMD_DROP, REGISTER_WRONG_NAME_CODE);
+  } else if (strncmp(instruction, DEF_STRING, DEF_LEN) == 0) {
+    ParseName(cmd, instruction, DEF_LEN, CMD_DEF, MACRO_WRONG_NAME_CODE);
+  } else if (strncmp(instruction, CALL_STRING, CALL_LEN) == 0) {
+    ParseName(cmd, instruction, CALL_LEN, CMD_CALL, MACRO_WRONG_NAME_CODE);
+  } else {
+    CommandSetError(cmd, WRONG_COMMAND_CODE);
+  }
+}
+
+/**
+ * Reads a polynomial from a line.
+ * A helper variable help determines the end of a read polynomial; if it is
+ * not '\n' or '\0' by the time reading input is done (!feof), the command
+ * becomes a WRONG POLY error.
+ * @param cmd : command
+ * @param line : read line
+ */
+static void ParsePoly(Command *cmd, char *line) {
+  ErrorHandler handler = NewErrorHandler(cmd->line_number);
+  char *help = NULL;
+  Poly input_poly = PolyRead(line, &help, &handler);
+
+  if (help != NULL && help[0] != NEWLINE && !(help[0] == NULL_CHAR
+      && feof(InputStream()))) {
+    ErrorHandlerSetCode(&handler, WRONG_POLY_CODE);
+  }
+  if (IsError(&handler)) {
+    PolyDestroy(&input_poly);
+    CommandSetError(cmd, handler.code);
+  } else {
+    cmd->type = CMD_POLY;
+    cmd->poly = input_poly;
+  }
+}
+
+void CalcStateInit(CalcState *state) {
+  StackInit(&state->stack);
+  RegistersInit(&state->registers);
+  state->below = 0;
+}
+
+void CalcStateDestroy(CalcState *state) {
+  Empty(&state->stack);
+  RegistersDestroy(&state->registers);
+}
+
+Command CommandRead(char **line, size_t *size, size_t line_number) {
+  Command cmd = {.type = CMD_NONE, .line_number = line_number};
+
+  bool timed = StatsEnabled();
+  uint64_t start = timed ? StatsNow() : 0;
+  ssize_t length = getline(line, size, InputStream());
+  if (length == GETLINE_ERROR) {
+    return cmd;
+  }
+
+  if ((*line)[0] == COMMENT_CHAR || (*line)[0] == NEWLINE) {}
+  else if (isalpha((*line)[0])) {
+    ParseInstruction(&cmd, *line);
+  } else {
+    ParsePoly(&cmd, *line);
+  }
+
+  if (timed) {
+    StatsRead(StatsNow() - start, (size_t) length);
+  }
+  if (WorkloadRecording()) {
+    WorkloadRecord(&cmd, *line);
+  }
+  return cmd;
+}
+
+StackEffect CommandStackEffect(const Command *cmd) {
+  switch (cmd->type) {
+    case CMD_POLY:
+    case CMD_ZERO:
+      return (StackEffect) {.need = 0, .pops = 0, .pushes = 1};
+    case CMD_IS_COEFF:
+    case CMD_IS_ZERO:
+    case CMD_DEG:
+    case CMD_DEG_BY:
+    case CMD_PRINT:
+    case CMD_SHAPE:
+      return (StackEffect) {.need = 1, .pops = 0, .pushes = 0, .prints = true};
+    case CMD_STATS:
+      return (StackEffect) {.need = 0, .pops = 0, .pushes = 0, .prints = true,
+                            .whole = true};
+    case CMD_MEM:
+      return (StackEffect) {.need = cmd->param, .pops = 0, .pushes = 0,
+                            .prints = true};
+    case CMD_CLONE:
+      return (StackEffect) {.need = 1, .pops = 0, .pushes = 1};
+    case CMD_NEG:
+    case CMD_AT:
+    case CMD_COEFF:
+    case CMD_TRUNC:
+    case CMD_LEAD:
+      return (StackEffect) {.need = 1, .pops = 1, .pushes = 1};
+    case CMD_ADD:
+    case CMD_MUL:
+    case CMD_SUB:
+      return (StackEffect) {.need = 2, .pops = 2, .pushes = 1};
+    case CMD_IS_EQ:
+      return (StackEffect) {.need = 2, .pops = 0, .pushes = 0, .prints = true};
+    case CMD_POP:
+    case CMD_STORE:
+      return (StackEffect) {.need = 1, .pops = 1, .pushes = 0};
+    case CMD_LOAD:
+      return (StackEffect) {.need = 0, .pops = 0, .pushes = 1};
+    case CMD_SWAP:
+      return (StackEffect) {.need = 2, .pops = 2, .pushes = 2};
+    case CMD_ROT:
+      return (StackEffect) {.need = 3, .pops = 3, .pushes = 3};
+    case CMD_PICK:      // SIZE_MAX polynomials can never be on the stack
+      return (StackEffect) {.need = cmd->param < SIZE_MAX ? cmd->param + 1
+                                                          : SIZE_MAX,
+                            .pops = 0, .pushes = 1};
+    case CMD_ROLL:
+      return (StackEffect) {.need = cmd->param < SIZE_MAX ? cmd->param + 1
+                                                          : SIZE_MAX,
+                            .pops = cmd->param + 1, .pushes = cmd->param + 1};
+    case CMD_ADD_N:
+    case CMD_MUL_N:
+      return (StackEffect) {.need = cmd->param, .pops = cmd->param,
+                            .pushes = 1};
+    case CMD_LINCOMB:
+      return (StackEffect) {.need = cmd->count, .pops = cmd->count,
+                            .pushes = 1};
+    case CMD_COMPOSE:   // SIZE_MAX polynomials can never be on the stack
+      return (StackEffect) {.need = cmd->param < SIZE_MAX ? cmd->param + 1
+                                                          : SIZE_MAX,
+                            .pops = cmd->param + 1, .pushes = 1};
+    default:
+      return (StackEffect) {.need = 0, .pops = 0, .pushes = 0};
+  }
+}
+
+/**
+ * Checks if a given polynomial is constant.
+ * If it is, prints 1 to the output stream, else it prints 0.
+ * @param poly : polynomial to check
+ */
+static void CalcIsCoeff(Poly *poly) {
+  if (PolyIsCoeff(poly)) {
+    PrintTrue();
+  } else {
+    PrintFalse();
+  }
+}
+
+/**
+ * Checks if a given polynomial is zero polynomial.
+ * If it is, prints 1 to the output stream, else it prints 0.
+ * @param poly : polynomial to check
+ */
+static void CalcIsZero(Poly *poly) {
+  if (PolyIsZero(poly)) {
+    PrintTrue();
+  } else {
+    PrintFalse();
+  }
+}
+
+/**
+ * Adds two polynomials and then destroys them.
+ * @param first : polynomial @f$p@f$
+ * @param second : polynomial @f$q@f$
+ * @return polynomial @f$p+q@f$
+ */
+static Poly CalcAdd(Poly *first, Poly *second) {
+  Poly result = PolyAdd(first, second);
+  PolyDestroy(first);
+  PolyDestroy(second);
+  return result;
+}
+
+/**
+ * Negates a given polynomial.
+ * Creates a negated polynomial and destroys the original, saves the negated
+ * one in the address of the original.
+ * @param poly : polynomial to negate
+ */
+static void CalcNeg(Poly *poly) {
+  Poly result = PolyNeg(poly);
+  PolyDestroy(poly);
+  *poly = result;
+}
+
+/**
+ * Subtracts two polynomials and then it destroys them.
+ * @param first : polynomial @f$p@f$
+ * @param second : polynomial @f$q@f$
+ * @return polynomial @f$p-q@f$
+ */
+static Poly CalcSub(Poly *first, Poly *second) {
+  Poly result = PolySub(first, second);
+  PolyDestroy(first);
+  PolyDestroy(second);
+
+  return result;
+}
+
+/**
+ * Checks if two polynomials are the same.
+ * If they are, prints 1 to the output stream, else it prints 0.
+ * @param first : first polynomial to compare
+ * @param second : second polynomial to compare
+ */
+static void CalcIsEq(Poly *first, Poly *second) {
+  if (PolyIsEq(first, second)) {
+    PrintTrue();
+  } else {
+    PrintFalse();
+  }
+}
+
+/**
+ * Prints a result of command PolyDeg to the output stream.
+ * @param poly : polynomial to perform PolyDeg on.
+ */
+static void CalcDeg(Poly *poly) {
+  fprintf(OutputStream(), "%d\n", PolyDeg(poly));
+}
+
+/**
+ * Prints a result of command PolyDegBy to the output stream.
+ * @param poly : polynomial to perform PolyDegBy on.
+ * @param var_idx : parameter of the command.
+ */
+static void CalcDegBy(Poly *poly, size_t var_idx) {
+  fprintf(OutputStream(), "%d\n", PolyDegBy(poly, var_idx));
+}
+
+/**
+ * Computes the result of PolyAt for a polynomial and a given value and then
+ * destroys it, and saves the result in the original polynomial's address.
+ * @param poly : polynomial to perform the command on.
+ * @param x : command parameter.
+ */
+static void CalcAt(Poly *poly, poly_coeff_t x) {
+  Poly result = PolyAt(poly, x);
+  PolyDestroy(poly);
+  *poly = result;
+}
+
+/**
+ * Prints the polynomial to the output stream.
+ * @param poly : polynomial to print.
+ */
+static void CalcPrint(Poly *poly) {
+  PolyPrint(poly);
+  fprintf(OutputStream(), "\n");
+}
+
+/**
+ * Prints the shape of the polynomial to the output stream.
+ * @param poly : polynomial
+ */
+static void CalcShape(Poly *poly) {
+  PolyShape shape = ShapeOf(poly);
+  ShapeWrite(&shape, OutputStream());
+  ShapeDestroy(&shape);
+}
+
+/**
+ * Computes the sum or product of @p count polynomials from the top of
+ * the stack, at once from the polynomials in place.
+ * @param s : stack
+ * @param count : parameter of the command
+ * @param sum : should the polynomials be added, else they are multiplied
+ * @return sum or product
+ */
+static Poly CalcMany(Tstack *s, size_t count, bool sum) {
+  if (count == 0) {
+    return sum ? PolyZero() : PolyFromCoeff(1);
+  }
+
+  Poly *operands = StackPeek(s, count - 1);
+  return sum ? PolySumMany(count, operands)
+             : PolyProductMany(count, operands);
+}
+
+/**
+ * Estimates the products of terms computed by MUL, MUL_N or COMPOSE, for
+ * reports of their progress.
+ * @param s : stack, with enough polynomials for the command
+ * @param cmd : command
+ * @return estimate, 0 for other commands
+ */
+static double CalcWork(Tstack *s, const Command *cmd) {
+  switch (cmd->type) {
+    case CMD_MUL:
+      return ShapeProductWork(2, StackPeek(s, 1));
+    case CMD_MUL_N:
+      return cmd->param == 0 ? 0
+                             : ShapeProductWork(cmd->param,
+                                                StackPeek(s, cmd->param - 1));
+    case CMD_COMPOSE:
+      return ShapeComposeWork(StackPeek(s, 0), cmd->param,
+                              StackPeek(s, cmd->param));
+    default:
+      return 0;
+  }
+}
+
+/**
+ * Executes MUL, COMPOSE, ADD_N or MUL_N, which replace polynomials from
+ * the top of the stack with a single result. The result is computed from
+ * the polynomials in place, watched by the checkpoints of the library (see
+ * #CancelBegin), so when the command runs out of time or memory its partial
+ * result is thrown away and the stack is left unchanged.
+ * @param s : stack
+ * @param cmd : command
+ */
+static void CalcReplace(Tstack *s, Command *cmd) {
+  CancelWatch watch = {.timeout_ns = timeout_ns, .progress_ns = progress_ns,
+                       .total = progress_ns > 0 ? CalcWork(s, cmd) : 0,
+                       .name = CommandName(cmd->type),
+                       .line_number = cmd->line_number};
+  Poly result;
+
+  CancelBegin(&watch);
+  switch (cmd->type) {
+    case CMD_MUL:
+      result = PolyMul(StackPeek(s, 0), StackPeek(s, 1));
+      break;
+    case CMD_COMPOSE:
+      result = PolyCompose(StackPeek(s, 0), cmd->param,
+                           StackPeek(s, cmd->param));
+      break;
+    default:
+      result = CalcMany(s, cmd->param, cmd->type == CMD_ADD_N);
+      break;
+  }
+  CancelReason reason = CancelEnd();
+  if (reason != CANCEL_NONE) {
+    PolyDestroy(&result);
+    HandleErrorCode(reason == CANCEL_TIMEOUT ? TIMEOUT_CODE : NO_MEMORY_CODE,
+                    cmd->line_number);
+    return;
+  }
+
+  StackEffect effect = CommandStackEffect(cmd);
+  for (size_t i = 0; i < effect.pops; i++) {
+    Poly to_destroy = Pop(s);
+    PolyDestroy(&to_destroy);
+  }
+  Push(s, result);
+}
+
+/**
+ * Replaces @p count polynomials from the top of the stack with their linear
+ * combination, computed from the polynomials in place.
+ * @param s : stack
+ * @param count : number of polynomials
+ * @param coeffs : coefficients, for polynomials from the deepest one
+ */
+static void CalcLinComb(Tstack *s, size_t count, const poly_coeff_t *coeffs) {
+  Poly result = count == 0 ? PolyZero()
+                           : PolyLinComb(count, coeffs, StackPeek(s, count - 1));
+
+  for (size_t i = 0; i < count; i++) {
+    Poly to_destroy = Pop(s);
+    PolyDestroy(&to_destroy);
+  }
+  Push(s, result);
+}
+
+/**
+ * Pushes a copy of the polynomial which is @p depth places below the top.
+ * @param s : stack
+ * @param depth : parameter of the command
+ */
+static void CalcPick(Tstack *s, size_t depth) {
+  Poly copy = PolyClone(StackPeek(s, depth));
+  Push(s, copy);
+}
+
+/**
+ * Moves the polynomial from the top of the stack to a register.
+ * @param state : state of the calculator
+ * @param name : name of the register
+ */
+static void CalcStore(CalcState *state, const char *name) {
+  RegistersStore(&state->registers, name, Pop(&state->stack));
+}
+
+/**
+ * Pushes a copy of the polynomial stored in a register.
+ * @param state : state of the calculator
+ * @param cmd : command
+ */
+static void CalcLoad(CalcState *state, Command *cmd) {
+  Poly *stored = RegistersFind(&state->registers, cmd->name);
+
+  if (stored == NULL) {
+    HandleErrorCode(REGISTER_EMPTY_CODE, cmd->line_number);
+  } else {
+    Push(&state->stack, PolyClone(stored));
+  }
+}
+
+/**
+ * Empties a register and destroys its polynomial.
+ * @param state : state of the calculator
+ * @param cmd : command
+ */
+static void CalcDrop(CalcState *state, Command *cmd) {
+  Poly stored;
+
+  if (!RegistersTake(&state->registers, cmd->name, &stored)) {
+    HandleErrorCode(REGISTER_EMPTY_CODE, cmd->line_number);
+  } else {
+    PolyDestroy(&stored);
+  }
+}
+
+/**
+ * Executes a command which takes exactly one polynomial from the stack.
+ * After doing that it returns the polynomial back to the stack
+ * (the exception is POP command).
+ * @param s : stack
+ * @param cmd : command
+ */
+static void UnaryOperation(Tstack *s, Command *cmd) {
+  Poly top = Pop(s);
+
+  switch (cmd->type) {
+    case CMD_IS_COEFF:
+      CalcIsCoeff(&top);
+      break;
+    case CMD_IS_ZERO:
+      CalcIsZero(&top);
+      break;
+    case CMD_CLONE:
+      Push(s, top);
+      Push(s, PolyClone(&top));
+      return;
+    case CMD_NEG:
+      CalcNeg(&top);
+      break;
+    case CMD_DEG:
+      CalcDeg(&top);
+      break;
+    case CMD_DEG_BY:
+      CalcDegBy(&top, cmd->param);
+      break;
+    case CMD_PRINT:
+      CalcPrint(&top);
+      break;
+    case CMD_SHAPE:
+      CalcShape(&top);
+      break;
+    case CMD_AT:
+      CalcAt(&top, cmd->value);
+      break;
+    case CMD_COEFF:
+      PolyToCoeff(&top, cmd->exp);
+      break;
+    case CMD_TRUNC:
+      PolyTruncate(&top, cmd->exp);
+      break;
+    case CMD_LEAD:
+      PolyToLead(&top);
+      break;
+    case CMD_POP:
+      PolyDestroy(&top);
+      return;
+    default:
+      break;
+  }
+
+  Push(s, top);
+}
+
+/**
+ * Executes a command which takes exactly two polynomials from the stack.
+ * After doing that it returns the result (or polynomials) back to the stack.
+ * @param s : stack
+ * @param cmd : command
+ */
+static void BinaryOperation(Tstack *s, Command *cmd) {
+  Poly first = Pop(s);
+  Poly second = Pop(s);
+
+  switch (cmd->type) {
+    case CMD_ADD:
+      Push(s, CalcAdd(&first, &second));
+      break;
+    case CMD_SUB:
+      Push(s, CalcSub(&first, &second));
+      break;
+    case CMD_IS_EQ:
+      CalcIsEq(&first, &second);
+      Push(s, second);
+      Push(s, first);
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * Prints a snapshot of the calculator, with the sizes of the polynomials
+ * of the stack.
+ * @param s : stack
+ */
+static void CalcStats(Tstack *s) {
+  char snapshot[STATS_SNAPSHOT_SIZE];
+  StatsPolys polys = {.nodes = 0, .bytes = 0};
+
+  for (size_t i = 0; i < StackSize(s); i++) {
+    polys.nodes += PolyNodeCount(StackPeek(s, i));
+    polys.bytes += PolyByteSize(StackPeek(s, i));
+  }
+  StatsSnapshot(snapshot, &polys);
+  fputs(snapshot, OutputStream());
+}
+
+/**
+ * Prints the number of terms, monomials and bytes of polynomials from
+ * the top of the stack, a line of JSON for each of them.
+ * @param s : stack
+ * @param count : number of polynomials
+ */
+static void CalcMem(Tstack *s, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    const Poly *p = StackPeek(s, i);
+    fprintf(OutputStream(),
+            "{\"depth\": %zu, \"terms\": %zu, \"nodes\": %zu, "
+            "\"bytes\": %zu}\n",
+            i, PolyTermCount(p), PolyNodeCount(p), PolyByteSize(p));
+  }
+}
+
+void CommandSetLimits(size_t terms, size_t bytes) {
+  max_terms = terms;
+  max_bytes = bytes;
+}
+
+void CommandSetTimeouts(size_t timeout_ms, size_t progress_ms) {
+  timeout_ns = (uint64_t) timeout_ms * NS_PER_MS;
+  progress_ns = (uint64_t) progress_ms * NS_PER_MS;
+}
+
+/**
+ * Tells whether the result of a command could exceed the limits of sizes.
+ * @param s : stack, with enough polynomials for the command
+ * @param cmd : command
+ * @return could the result be too big
+ */
+static bool CalcTooBig(Tstack *s, const Command *cmd) {
+  if (max_terms == 0 && max_bytes == 0) {
+    return false;
+  }
+
+  SizeBound bound;
+  switch (cmd->type) {
+    case CMD_MUL:
+      bound = ShapeProductBound(2, StackPeek(s, 1));
+      break;
+    case CMD_MUL_N:
+      if (cmd->param == 0) {
+        return false;
+      }
+      bound = ShapeProductBound(cmd->param, StackPeek(s, cmd->param - 1));
+      break;
+    case CMD_COMPOSE:
+      bound = ShapeComposeBound(StackPeek(s, 0), cmd->param,
+                                StackPeek(s, cmd->param));
+      break;
+    default:
+      return false;
+  }
+  return (max_terms > 0 && bound.terms > (double) max_terms)
+         || (max_bytes > 0 && bound.bytes > (double) max_bytes);
+}
+
+/**
+ * Executes a command on a state of the calculator, without recording it.
+ * @param state : state of the calculator
+ * @param cmd : command
+ */
+static void CommandRun(CalcState *state, Command *cmd) {
+  Tstack *s = &state->stack;
+  StackEffect effect = CommandStackEffect(cmd);
+
+  if (StackSize(s) < effect.need) {
+    HandleErrorCode(STACK_UNDERFLOW_CODE, cmd->line_number);
+    return;
+  }
+  if (CalcTooBig(s, cmd)) {
+    HandleErrorCode(RESULT_TOO_BIG_CODE, cmd->line_number);
+    return;
+  }
+
+  switch (cmd->type) {
+    case CMD_ERROR:
+      HandleErrorCode(cmd->error_code, cmd->line_number);
+      break;
+    case CMD_POLY:
+      Push(s, cmd->poly);
+      cmd->type = CMD_NONE;
+      break;
+    case CMD_ZERO:
+      Push(s, PolyZero());
+      break;
+    case CMD_ADD:
+    case CMD_SUB:
+    case CMD_IS_EQ:
+      BinaryOperation(s, cmd);
+      break;
+    case CMD_MUL:
+    case CMD_COMPOSE:
+    case CMD_ADD_N:
+    case CMD_MUL_N:
+      CalcReplace(s, cmd);
+      break;
+    case CMD_LINCOMB:
+      CalcLinComb(s, cmd->count, cmd->coeffs);
+      break;
+    case CMD_SWAP:
+      StackRoll(s, 1);
+      break;
+    case CMD_ROT:
+      StackRoll(s, 2);
+      break;
+    case CMD_PICK:
+      CalcPick(s, cmd->param);
+      break;
+    case CMD_ROLL:
+      StackRoll(s, cmd->param);
+      break;
+    case CMD_STORE:
+      CalcStore(state, cmd->name);
+      break;
+    case CMD_LOAD:
+      CalcLoad(state, cmd);
+      break;
+    case CMD_DROP:
+      CalcDrop(state, cmd);
+      break;
+    case CMD_STATS:
+      CalcStats(s);
+      break;
+    case CMD_MEM:
+      CalcMem(s, cmd->param);
+      break;
+    case CMD_NONE:
+    case CMD_REPEAT:    // blocks are expanded by a reader
+    case CMD_DEF:
+    case CMD_END:
+    case CMD_CALL:
+      break;
+    default:
+      UnaryOperation(s, cmd);
+      break;
+  }
+}
+
+/**
+ * Counts the terms of polynomials from the top of the stack.
+ * @param s : stack
+ * @param count : number of polynomials, at most the size of the stack
+ * @return number of terms
+ */
+static uint64_t CalcTermCount(Tstack *s, size_t count) {
+  uint64_t terms = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    terms += PolyTermCount(StackPeek(s, i));
+  }
+  return terms;
+}
+
+/**
+ * Computes the highest depth of polynomials from the top of the stack.
+ * @param s : stack
+ * @param count : number of polynomials, at most the size of the stack
+ * @return highest depth
+ */
+static size_t CalcDepth(Tstack *s, size_t count) {
+  size_t depth = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    size_t poly_depth = ShapeDepth(StackPeek(s, i));
+    if (poly_depth > depth) {
+      depth = poly_depth;
+    }
+  }
+  return depth;
+}
+
+void CommandExecute(CalcState *state, Command *cmd) {
+  Tstack *s = &state->stack;
+  size_t depth = StackSize(s);
+
+  StatsBegin(cmd->type, cmd->line_number, state->below + depth);
+  if (!StatsEnabled()) {
+    CommandRun(state, cmd);
+    return;
+  }
+
+  CommandType type = cmd->type;
+  StackEffect effect = CommandStackEffect(cmd);
+  bool runs = depth >= effect.need;
+  size_t read = effect.whole ? depth : effect.need;
+  StatsSample sample = {.line_number = cmd->line_number};
+  if (runs) {
+    sample.terms_in = CalcTermCount(s, read);
+    if (StatsTracing()) {
+      sample.depth_in = CalcDepth(s, read);
+    }
+  }
+  PerfSample perf_start;
+  sample.profiled = PerfEnabled() && PerfRead(&perf_start);
+  MemResetThreadPeak();
+  MemCounters before = MemThreadCounters();
+  uint64_t cpu_start = StatsCpuNow();
+  uint64_t start = StatsNow();
+
+  CommandRun(state, cmd);
+
+  sample.ns = StatsNow() - start;
+  sample.cpu_ns = StatsCpuNow() - cpu_start;
+  MemCounters after = MemThreadCounters();
+  PerfSample perf_end;
+  if (sample.profiled && PerfRead(&perf_end)) {
+    sample.perf = PerfDelta(&perf_start, &perf_end);
+  } else {
+    sample.profiled = false;
+  }
+
+  if (runs && StackSize(s) == depth - effect.pops + effect.pushes) {
+    sample.terms_out = CalcTermCount(s, effect.pushes);
+  }
+  sample.allocs = after.allocs + after.reallocs
+                  - before.allocs - before.reallocs;
+  sample.bytes_allocated = after.bytes_allocated - before.bytes_allocated;
+  sample.bytes_freed = after.bytes_freed - before.bytes_freed;
+  sample.peak_bytes = after.peak_bytes;
+  StatsRecord(type, &sample);
+}
+
+Command CommandClone(const Command *cmd) {
+  Command copy = *cmd;
+
+  if (cmd->type == CMD_POLY) {
+    copy.poly = PolyClone(&cmd->poly);
+  } else if (cmd->type == CMD_STORE || cmd->type == CMD_LOAD
+             || cmd->type == CMD_DROP || cmd->type == CMD_DEF
+             || cmd->type == CMD_CALL) {
+    copy.name = malloc(strlen(cmd->name) + 1);
+    CHECK_PTR(copy.name);
+    strcpy(copy.name, cmd->name);
+  } else if (cmd->type == CMD_LINCOMB && cmd->count > 0) {
+    copy.coeffs = malloc(cmd->count * sizeof(poly_coeff_t));
+    CHECK_PTR(copy.coeffs);
+    memcpy(copy.coeffs, cmd->coeffs, cmd->count * sizeof(poly_coeff_t));
+  }
+  return copy;
+}
+
+void CommandDestroy(Command *cmd) {
+  if (cmd->type == CMD_POLY) {
+    PolyDestroy(&cmd->poly);
+  } else if (cmd->type == CMD_STORE || cmd->type == CMD_LOAD
+             || cmd->type == CMD_DROP || cmd->type == CMD_DEF
+             || cmd->type == CMD_CALL) {
+    free(cmd->name);
+  } else if (cmd->type == CMD_LINCOMB) {
+    free(cmd->coeffs);
+  }
+  cmd->type = CMD_NONE;
+}
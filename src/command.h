@@ -0,0 +1,185 @@
+/** @file
+  Interface of parsed calculator commands.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include "stack.h"
+#include "registers.h"
+
+/**
+ * Types of calculator commands.
+ */
+typedef enum CommandType {
+    CMD_NONE,       ///< blank line or comment
+    CMD_ERROR,      ///< line that couldn't be parsed
+    CMD_POLY,       ///< polynomial to push
+    CMD_ZERO,       ///< ZERO
+    CMD_IS_COEFF,   ///< IS_COEFF
+    CMD_IS_ZERO,    ///< IS_ZERO
+    CMD_CLONE,      ///< CLONE
+    CMD_ADD,        ///< ADD
+    CMD_MUL,        ///< MUL
+    CMD_NEG,        ///< NEG
+    CMD_SUB,        ///< SUB
+    CMD_IS_EQ,      ///< IS_EQ
+    CMD_DEG,        ///< DEG
+    CMD_DEG_BY,     ///< DEG_BY var_idx
+    CMD_PRINT,      ///< PRINT
+    CMD_POP,        ///< POP
+    CMD_AT,         ///< AT x
+    CMD_COMPOSE,    ///< COMPOSE k
+    CMD_STORE,      ///< STORE name
+    CMD_LOAD,       ///< LOAD name
+    CMD_DROP,       ///< DROP name
+    CMD_SWAP,       ///< SWAP
+    CMD_ROT,        ///< ROT
+    CMD_PICK,       ///< PICK n
+    CMD_ROLL,       ///< ROLL n
+    CMD_REPEAT,     ///< REPEAT n, beginning of a loop
+    CMD_DEF,        ///< DEF name, beginning of a macro
+    CMD_END,        ///< END of a loop or a macro
+    CMD_CALL,       ///< CALL name
+    CMD_ADD_N,      ///< ADD_N k
+    CMD_MUL_N,      ///< MUL_N k
+    CMD_LINCOMB,    ///< LINCOMB k c_1 ... c_k
+    CMD_COEFF,      ///< COEFF e
+    CMD_TRUNC,      ///< TRUNC d
+    CMD_LEAD,       ///< LEAD
+    CMD_STATS,      ///< STATS
+    CMD_MEM,        ///< MEM n
+    CMD_SHAPE,      ///< SHAPE
+    CMD_TYPE_COUNT  ///< number of types of commands, not a command
+} CommandType;
+
+/**
+ * Single parsed line of the calculator's input.
+ */
+typedef struct Command {
+    CommandType type;       ///< type of the command
+    size_t line_number;     ///< number of the line
+    union {
+        Poly poly;          ///< polynomial of #CMD_POLY
+        size_t param;       ///< parameter of #CMD_DEG_BY, #CMD_COMPOSE,
+                            ///< #CMD_PICK, #CMD_ROLL, #CMD_REPEAT,
+                            ///< #CMD_ADD_N, #CMD_MUL_N and #CMD_MEM
+        poly_coeff_t value; ///< parameter of #CMD_AT
+        poly_exp_t exp;     ///< parameter of #CMD_COEFF and #CMD_TRUNC
+        int error_code;     ///< error of #CMD_ERROR
+        char *name;         ///< name of a register or a macro
+        struct {
+            size_t count;           ///< number of polynomials of #CMD_LINCOMB
+            poly_coeff_t *coeffs;   ///< coefficients of #CMD_LINCOMB
+        };
+    };
+} Command;
+
+/**
+ * State of a running calculator.
+ */
+typedef struct CalcState {
+    Tstack stack;           ///< stack of polynomials
+    Registers registers;    ///< named registers
+    size_t below;           ///< polynomials under the stack, held by -j
+} CalcState;
+
+/**
+ * Effect of a command on the stack.
+ */
+typedef struct StackEffect {
+    size_t need;    ///< number of polynomials from the top that it uses
+    size_t pops;    ///< number of them that it takes over
+    size_t pushes;  ///< number of polynomials that it pushes afterwards
+    bool prints;    ///< does it print to the output stream
+    bool whole;     ///< does it read the whole stack, not only @p need of it
+} StackEffect;
+
+/**
+ * Initializes a state with an empty stack and empty registers.
+ * @param state : state to initialize
+ */
+void CalcStateInit(CalcState *state);
+
+/**
+ * Destroys the polynomials of a state.
+ * @param state : state to destroy
+ */
+void CalcStateDestroy(CalcState *state);
+
+/**
+ * @brief Reads and parses a single line from the input stream.
+ * @details Comments, blank lines and a failed read give #CMD_NONE.
+ * A polynomial is read right away, so it is ready to be pushed.
+ * The line is added to the record of the workload if it is recorded.
+ * @param line : buffer for the line, reused between calls
+ * @param size : size of the buffer
+ * @param line_number : number of the line
+ * @return parsed command
+ */
+Command CommandRead(char **line, size_t *size, size_t line_number);
+
+/**
+ * Returns the name of a type of commands, as written in the input.
+ * @param type : type of commands
+ * @return name of the type
+ */
+const char *CommandName(CommandType type);
+
+/**
+ * Returns the effect that a command has on the stack if there is no
+ * stack underflow.
+ * @param cmd : command
+ * @return effect of the command
+ */
+StackEffect CommandStackEffect(const Command *cmd);
+
+/**
+ * Sets limits of sizes of results of MUL, MUL_N and COMPOSE, checked against
+ * bounds computed before they are executed (see #ShapeProductBound and
+ * #ShapeComposeBound). A command whose result could exceed a limit prints
+ * an error and leaves the stack unchanged. Has to be called before any
+ * command is executed.
+ * @param terms : highest number of terms, 0 for no limit
+ * @param bytes : highest number of bytes, 0 for no limit
+ */
+void CommandSetLimits(size_t terms, size_t bytes);
+
+/**
+ * Sets the time limit of MUL, MUL_N and COMPOSE and the period of reports of
+ * their progress, which are written to the error stream. A command which
+ * runs out of time prints an error and leaves the stack unchanged. Has to be
+ * called before any command is executed.
+ * @param timeout_ms : time limit in milliseconds, 0 for no limit
+ * @param progress_ms : period of reports in milliseconds, 0 for no reports
+ */
+void CommandSetTimeouts(size_t timeout_ms, size_t progress_ms);
+
+/**
+ * Executes a command on a state of the calculator. Prints errors, including
+ * a stack underflow when there are less than @p need polynomials on the
+ * stack. Takes over the polynomial of the command. The execution is
+ * recorded if the instrumentation is turned on.
+ * @param state : state of the calculator
+ * @param cmd : command
+ */
+void CommandExecute(CalcState *state, Command *cmd);
+
+/**
+ * Makes a copy of a command with its own polynomial, name and coefficients.
+ * @param cmd : command
+ * @return copy of the command
+ */
+Command CommandClone(const Command *cmd);
+
+/**
+ * Frees a command that was not executed.
+ * @param cmd : command
+ */
+void CommandDestroy(Command *cmd);
+
+#endif //COMMAND_H
@@ -7,6 +7,7 @@
 */
 
 #include "error_handler.h"
+#include "streams.h"
 
 /// Message about an unexpected error.
 #define UNEXPECTED_ERROR_MESSAGE "UNEXPECTED ERROR CODE"
@@ -29,6 +30,12 @@
 /// Lower bound for DEG_BY parameter.
 #define COMPOSE_UPPER_BOUND 18446744073709551615U
 
+/// Upper bound for REPEAT parameter.
+#define REPEAT_UPPER_BOUND 18446744073709551615U
+
+/// Upper bound for PICK and ROLL parameters.
+#define STACK_DEPTH_UPPER_BOUND 18446744073709551615U
+
 ErrorHandler NewErrorHandler(size_t w) {
     return (ErrorHandler) {.line_number = w, .code = NO_ERROR_CODE};
 }
@@ -61,14 +68,62 @@ bool HandleError(ErrorHandler handler) {
         case COMPOSE_WRONG_PARAM_CODE:
             ending = COMPOSE_WRONG_PARAM_MESSAGE;
             break;
+        case REGISTER_WRONG_NAME_CODE:
+            ending = REGISTER_WRONG_NAME_MESSAGE;
+            break;
+        case REGISTER_EMPTY_CODE:
+            ending = REGISTER_EMPTY_MESSAGE;
+            break;
+        case PICK_WRONG_PARAM_CODE:
+            ending = PICK_WRONG_PARAM_MESSAGE;
+            break;
+        case ROLL_WRONG_PARAM_CODE:
+            ending = ROLL_WRONG_PARAM_MESSAGE;
+            break;
+        case REPEAT_WRONG_PARAM_CODE:
+            ending = REPEAT_WRONG_PARAM_MESSAGE;
+            break;
+        case MISSING_END_CODE:
+            ending = MISSING_END_MESSAGE;
+            break;
+        case MACRO_WRONG_NAME_CODE:
+            ending = MACRO_WRONG_NAME_MESSAGE;
+            break;
+        case MACRO_UNDEFINED_CODE:
+            ending = MACRO_UNDEFINED_MESSAGE;
+            break;
+        case ADD_N_WRONG_PARAM_CODE:
+            ending = ADD_N_WRONG_PARAM_MESSAGE;
+            break;
+        case MUL_N_WRONG_PARAM_CODE:
+            ending = MUL_N_WRONG_PARAM_MESSAGE;
+            break;
+        case LINCOMB_WRONG_PARAM_CODE:
+            ending = LINCOMB_WRONG_PARAM_MESSAGE;
+            break;
+        case COEFF_WRONG_PARAM_CODE:
+            ending = COEFF_WRONG_PARAM_MESSAGE;
+            break;
+        case TRUNC_WRONG_PARAM_CODE:
+            ending = TRUNC_WRONG_PARAM_MESSAGE;
+            break;
+        case MEM_WRONG_PARAM_CODE:
+            ending = MEM_WRONG_PARAM_MESSAGE;
+            break;
+        case RESULT_TOO_BIG_CODE:
+            ending = RESULT_TOO_BIG_MESSAGE;
+            break;
+        case TIMEOUT_CODE:
+            ending = TIMEOUT_MESSAGE;
+            break;
         case NO_MEMORY_CODE:
-            fprintf(stderr, NO_MEMORY_MESSAGE);
-            exit(1);
+            ending = NO_MEMORY_MESSAGE;
+            break;
         default:
-            fprintf(stderr, UNEXPECTED_ERROR_MESSAGE);
+            fprintf(ErrorStream(), UNEXPECTED_ERROR_MESSAGE);
             exit(1);
     }
-    fprintf(stderr, "ERROR %zu %s\n", handler.line_number, ending);
+    fprintf(ErrorStream(), "ERROR %zu %s\n", handler.line_number, ending);
     return true;
 }
 
@@ -100,4 +155,12 @@ bool IsDegByValid(long long unsigned int n) {
 
 bool IsComposeValid(long long unsigned int n) {
     return errno != 0 || n > COMPOSE_UPPER_BOUND ? false : true;
-}
\ No newline at end of file
+}
+
+bool IsRepeatValid(long long unsigned int n) {
+    return errno != 0 || n > REPEAT_UPPER_BOUND ? false : true;
+}
+
+bool IsStackDepthValid(long long unsigned int n) {
+    return errno != 0 || n > STACK_DEPTH_UPPER_BOUND ? false : true;
+}
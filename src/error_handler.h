@@ -68,6 +68,102 @@
 /// Message about a not valid parameter of COMPOSE.
 #define COMPOSE_WRONG_PARAM_MESSAGE "COMPOSE WRONG PARAMETER"
 
+/// Error code of a not valid register name.
+#define REGISTER_WRONG_NAME_CODE 7
+
+/// Message about a not valid register name.
+#define REGISTER_WRONG_NAME_MESSAGE "WRONG REGISTER"
+
+/// Error code of a register which is empty.
+#define REGISTER_EMPTY_CODE 8
+
+/// Message about a register which is empty.
+#define REGISTER_EMPTY_MESSAGE "EMPTY REGISTER"
+
+/// Error code of a wrong PICK parameter.
+#define PICK_WRONG_PARAM_CODE 9
+
+/// Message about a wrong PICK parameter.
+#define PICK_WRONG_PARAM_MESSAGE "PICK WRONG PARAMETER"
+
+/// Error code of a wrong ROLL parameter.
+#define ROLL_WRONG_PARAM_CODE 10
+
+/// Message about a wrong ROLL parameter.
+#define ROLL_WRONG_PARAM_MESSAGE "ROLL WRONG PARAMETER"
+
+/// Error code of a wrong REPEAT parameter.
+#define REPEAT_WRONG_PARAM_CODE 11
+
+/// Message about a wrong REPEAT parameter.
+#define REPEAT_WRONG_PARAM_MESSAGE "REPEAT WRONG PARAMETER"
+
+/// Error code of a block without END.
+#define MISSING_END_CODE 12
+
+/// Message about a block without END.
+#define MISSING_END_MESSAGE "MISSING END"
+
+/// Error code of a wrong name of a macro.
+#define MACRO_WRONG_NAME_CODE 13
+
+/// Message about a wrong name of a macro.
+#define MACRO_WRONG_NAME_MESSAGE "WRONG MACRO"
+
+/// Error code of a call of a macro which is not defined.
+#define MACRO_UNDEFINED_CODE 14
+
+/// Message about a call of a macro which is not defined.
+#define MACRO_UNDEFINED_MESSAGE "UNDEFINED MACRO"
+
+/// Error code of a wrong ADD_N parameter.
+#define ADD_N_WRONG_PARAM_CODE 15
+
+/// Message about a wrong ADD_N parameter.
+#define ADD_N_WRONG_PARAM_MESSAGE "ADD_N WRONG PARAMETER"
+
+/// Error code of a wrong MUL_N parameter.
+#define MUL_N_WRONG_PARAM_CODE 16
+
+/// Message about a wrong MUL_N parameter.
+#define MUL_N_WRONG_PARAM_MESSAGE "MUL_N WRONG PARAMETER"
+
+/// Error code of wrong LINCOMB parameters.
+#define LINCOMB_WRONG_PARAM_CODE 17
+
+/// Message about wrong LINCOMB parameters.
+#define LINCOMB_WRONG_PARAM_MESSAGE "LINCOMB WRONG PARAMETER"
+
+/// Error code of a wrong COEFF parameter.
+#define COEFF_WRONG_PARAM_CODE 18
+
+/// Message about a wrong COEFF parameter.
+#define COEFF_WRONG_PARAM_MESSAGE "COEFF WRONG PARAMETER"
+
+/// Error code of a wrong TRUNC parameter.
+#define TRUNC_WRONG_PARAM_CODE 19
+
+/// Message about a wrong TRUNC parameter.
+#define TRUNC_WRONG_PARAM_MESSAGE "TRUNC WRONG PARAMETER"
+
+/// Error code of a wrong MEM parameter.
+#define MEM_WRONG_PARAM_CODE 20
+
+/// Message about a wrong MEM parameter.
+#define MEM_WRONG_PARAM_MESSAGE "MEM WRONG PARAMETER"
+
+/// Error code of an operation whose result could exceed the set limits.
+#define RESULT_TOO_BIG_CODE 21
+
+/// Message about an operation whose result could exceed the set limits.
+#define RESULT_TOO_BIG_MESSAGE "RESULT TOO BIG"
+
+/// Error code of an operation which ran out of time.
+#define TIMEOUT_CODE 22
+
+/// Message about an operation which ran out of time.
+#define TIMEOUT_MESSAGE "TIMEOUT"
+
 /**
  * Struct storing information if there is any error in the program.
  */
@@ -95,7 +191,7 @@ void ErrorHandlerSetCode(ErrorHandler *handler, int code);
 
  * @details If there was no error, the function returns false, else the switch
  * instruction matches error code to a message and then prints the message
- * to stderr.
+ * to the error stream.
  * @param handler : handler which stores info about an error
  * @return true - if there was an error, else false
  */
@@ -165,4 +261,18 @@ bool IsDegByValid(long long unsigned int n);
  */
 bool IsComposeValid(long long unsigned int n);
 
+/**
+ * Checks if the value of the REPEAT parameter is valid.
+ * @param n : value to check
+ * @return is the value valid
+ */
+bool IsRepeatValid(long long unsigned int n);
+
+/**
+ * Checks if the value of the PICK or ROLL parameter is valid.
+ * @param n : value to check
+ * @return is the value valid
+ */
+bool IsStackDepthValid(long long unsigned int n);
+
 #endif //ERRORHANDLER_H
@@ -0,0 +1,341 @@
+/** @file
+  Implementation of a seeded generator of random polynomials and calculator
+  scripts.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "error_handler.h"
+#include "generator.h"
+#include "input_output.h"
+#include "mono_array.h"
+
+/// Increment of SplitMix64 (the golden ratio).
+#define RANDOM_GAMMA 0x9e3779b97f4a7c15u
+
+/// Highest parameter of COMPOSE, ADD_N and MUL_N in scripts.
+#define MAX_COUNT 4
+
+/// Highest absolute value of the parameter of AT in scripts.
+#define MAX_AT_VALUE 10
+
+/// Name of the command which pushes a literal.
+#define POLY_NAME "POLY"
+
+/// Name of the command which removes the top of the stack.
+#define POP_NAME "POP"
+
+/**
+ * Kind of the parameter of a command of a script.
+ */
+typedef enum GenParam {
+    GEN_PARAM_NONE,     ///< no parameter
+    GEN_PARAM_VAR,      ///< index of a variable
+    GEN_PARAM_VALUE,    ///< value of a variable
+    GEN_PARAM_EXP,      ///< exponent or degree
+    GEN_PARAM_INDEX,    ///< place on the stack, below the top
+    GEN_PARAM_COUNT,    ///< number of polynomials taken from the stack
+} GenParam;
+
+/**
+ * Command which can be used in a script.
+ */
+typedef struct GenCommand {
+    const char *name;   ///< name of the command
+    size_t need;        ///< polynomials it needs, besides its parameter
+    int net;            ///< change of the size of the stack, besides it
+    GenParam param;     ///< kind of its parameter
+    size_t min_param;   ///< lowest parameter of #GEN_PARAM_COUNT
+} GenCommand;
+
+/// Commands which can be used in scripts. A #GEN_PARAM_INDEX command needs
+/// its parameter plus one more polynomial and a #GEN_PARAM_COUNT command
+/// needs and takes as many more polynomials as its parameter.
+static const GenCommand commands[] = {
+    {POLY_NAME, 0, 1, GEN_PARAM_NONE, 0},
+    {"ZERO", 0, 1, GEN_PARAM_NONE, 0},
+    {"CLONE", 1, 1, GEN_PARAM_NONE, 0},
+    {"ADD", 2, -1, GEN_PARAM_NONE, 0},
+    {"SUB", 2, -1, GEN_PARAM_NONE, 0},
+    {"MUL", 2, -1, GEN_PARAM_NONE, 0},
+    {"NEG", 1, 0, GEN_PARAM_NONE, 0},
+    {"IS_COEFF", 1, 0, GEN_PARAM_NONE, 0},
+    {"IS_ZERO", 1, 0, GEN_PARAM_NONE, 0},
+    {"IS_EQ", 2, 0, GEN_PARAM_NONE, 0},
+    {"DEG", 1, 0, GEN_PARAM_NONE, 0},
+    {"DEG_BY", 1, 0, GEN_PARAM_VAR, 0},
+    {"PRINT", 1, 0, GEN_PARAM_NONE, 0},
+    {"POP", 1, -1, GEN_PARAM_NONE, 0},
+    {"AT", 1, 0, GEN_PARAM_VALUE, 0},
+    {"COMPOSE", 1, 0, GEN_PARAM_COUNT, 0},
+    {"SWAP", 2, 0, GEN_PARAM_NONE, 0},
+    {"ROT", 3, 0, GEN_PARAM_NONE, 0},
+    {"PICK", 0, 1, GEN_PARAM_INDEX, 0},
+    {"ROLL", 0, 0, GEN_PARAM_INDEX, 0},
+    {"COEFF", 1, 0, GEN_PARAM_EXP, 0},
+    {"TRUNC", 1, 0, GEN_PARAM_EXP, 0},
+    {"LEAD", 1, 0, GEN_PARAM_NONE, 0},
+    {"ADD_N", 0, 1, GEN_PARAM_COUNT, 2},
+    {"MUL_N", 0, 1, GEN_PARAM_COUNT, 2},
+};
+
+/// Number of commands which can be used in scripts.
+#define COMMAND_COUNT (sizeof(commands) / sizeof(commands[0]))
+
+void GenInit(Generator *g, uint64_t seed) {
+    g->state = seed;
+}
+
+uint64_t GenRandom(Generator *g) {
+    uint64_t x = (g->state += RANDOM_GAMMA);
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9u;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebu;
+    return x ^ (x >> 31);
+}
+
+uint64_t GenRange(Generator *g, uint64_t low, uint64_t high) {
+    if (high - low == UINT64_MAX) {
+        return GenRandom(g);
+    }
+    return low + GenRandom(g) % (high - low + 1);
+}
+
+double GenFraction(Generator *g) {
+    return (double) (GenRandom(g) >> 11) / (double) (1ull << 53);
+}
+
+size_t GenRound(Generator *g, double x) {
+    size_t whole = (size_t) x;
+    return whole + (GenFraction(g) < x - (double) whole);
+}
+
+/**
+ * Compares two exponents.
+ * @param a : first exponent
+ * @param b : second exponent
+ * @return result of comparison
+ */
+static int GenCompare(const void *a, const void *b) {
+    poly_exp_t x = *(const poly_exp_t *) a, y = *(const poly_exp_t *) b;
+    return (x > y) - (x < y);
+}
+
+void GenExps(Generator *g, poly_exp_t *exps, size_t count, poly_exp_t low,
+             poly_exp_t high) {
+    uint64_t range = (uint64_t) high - (uint64_t) low + 1;
+
+    if (count * 4 >= range) {   // selection sampling
+        size_t chosen = 0;
+        for (uint64_t i = 0; i < range && chosen < count; i++) {
+            if (GenRandom(g) % (range - i) < count - chosen) {
+                exps[chosen++] = (poly_exp_t) ((uint64_t) low + i);
+            }
+        }
+        return;
+    }
+
+    size_t drawn = 0;
+    while (drawn < count) {
+        exps[drawn++] = (poly_exp_t) GenRange(g, (uint64_t) low,
+                                              (uint64_t) high);
+        if (drawn == count) {
+            qsort(exps, count, sizeof(poly_exp_t), GenCompare);
+            size_t unique = 1;
+            for (size_t i = 1; i < count; i++) {
+                if (exps[i] != exps[unique - 1]) {
+                    exps[unique++] = exps[i];
+                }
+            }
+            drawn = unique;
+        }
+    }
+}
+
+/**
+ * Generates a random polynomial of a level of a shape.
+ * @param g : generator
+ * @param shape : shape
+ * @param level : level of the polynomial, the number of variables
+ * for constants
+ * @return polynomial
+ */
+static Poly GenLevel(Generator *g, const GenShape *shape, size_t level) {
+    if (level == shape->vars) {
+        return PolyFromCoeff((poly_coeff_t) GenRange(
+            g, (uint64_t) shape->min_coeff, (uint64_t) shape->max_coeff));
+    }
+
+    uint64_t range = (uint64_t) shape->max_exp + 1;
+    size_t count = GenRound(g, shape->density * (double) range);
+    if (count == 0) {
+        count = 1;
+    }
+    if (count > range) {
+        count = range;
+    }
+
+    poly_exp_t *exps = malloc(count * sizeof(poly_exp_t));
+    CHECK_PTR(exps);
+    GenExps(g, exps, count, 0, shape->max_exp);
+
+    Mono *monos = MonoNewArray(count);
+    size_t size = 0;
+    for (size_t i = 0; i < count; i++) {
+        bool nested = level + 1 < shape->vars
+                      && (shape->nesting == GEN_NEST_FULL
+                          || (shape->nesting == GEN_NEST_RANDOM
+                              && (GenRandom(g) & 1))
+                          || (shape->nesting == GEN_NEST_CHAIN
+                              && i + 1 == count));
+        Poly coeff = GenLevel(g, shape, nested ? level + 1 : shape->vars);
+        if (!PolyIsZero(&coeff)) {  // zero coefficients can be drawn
+            monos[size++] = MonoFromPoly(&coeff, exps[i]);
+        }
+    }
+    free(exps);
+    return PolyOwnMonos(size, monos);
+}
+
+Poly GenPoly(Generator *g, const GenShape *shape) {
+    return GenLevel(g, shape, 0);
+}
+
+void GenPrintPoly(Generator *g, const GenShape *shape) {
+    Poly p = GenPoly(g, shape);
+    PolyPrint(&p);
+    fputc('\n', OutputStream());
+    PolyDestroy(&p);
+}
+
+/**
+ * Finds a command which can be used in scripts.
+ * @param name : name of the command
+ * @return command or NULL if it is not known
+ */
+static const GenCommand *GenFind(const char *name) {
+    for (size_t i = 0; i < COMMAND_COUNT; i++) {
+        if (strcmp(name, commands[i].name) == 0) {
+            return &commands[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Tells whether a command fits the stack with its lowest parameter.
+ * @param cmd : command
+ * @param depth : size of the stack
+ * @param max_depth : highest size of the stack
+ * @return does it fit
+ */
+static bool GenFits(const GenCommand *cmd, size_t depth, size_t max_depth) {
+    size_t need = cmd->need;
+    int net = cmd->net;
+
+    if (cmd->param == GEN_PARAM_INDEX) {
+        need++;
+    } else if (cmd->param == GEN_PARAM_COUNT) {
+        need += cmd->min_param;
+        net -= (int) cmd->min_param;
+    }
+    return depth >= need && (net <= 0 || depth + (size_t) net <= max_depth);
+}
+
+/**
+ * Prints a command with a random parameter.
+ * @param g : generator
+ * @param script : parameters of the script
+ * @param cmd : command, which fits the stack
+ * @param depth : size of the stack, updated by the command
+ */
+static void GenPrintCommand(Generator *g, const GenScript *script,
+                            const GenCommand *cmd, size_t *depth) {
+    FILE *out = OutputStream();
+    size_t taken = 0;
+
+    if (strcmp(cmd->name, POLY_NAME) == 0) {
+        GenPrintPoly(g, &script->shape);
+        (*depth)++;
+        return;
+    }
+
+    fputs(cmd->name, out);
+    switch (cmd->param) {
+        case GEN_PARAM_VAR:
+            fprintf(out, " %llu", (unsigned long long)
+                    GenRange(g, 0, script->shape.vars > 0
+                                   ? script->shape.vars - 1 : 0));
+            break;
+        case GEN_PARAM_VALUE:
+            fprintf(out, " %lld", (long long) GenRange(g, 0, 2 * MAX_AT_VALUE)
+                                  - MAX_AT_VALUE);
+            break;
+        case GEN_PARAM_EXP:
+            fprintf(out, " %llu", (unsigned long long)
+                    GenRange(g, 0, (uint64_t) script->shape.max_exp));
+            break;
+        case GEN_PARAM_INDEX:
+            fprintf(out, " %llu", (unsigned long long)
+                    GenRange(g, 0, *depth - 1));
+            break;
+        case GEN_PARAM_COUNT: {
+            size_t high = *depth - cmd->need;
+            taken = (size_t) GenRange(g, cmd->min_param,
+                                      high < MAX_COUNT ? high : MAX_COUNT);
+            fprintf(out, " %zu", taken);
+            break;
+        }
+        default:
+            break;
+    }
+    fputc('\n', out);
+    *depth = (size_t) ((long long) *depth + cmd->net) - taken;
+}
+
+bool GenPrintScript(Generator *g, const GenScript *script) {
+    const GenCommand **mix = malloc(script->mix_count
+                                    * sizeof(const GenCommand *));
+    CHECK_PTR(mix);
+
+    for (size_t i = 0; i < script->mix_count; i++) {
+        mix[i] = GenFind(script->mix[i].name);
+        if (mix[i] == NULL) {
+            free(mix);
+            return false;
+        }
+    }
+
+    size_t depth = 0;
+    for (size_t line = 0; line < script->lines; line++) {
+        uint64_t total = 0;
+        for (size_t i = 0; i < script->mix_count; i++) {
+            if (GenFits(mix[i], depth, script->max_depth)) {
+                total += script->mix[i].weight;
+            }
+        }
+
+        const GenCommand *cmd = NULL;
+        if (total > 0) {
+            uint64_t chosen = GenRange(g, 0, total - 1);
+            for (size_t i = 0; cmd == NULL; i++) {
+                if (GenFits(mix[i], depth, script->max_depth)) {
+                    if (chosen < script->mix[i].weight) {
+                        cmd = mix[i];
+                    } else {
+                        chosen -= script->mix[i].weight;
+                    }
+                }
+            }
+        } else {
+            cmd = GenFind(depth == 0 ? POLY_NAME : POP_NAME);
+        }
+        GenPrintCommand(g, script, cmd, &depth);
+    }
+
+    free(mix);
+    return true;
+}
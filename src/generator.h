@@ -0,0 +1,149 @@
+/** @file
+  Interface of a seeded generator of random polynomials and calculator
+  scripts.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "poly.h"
+
+/**
+ * Pattern of nesting of generated polynomials.
+ */
+typedef enum GenNesting {
+    GEN_NEST_FULL,      ///< every coefficient above the last variable nests
+    GEN_NEST_RANDOM,    ///< every such coefficient nests with probability 1/2
+    GEN_NEST_CHAIN,     ///< only the coefficient of the highest exponent nests
+} GenNesting;
+
+/**
+ * Shape of generated polynomials.
+ */
+typedef struct GenShape {
+    size_t vars;            ///< number of variables, 0 for constants
+    poly_exp_t max_exp;     ///< highest exponent of every variable
+    double density;         ///< part of exponents up to it which are used
+    poly_coeff_t min_coeff; ///< lowest coefficient
+    poly_coeff_t max_coeff; ///< highest coefficient
+    GenNesting nesting;     ///< which coefficients are polynomials
+} GenShape;
+
+/**
+ * Command of a generated script together with its weight.
+ */
+typedef struct GenMix {
+    const char *name;       ///< name of the command, POLY for literals
+    unsigned weight;        ///< relative frequency of the command
+} GenMix;
+
+/**
+ * Parameters of a generated script.
+ */
+typedef struct GenScript {
+    size_t lines;           ///< number of lines
+    const GenMix *mix;      ///< commands which are used
+    size_t mix_count;       ///< number of the commands
+    GenShape shape;         ///< shape of literals
+    size_t max_depth;       ///< highest size of the stack
+} GenScript;
+
+/**
+ * State of the generator. Generators with the same seed give the same
+ * polynomials and scripts.
+ */
+typedef struct Generator {
+    uint64_t state;         ///< state of SplitMix64
+} Generator;
+
+/**
+ * Initializes a generator.
+ * @param g : generator
+ * @param seed : seed
+ */
+void GenInit(Generator *g, uint64_t seed);
+
+/**
+ * Draws a random number.
+ * @param g : generator
+ * @return random number
+ */
+uint64_t GenRandom(Generator *g);
+
+/**
+ * Draws a random number from a range.
+ * @param g : generator
+ * @param low : lowest number
+ * @param high : highest number, at least @p low
+ * @return random number
+ */
+uint64_t GenRange(Generator *g, uint64_t low, uint64_t high);
+
+/**
+ * Draws a random fraction.
+ * @param g : generator
+ * @return number from @f$[0, 1)@f$
+ */
+double GenFraction(Generator *g);
+
+/**
+ * Rounds a number to one of the closest integers at random, so that
+ * on average the result is the number.
+ * @param g : generator
+ * @param x : nonnegative number
+ * @return rounded number
+ */
+size_t GenRound(Generator *g, double x);
+
+/**
+ * Draws pairwise different exponents in increasing order.
+ * @param g : generator
+ * @param exps : place for the exponents
+ * @param count : number of exponents, at most @p high - @p low + 1
+ * @param low : lowest exponent
+ * @param high : highest exponent
+ */
+void GenExps(Generator *g, poly_exp_t *exps, size_t count, poly_exp_t low,
+             poly_exp_t high);
+
+/**
+ * Generates a random polynomial. Every non-constant polynomial gets about
+ * @p density times @p max_exp + 1 monomials with different exponents,
+ * at least one, without the ones whose coefficient happens to be 0.
+ * @param g : generator
+ * @param shape : shape of the polynomial
+ * @return polynomial
+ */
+Poly GenPoly(Generator *g, const GenShape *shape);
+
+/**
+ * Generates a random polynomial and prints it as a line to the output
+ * stream, in the format of the calculator.
+ * @param g : generator
+ * @param shape : shape of the polynomial
+ */
+void GenPrintPoly(Generator *g, const GenShape *shape);
+
+/**
+ * @brief Generates a random script and prints it to the output stream.
+ * @details Commands are drawn with their weights among the ones for which
+ * there are enough polynomials on the stack and which wouldn't make it
+ * exceed @p max_depth, so the script doesn't underflow the stack. When no
+ * command of the mix fits, a literal is pushed onto an empty stack and
+ * POP is used otherwise. Parameters of commands are drawn too. Known
+ * commands are the ones which work on the stack: POLY, ZERO, CLONE, ADD,
+ * SUB, MUL, NEG, IS_COEFF, IS_ZERO, IS_EQ, DEG, DEG_BY, PRINT, POP, AT,
+ * COMPOSE, SWAP, ROT, PICK, ROLL, COEFF, TRUNC, LEAD, ADD_N and MUL_N.
+ * @param g : generator
+ * @param script : parameters of the script
+ * @return false if the mix contains an unknown command
+ */
+bool GenPrintScript(Generator *g, const GenScript *script);
+
+#endif //GENERATOR_H
@@ -11,6 +11,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include "input_output.h"
+#include "alloc.h"
 #include "mono_array.h"
 
 /// char that separates coefficient of a monomial from the exponent.
@@ -40,19 +41,19 @@ static Mono MonoDummy() {
 }
 
 void MonoPrint(Mono *m) {
-    printf("%c", OPENING_BRACKET);
+    fprintf(OutputStream(), "%c", OPENING_BRACKET);
     PolyPrint(&(m->p));
-    printf("%c%d)", SEPARATOR, m->exp);
+    fprintf(OutputStream(), "%c%d)", SEPARATOR, m->exp);
 }
 
 void PolyPrint(Poly *p) {
     if (PolyIsCoeff(p)) {
-        printf("%ld", p->coeff);
+        fprintf(OutputStream(), "%ld", p->coeff);
     }
     else {
         MonoPrint(&(p->arr[0]));
         for (size_t i = 1; i < p->size; i++) {
-            printf("%c", PLUS_SIGN);
+            fprintf(OutputStream(), "%c", PLUS_SIGN);
             MonoPrint(&(p->arr[i]));
         }
     }
@@ -146,13 +147,13 @@ Poly PolyRead(char *string, char **last, ErrorHandler *handler) {
 
         if ((string[0] != SEPARATOR && string[0] != NEWLINE
                             && string[0] != NULL_CHAR)
-                            || (string[0] == NULL_CHAR && !feof(stdin))){
+                            || (string[0] == NULL_CHAR && !feof(InputStream()))){
             ErrorHandlerSetCode(handler, WRONG_POLY_CODE);
         }
 
         *last = &string[0];
         Poly to_return = PolyAddMonos(monos.size, monos.mono_array);
-        free(monos.mono_array);
+        MemFree(monos.mono_array);
         return to_return;
     }
     else {
@@ -11,6 +11,7 @@
 
 #include "poly.h"
 #include "error_handler.h"
+#include "streams.h"
 
 /// newline char
 #define NEWLINE '\n'
@@ -31,13 +32,13 @@
 #define FALSE_STRING "0\n"
 
 /**
- * Prints a monomial to standard output.
+ * Prints a monomial to the output stream.
  * @param m : monomial to print
  */
 void MonoPrint(Mono *m);
 
 /**
- * Prints a polynomial to standard output.
+ * Prints a polynomial to the output stream.
  * @param p : polynomial to print.
  */
 void PolyPrint(Poly *p);
@@ -94,18 +95,18 @@ Mono MonoRead(char *string, char **last, ErrorHandler *handler);
 Poly PolyRead(char *string, char **last, ErrorHandler *handler);
 
 /**
- * Prints a logical value true  to standard output.
+ * Prints a logical value true  to the output stream.
  */
 static inline void PrintTrue() {
-    printf(TRUE_STRING);
+    fputs(TRUE_STRING, OutputStream());
 }
 
 /**
- * Prints a logical value false to standard output.
+ * Prints a logical value false to the output stream.
 
  */
 static inline void PrintFalse() {
-    printf(FALSE_STRING);
+    fputs(FALSE_STRING, OutputStream());
 }
 
 #endif //INPUT_OUTPUT_H
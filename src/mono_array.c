@@ -8,22 +8,32 @@
 
 #include "mono_array.h"
 #include <stdlib.h>
+#include "alloc.h"
 #include "error_handler.h"
 
 
 /// Constant to multiply the size if there is a need to allocate more memory.
 #define RESIZE_CONST 2
 
+#ifdef ALLOC_PROFILE
+Mono *MonoNewArrayAt(size_t size, const char *file, int line) {
+    if (size <= 0) {
+        return NULL;
+    }
+
+    return MemAllocAt(size * sizeof (Mono), file, line);
+}
+#else
 Mono *MonoNewArray(size_t size) {
     if (size <= 0) {
         return NULL;
     }
 
-    Mono *ptr_to_new_mono_array = malloc(size * sizeof (Mono));
-    CHECK_PTR(ptr_to_new_mono_array);
+    Mono *ptr_to_new_mono_array = MemAlloc(size * sizeof (Mono));
 
     return ptr_to_new_mono_array;
 }
+#endif
 
 Poly TrimAndInterpretMonoArr(Mono *array_to_resize, size_t used,
                              size_t reserved) {
@@ -45,8 +55,7 @@ Poly TrimAndInterpretMonoArr(Mono *array_to_resize, size_t used,
         return PolyFromSizeAndArray(reserved, array_to_resize);
     }
     else {
-        Mono *for_result = realloc(array_to_resize, used * sizeof (Mono));
-        CHECK_PTR(for_result);
+        Mono *for_result = MemRealloc(array_to_resize, used * sizeof (Mono));
         return PolyFromSizeAndArray(used,for_result);
     }
 }
@@ -75,7 +84,7 @@ void MonoArrayDestroy(Mono *array_to_destroy, size_t size) {
     for (size_t i = 0; i < size; i++) {
         MonoDestroy(&array_to_destroy[i]);
     }
-    free(array_to_destroy);
+    MemFree(array_to_destroy);
 }
 
 DynamicMonoArray NewDynamicMonoArray() {
@@ -85,9 +94,8 @@ DynamicMonoArray NewDynamicMonoArray() {
 void DynamicMonoArrayAdd(DynamicMonoArray *dynamic_array, Mono *mono_to_add) {
     if (dynamic_array->size == dynamic_array->reserved) {
         dynamic_array->reserved = dynamic_array->reserved * RESIZE_CONST + 1;
-        dynamic_array->mono_array = realloc(dynamic_array->mono_array,
+        dynamic_array->mono_array = MemRealloc(dynamic_array->mono_array,
                                       dynamic_array->reserved * sizeof (Mono));
-        CHECK_PTR(dynamic_array->mono_array);
     }
 
     dynamic_array->mono_array[dynamic_array->size++] = *mono_to_add;
@@ -28,6 +28,23 @@ typedef struct DynamicMonoArray {
 */
 Mono *MonoNewArray(size_t size);
 
+#ifdef ALLOC_PROFILE
+
+/**
+ * Returns an array of Mono structures on behalf of a call site, which is
+ * recorded by the allocation profiler instead of the site in #MonoNewArray.
+ * @param[in] size : length of the array
+ * @param[in] file : source file of the call site
+ * @param[in] line : line of the call site
+ * @return pointer to a first element of the array
+ */
+Mono *MonoNewArrayAt(size_t size, const char *file, int line);
+
+/// Returns an array of Mono structures, recording the call site.
+#define MonoNewArray(size) MonoNewArrayAt((size), __FILE__, __LINE__)
+
+#endif
+
 /**
  * @brief Function that fixes the monomial  array after some operations.
  * @brief especially if the array takes up more memory than it needs.
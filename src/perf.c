@@ -0,0 +1,170 @@
+/** @file
+  Implementation of hardware performance counters of the calculator's
+  threads.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef _GNU_SOURCE
+/// Directive necessary for syscall to work.
+#define _GNU_SOURCE
+#endif
+
+#include "perf.h"
+
+PerfSample PerfDelta(const PerfSample *start, const PerfSample *end) {
+    return (PerfSample) {
+        .cycles = end->cycles - start->cycles,
+        .instructions = end->instructions - start->instructions,
+        .cache_misses = end->cache_misses - start->cache_misses,
+        .branch_misses = end->branch_misses - start->branch_misses
+    };
+}
+
+#ifdef HAVE_PERF_EVENT
+
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/// Number of counters in a group.
+#define PERF_COUNTERS 4
+
+/// Descriptor of a counter that is not open.
+#define NO_COUNTER (-1)
+
+/// Types of hardware events, in the order of #PerfSample.
+static const uint64_t perf_events[PERF_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+};
+
+/// Are the counters turned on.
+static bool enabled = false;
+
+/// Descriptors of the counters of the calling thread, the first one leads.
+static _Thread_local int counters[PERF_COUNTERS];
+
+/// Did the calling thread try to open its counters.
+static _Thread_local bool opened = false;
+
+/// Key whose destructor closes the counters of a finishing thread.
+static pthread_key_t close_key;
+
+/// Guards creation of #close_key.
+static pthread_once_t close_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Closes counters of a thread.
+ * @param arg : counters of the thread
+ */
+static void PerfClose(void *arg) {
+    int *fds = arg;
+
+    for (size_t i = 0; i < PERF_COUNTERS; i++) {
+        if (fds[i] != NO_COUNTER) {
+            close(fds[i]);
+            fds[i] = NO_COUNTER;
+        }
+    }
+}
+
+/**
+ * Creates #close_key.
+ */
+static void PerfCreateKey(void) {
+    pthread_key_create(&close_key, PerfClose);
+}
+
+/**
+ * Opens a counter of the calling thread.
+ * @param config : type of the hardware event
+ * @param group : descriptor of the leader or #NO_COUNTER
+ * @return descriptor or #NO_COUNTER
+ */
+static int PerfOpen(uint64_t config, int group) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    long fd = syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+    return fd < 0 ? NO_COUNTER : (int) fd;
+}
+
+/**
+ * Opens the group of counters of the calling thread. If any of them can't
+ * be opened, none is used.
+ * @return are the counters open
+ */
+static bool PerfOpenThread(void) {
+    opened = true;
+    for (size_t i = 0; i < PERF_COUNTERS; i++) {
+        counters[i] = NO_COUNTER;
+    }
+
+    for (size_t i = 0; i < PERF_COUNTERS; i++) {
+        counters[i] = PerfOpen(perf_events[i],
+                               i == 0 ? NO_COUNTER : counters[0]);
+        if (counters[i] == NO_COUNTER) {
+            PerfClose(counters);
+            return false;
+        }
+    }
+
+    pthread_once(&close_once, PerfCreateKey);
+    pthread_setspecific(close_key, counters);
+    return true;
+}
+
+bool PerfEnable(void) {
+    enabled = true;
+    return PerfOpenThread();
+}
+
+bool PerfEnabled(void) {
+    return enabled;
+}
+
+bool PerfRead(PerfSample *sample) {
+    if (!opened) {
+        PerfOpenThread();
+    }
+    if (counters[0] == NO_COUNTER) {
+        return false;
+    }
+
+    uint64_t values[PERF_COUNTERS + 1];     // number of counters, values
+    if (read(counters[0], values, sizeof(values)) != sizeof(values)) {
+        return false;
+    }
+    *sample = (PerfSample) {.cycles = values[1], .instructions = values[2],
+                            .cache_misses = values[3],
+                            .branch_misses = values[4]};
+    return true;
+}
+
+#else
+
+bool PerfEnable(void) {
+    return false;
+}
+
+bool PerfEnabled(void) {
+    return false;
+}
+
+bool PerfRead(PerfSample *sample) {
+    (void) sample;
+    return false;
+}
+
+#endif
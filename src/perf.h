@@ -0,0 +1,56 @@
+/** @file
+  Interface of hardware performance counters of the calculator's threads.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Values of hardware performance counters.
+ */
+typedef struct PerfSample {
+    uint64_t cycles;            ///< CPU cycles
+    uint64_t instructions;      ///< retired instructions
+    uint64_t cache_misses;      ///< last level cache misses
+    uint64_t branch_misses;     ///< mispredicted branches
+} PerfSample;
+
+/**
+ * @brief Turns on the counters.
+ * @details It should be called before any other thread is started. Each
+ * thread opens its own counters the first time it reads them. Counting
+ * user space is enough, so it works for unprivileged users when
+ * perf_event_paranoid is at most 2.
+ * @return could the counters be opened for the calling thread
+ */
+bool PerfEnable(void);
+
+/**
+ * Tells whether the counters are turned on.
+ * @return are they turned on
+ */
+bool PerfEnabled(void);
+
+/**
+ * Reads the counters of the calling thread.
+ * @param sample : place for the values
+ * @return false if the counters are not available in the thread
+ */
+bool PerfRead(PerfSample *sample);
+
+/**
+ * Computes how much the counters grew between two readings.
+ * @param start : earlier reading
+ * @param end : later reading
+ * @return differences of the counters
+ */
+PerfSample PerfDelta(const PerfSample *start, const PerfSample *end);
+
+#endif //PERF_H
@@ -8,6 +8,8 @@
 
 #include <stdlib.h>
 #include "poly.h"
+#include "alloc.h"
+#include "cancel.h"
 #include "mono_array.h"
 #include "error_handler.h"
 
@@ -27,6 +29,10 @@
  */ 
 #define SMALL_VALUE (-1)
 
+/// Products of constant terms computed by the calling thread, which
+/// measure the progress of long operations (see #CancelPoll).
+static _Thread_local uint64_t term_products = 0;
+
 void PolyDestroy(Poly *p) {
     assert(p != NULL);
 
@@ -34,7 +40,7 @@ void PolyDestroy(Poly *p) {
         for (size_t i = 0; i < p->size; i++) {
             MonoDestroy(&p->arr[i]);
         }
-        free(p->arr);
+        MemFree(p->arr);
         p->arr = NULL;
     }
 }
@@ -260,6 +266,51 @@ Poly PolyAdd(const Poly *p, const Poly *q) {
     }
 }
 
+/**
+ * Sums monomials like #PolyAddMonos, but in the array itself, which is
+ * taken over together with its contents.
+ * @param[in] count : number of monomials
+ * @param[in] monos : array of monomials allocated on the heap or NULL
+ * if @p count is 0
+ * @return polynomial that is a sum of monomials
+ */
+static Poly PolyCombineMonos(size_t count, Mono *monos) {
+    if (count == 0) {
+        MemFree(monos);
+        return PolyZero();
+    }
+
+    MonoSort(monos, count);
+
+    size_t new_index = 0;
+    for (size_t i = 1; i < count; i++) {
+        Mono to_destroy = monos[i];
+        if (MonoGetExp(&monos[new_index]) == MonoGetExp(&monos[i])) {
+            Mono new_mono = MonoAdd(&monos[new_index], &monos[i]);
+            MonoDestroy(&(monos[new_index]));
+            monos[new_index] = new_mono;
+        }
+        else {
+            if (!PolyIsZero(&monos[new_index].p)) {
+                new_index += 1;
+            }
+            else {
+                MonoDestroy(&monos[new_index]);
+            }
+            monos[new_index] = to_destroy;
+            continue;   // moved, not destroyed
+        }
+        MonoDestroy(&to_destroy);
+    }
+
+    size_t used = new_index + 1;
+    if (PolyIsZero(&monos[new_index].p)) {    // last sum got reduced
+        MonoDestroy(&monos[new_index]);
+        used--;
+    }
+    return TrimAndInterpretMonoArr(monos, used, count);
+}
+
 Poly PolyAddMonos(size_t count, const Mono monos[]) {
     if (count == 0) {
         return PolyZero();
@@ -269,29 +320,238 @@ Poly PolyAddMonos(size_t count, const Mono monos[]) {
     for (size_t i = 0; i < count; i++) {
         copy_array[i] = monos[i];
     }
+    return PolyCombineMonos(count, copy_array);
+}
 
-    MonoSort(copy_array, count);
+/**
+ * Head of a polynomial in the heap of #PolyMerge - the smallest exponent
+ * of the polynomial that is not merged yet.
+ */
+typedef struct SumHead {
+    poly_exp_t exp;     ///< exponent
+    size_t source;      ///< index of the polynomial
+} SumHead;
 
-    size_t new_index = 0;
-    for (size_t i = 1; i < count; i++) {
-        Mono to_destroy = copy_array[i];
-        if (MonoGetExp(&copy_array[new_index]) == MonoGetExp(&copy_array[i])) {
-            Mono new_mono = MonoAdd(&copy_array[new_index], &copy_array[i]);
-            MonoDestroy(&(copy_array[new_index]));
-            copy_array[new_index] = new_mono;
+/**
+ * Moves the last element of a heap up to its place.
+ * @param heap : binary min-heap ordered by the exponents
+ * @param size : number of elements, with the moved one
+ */
+static void SumHeapUp(SumHead *heap, size_t size) {
+    size_t child = size - 1;
+    SumHead moved = heap[child];
+
+    while (child > 0 && heap[(child - 1) / 2].exp > moved.exp) {
+        heap[child] = heap[(child - 1) / 2];
+        child = (child - 1) / 2;
+    }
+    heap[child] = moved;
+}
+
+/**
+ * Moves the first element of a heap down to its place.
+ * @param heap : binary min-heap ordered by the exponents
+ * @param size : number of elements
+ */
+static void SumHeapDown(SumHead *heap, size_t size) {
+    size_t parent = 0;
+    SumHead moved = heap[0];
+
+    for (;;) {
+        size_t child = 2 * parent + 1;
+        if (child >= size) {
+            break;
         }
-        else {
-            if (!PolyIsZero(&copy_array[new_index].p)) {
-                new_index += 1;
+        if (child + 1 < size && heap[child + 1].exp < heap[child].exp) {
+            child++;
+        }
+        if (heap[child].exp >= moved.exp) {
+            break;
+        }
+        heap[parent] = heap[child];
+        parent = child;
+    }
+    heap[parent] = moved;
+}
+
+/**
+ * Returns a factor of a polynomial in #PolyMerge.
+ * @param[in] factors : factors or NULL if all of them are 1
+ * @param[in] i : index of the polynomial
+ * @return factor
+ */
+static inline poly_coeff_t Factor(const poly_coeff_t factors[], size_t i) {
+    return factors == NULL ? 1 : factors[i];
+}
+
+/**
+ * @brief Adds polynomials multiplied by constant factors.
+ * @details Performs a k-way merge of the monomial arrays. A heap gives the
+ * smallest exponent which is not merged yet; coefficients of all of the
+ * monomials with that exponent are merged recursively with their factors,
+ * which are applied only to the constants at the bottom. Monomials which
+ * cancel out are dropped right away.
+ * @param[in] count : number of polynomials
+ * @param[in] polys : polynomials
+ * @param[in] factors : factors or NULL if all of them are 1
+ * @return @f$\sum_i factors_i \cdot polys_i@f$
+ */
+static Poly PolyMerge(size_t count, const Poly polys[],
+                      const poly_coeff_t factors[]) {
+    poly_coeff_t constant = 0;
+    size_t total = 1;
+    size_t heap_size = 0;
+    size_t last = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (PolyIsCoeff(&polys[i])) {
+            constant += Factor(factors, i) * polys[i].coeff;
+        }
+        else if (Factor(factors, i) != 0) {
+            total += polys[i].size;
+            heap_size++;
+            last = i;
+        }
+    }
+    if (heap_size == 0) {
+        return PolyFromCoeff(constant);
+    }
+    else if (heap_size == 1 && constant == 0 && Factor(factors, last) == 1) {
+        return PolyClone(&polys[last]);
+    }
+
+    SumHead *heap = MemTryAlloc(heap_size * sizeof(SumHead));
+    size_t *next = MemTryAlloc(count * sizeof(size_t));
+    Poly *group = MemTryAlloc((heap_size + 1) * sizeof(Poly));
+    poly_coeff_t *group_factors = NULL;
+    if (factors != NULL) {
+        group_factors = MemTryAlloc((heap_size + 1) * sizeof(poly_coeff_t));
+    }
+    Mono *result = MemTryAlloc(total * sizeof(Mono));
+
+    if (heap == NULL || next == NULL || group == NULL || result == NULL
+        || (factors != NULL && group_factors == NULL)) {
+        // out of memory in a watched operation, which is cancelled
+        MemFree(heap);
+        MemFree(next);
+        MemFree(group);
+        MemFree(group_factors);
+        MemFree(result);
+        return PolyZero();
+    }
+
+    heap_size = 0;
+    for (size_t i = 0; i < count; i++) {
+        next[i] = 0;
+        if (!PolyIsCoeff(&polys[i]) && Factor(factors, i) != 0) {
+            heap[heap_size++] = (SumHead) {.exp = polys[i].arr[0].exp,
+                                           .source = i};
+            SumHeapUp(heap, heap_size);
+        }
+    }
+
+    size_t used = 0;
+    bool constant_left = constant != 0;
+
+    while (heap_size > 0) {
+        poly_exp_t exp = heap[0].exp;
+        size_t group_size = 0;
+
+        if (exp == 0 && constant_left) {
+            if (group_factors != NULL) {
+                group_factors[group_size] = 1;
+            }
+            group[group_size++] = PolyFromCoeff(constant);
+            constant_left = false;
+        }
+        else if (constant_left) {       // no polynomial has a free term
+            Poly free_term = PolyFromCoeff(constant);
+            result[used++] = MonoFromPoly(&free_term, 0);
+            constant_left = false;
+        }
+
+        // takes the monomials with this exponent from all of the polynomials
+        while (heap_size > 0 && heap[0].exp == exp) {
+            size_t i = heap[0].source;
+            if (group_factors != NULL) {
+                group_factors[group_size] = factors[i];
+            }
+            group[group_size++] = polys[i].arr[next[i]++].p;
+
+            if (next[i] < polys[i].size) {
+                heap[0].exp = polys[i].arr[next[i]].exp;
             }
             else {
-                MonoDestroy(&copy_array[new_index]);
+                heap[0] = heap[--heap_size];
             }
-            copy_array[new_index] = MonoClone(&copy_array[i]);
+            SumHeapDown(heap, heap_size);
         }
-        MonoDestroy(&to_destroy);
+
+        Poly sum = group_size == 1 && Factor(group_factors, 0) == 1
+                   ? PolyClone(&group[0])
+                   : PolyMerge(group_size, group, group_factors);
+        if (!PolyIsZero(&sum)) {
+            result[used++] = MonoFromPoly(&sum, exp);
+        }
+    }
+
+    MemFree(heap);
+    MemFree(next);
+    MemFree(group);
+    MemFree(group_factors);
+    return TrimAndInterpretMonoArr(result, used, total);
+}
+
+Poly PolySumMany(size_t count, const Poly polys[]) {
+    return PolyMerge(count, polys, NULL);
+}
+
+Poly PolyLinComb(size_t count, const poly_coeff_t coeffs[],
+                 const Poly polys[]) {
+    return PolyMerge(count, polys, coeffs);
+}
+
+/**
+ * Multiplies polynomials in a balanced tree, so that the factors of each
+ * multiplication have similar sizes.
+ * @param[in] count : number of polynomials, at least 2
+ * @param[in] polys : polynomials
+ * @return product of the polynomials
+ */
+static Poly PolyProductTree(size_t count, const Poly polys[]) {
+    size_t half = count / 2;
+    Poly left, right;
+    const Poly *left_ptr = &polys[0], *right_ptr = &polys[half];
+
+    if (half > 1) {
+        left = PolyProductTree(half, polys);
+        left_ptr = &left;
+    }
+    if (count - half > 1) {
+        right = PolyProductTree(count - half, &polys[half]);
+        right_ptr = &right;
+    }
+
+    Poly result = PolyMul(left_ptr, right_ptr);
+    if (half > 1) {
+        PolyDestroy(&left);
+    }
+    if (count - half > 1) {
+        PolyDestroy(&right);
+    }
+    return result;
+}
+
+Poly PolyProductMany(size_t count, const Poly polys[]) {
+    if (count == 0) {
+        return PolyFromCoeff(1);
+    }
+    else if (count == 1) {
+        return PolyClone(&polys[0]);
+    }
+    else {
+        return PolyProductTree(count, polys);
     }
-    return TrimAndInterpretMonoArr(copy_array,  new_index + 1,new_index+ 1);
 }
 
 /**
@@ -315,44 +575,50 @@ static Poly PolyMulCoeffAndNonCoeff(const Poly *p, const Poly *q) {
         return PolyZero();
     }
 
-    Mono *result = MonoNewArray(p->size);
+    Mono *result = MemTryAlloc(p->size * sizeof(Mono));
+    if (result == NULL) {   // the watched operation is cancelled
+        return PolyZero();
+    }
 
     for (size_t i = 0; i < p->size; i++) {
         result[i] = MonoMulCoeff(&p->arr[i], q);
     }
 
-    Poly to_return = PolyAddMonos(p->size, result);
-    free(result);
-
-    return to_return;
+    return PolyCombineMonos(p->size, result);
 }
 
 Poly PolyMul(const Poly *p, const Poly *q) {
     assert(p != NULL && q != NULL);
 
     if (PolyIsCoeff(p) && PolyIsCoeff(q)) {
+        term_products++;
         return PolyFromCoeff(q->coeff * p->coeff);
     }
     else if (PolyIsCoeff(p) || PolyIsCoeff(q)) {
         return PolyMulCoeffAndNonCoeff(p, q);
     }
+    else if (CancelPoll(term_products)) {
+        return PolyZero();
+    }
     else { // both are not constant
-        Mono *new_array = MonoNewArray(p->size * q->size);
+        Mono *new_array = MemTryAlloc(p->size * q->size * sizeof(Mono));
         size_t new_index = 0;
+        if (new_array == NULL) {    // the watched operation is cancelled
+            return PolyZero();
+        }
         for (size_t i = 0; i < p->size; i++) {
             for (size_t j = 0; j < q->size; j++) {
                 Mono new_mono = MonoMul(&p->arr[i], &q->arr[j]);
                 new_array[new_index++] = new_mono;
+                if (CancelPoll(term_products)) {
+                    // frees the partial product without merging it
+                    MonoArrayDestroy(new_array, new_index);
+                    return PolyZero();
+                }
             }
         }
 
-        Mono *new_smaller_array = realloc(new_array ,new_index * sizeof (Mono));
-        CHECK_PTR(new_smaller_array);
-
-        Poly resulting_poly = PolyAddMonos(new_index, new_smaller_array);
-        free(new_smaller_array);
-
-        return resulting_poly;
+        return PolyCombineMonos(new_index, new_array);
     }
 }
 
@@ -427,6 +693,38 @@ poly_exp_t PolyDeg(const Poly *p) {
     }
 }
 
+size_t PolyTermCount(const Poly *p) {
+    assert(p != NULL);
+
+    if (PolyIsCoeff(p)) {
+        return PolyIsZero(p) ? 0 : 1;
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < p->size; i++) {
+        count += PolyTermCount(&p->arr[i].p);
+    }
+    return count;
+}
+
+size_t PolyNodeCount(const Poly *p) {
+    assert(p != NULL);
+
+    if (PolyIsCoeff(p)) {
+        return 0;
+    }
+
+    size_t count = p->size;
+    for (size_t i = 0; i < p->size; i++) {
+        count += PolyNodeCount(&p->arr[i].p);
+    }
+    return count;
+}
+
+size_t PolyByteSize(const Poly *p) {
+    return PolyNodeCount(p) * sizeof(Mono);
+}
+
 bool PolyIsEq(const Poly *p, const Poly *q) {
     assert(p != NULL && q != NULL);
 
@@ -459,29 +757,122 @@ Poly PolyAt(const Poly *p, poly_coeff_t x) {
             return PolyClone(p);
         }
 
-        Poly result = PolyZero();
+        Poly *values = MemAlloc(p->size * sizeof(Poly));
+        for (size_t i = 0; i < p->size; i++) {
+            values[i] = MonoAt(&p->arr[i], x);
+        }
+
+        Poly result = PolySumMany(p->size, values);
 
         for (size_t i = 0; i < p->size; i++) {
-            Poly to_destroy = result; //old
-            Poly new_poly = MonoAt(&p->arr[i], x);
+            PolyDestroy(&values[i]);
+        }
+        MemFree(values);
+        return result;
+    }
+
+/**
+ * Finds a monomial with a given exponent, using binary search on the sorted
+ * array of monomials.
+ * @param[in] p : polynomial which is not a coefficient
+ * @param[in] exp : exponent
+ * @return index of the monomial or size of @p p if there is none
+ */
+static size_t MonoFind(const Poly *p, poly_exp_t exp) {
+    size_t begin = 0, end = p->size;
 
-            result = PolyAdd(&result, &new_poly);
+    while (begin < end) {
+        size_t middle = begin + (end - begin) / 2;
+        if (p->arr[middle].exp < exp) {
+            begin = middle + 1;
+        }
+        else {
+            end = middle;
+        }
+    }
+    return begin < p->size && p->arr[begin].exp == exp ? begin : p->size;
+}
+
+const Poly *PolyCoeffOf(const Poly *p, poly_exp_t exp) {
+    assert(p != NULL);
+
+    if (PolyIsCoeff(p)) {
+        return exp == 0 && !PolyIsZero(p) ? p : NULL;
+    }
+
+    size_t index = MonoFind(p, exp);
+    return index < p->size ? &p->arr[index].p : NULL;
+}
 
-            PolyDestroy(&new_poly);
-            PolyDestroy(&to_destroy);
+void PolyToCoeff(Poly *p, poly_exp_t exp) {
+    assert(p != NULL);
+
+    if (PolyIsCoeff(p)) {
+        if (exp != 0) {
+            *p = PolyZero();
         }
+        return;
+    }
 
-        return result;
+    Poly coeff = PolyZero();
+    size_t index = MonoFind(p, exp);
+    if (index < p->size) {      // moves the coefficient out
+        coeff = p->arr[index].p;
+        p->arr[index].p = PolyZero();
+    }
+    PolyDestroy(p);
+    *p = coeff;
+}
+
+void PolyTruncate(Poly *p, poly_exp_t deg) {
+    assert(p != NULL);
+
+    if (deg < 0) {
+        PolyDestroy(p);
+        *p = PolyZero();
+        return;
+    }
+    if (PolyIsCoeff(p)) {
+        return;
     }
 
+    size_t used = 0;
+    for (size_t i = 0; i < p->size; i++) {
+        Mono *m = &p->arr[i];
+
+        if (m->exp > deg) {
+            MonoDestroy(m);
+            continue;
+        }
+        PolyTruncate(&m->p, deg - m->exp);
+        if (!PolyIsZero(&m->p)) {
+            p->arr[used++] = *m;
+        }
+    }
+    *p = TrimAndInterpretMonoArr(p->arr, used, p->size);
+}
+
+void PolyToLead(Poly *p) {
+    assert(p != NULL);
+
+    if (PolyIsCoeff(p)) {
+        return;
+    }
+
+    for (size_t i = 0; i + 1 < p->size; i++) {
+        MonoDestroy(&p->arr[i]);
+    }
+    p->arr[0] = p->arr[p->size - 1];
+    PolyToLead(&p->arr[0].p);
+    *p = TrimAndInterpretMonoArr(p->arr, 1, p->size);
+}
+
 Poly PolyOwnMonos(size_t count, Mono *monos) {
     if (monos == NULL) {
         return PolyZero();
     }
     else {
-        Poly to_return = PolyAddMonos(count, monos);
-        free(monos);
-        return to_return;
+        return PolyCombineMonos(count, monos);
     }
 }
 
@@ -496,7 +887,7 @@ Poly PolyCloneMonos(size_t count, const Mono monos[]) {
         }
 
         Poly to_return = PolyAddMonos(count, clone_mono_array);
-        free(clone_mono_array);
+        MemFree(clone_mono_array);
         return to_return;
     }
 }
@@ -508,7 +899,10 @@ Poly PolyCloneMonos(size_t count, const Mono monos[]) {
  * @return : polynomial @f$p@f$ multiplied by itself @f$exp@f$ times.
  */
 static Poly PolyPower(const Poly *p, poly_exp_t exp) {
-    if (exp == 0) {
+    if (CancelPoll(term_products)) {
+        return PolyZero();
+    }
+    else if (exp == 0) {
         return PolyFromCoeff(1);
     }
     else if (exp == 1) {
@@ -585,16 +979,23 @@ static Poly PolyComposeHelper(const Poly *p, size_t k, size_t var_id,
         return PolyClone(p);
     }
     else {
-        Poly result = PolyZero();
-        Poly to_destroy;
-        Poly result_of_mono_compose;
-        for (size_t i = 0; i < p->size; i++) {
-            to_destroy = result;
-            result_of_mono_compose = MonoComposeHelper(&p->arr[i], k, var_id,q);
-            result = PolyAdd(&result, &result_of_mono_compose);
-            PolyDestroy(&to_destroy);
-            PolyDestroy(&result_of_mono_compose);
+        Poly *results = MemTryAlloc(p->size * sizeof(Poly));
+        size_t done = 0;
+        if (results == NULL) {  // the watched operation is cancelled
+            return PolyZero();
+        }
+        while (done < p->size && !CancelPoll(term_products)) {
+            results[done] = MonoComposeHelper(&p->arr[done], k, var_id, q);
+            done++;
+        }
+
+        Poly result = done == p->size ? PolySumMany(done, results)
+                                      : PolyZero();
+
+        for (size_t i = 0; i < done; i++) {
+            PolyDestroy(&results[i]);
         }
+        MemFree(results);
         return result;
     }
 }
@@ -207,6 +207,33 @@ static inline Mono MonoAdd(const Mono *m, const Mono *n) {
  */
 Poly PolyAddMonos(size_t count, const Mono monos[]);
 
+/**
+ * @brief Adds an array of polynomials.
+ * @details Performs a k-way merge of the monomial arrays. A heap gives the
+ * smallest exponent which is not merged yet; coefficients of all of the
+ * monomials with that exponent are summed recursively in the same way.
+ * Each monomial is copied at most once, unlike in a chain of #PolyAdd,
+ * which copies the growing sum again for every polynomial.
+ * @param[in] count : number of polynomials
+ * @param[in] polys : polynomials
+ * @return sum of the polynomials (0 if @p count is 0)
+ */
+Poly PolySumMany(size_t count, const Poly polys[]);
+
+/**
+ * @brief Computes a linear combination of polynomials.
+ * @details Works like #PolySumMany, in a single merge of all of the
+ * polynomials. Coefficients are multiplied by the factors while the result
+ * is built, so no scaled copies are made, and terms which cancel out are
+ * dropped right away.
+ * @param[in] count : number of polynomials
+ * @param[in] coeffs : factors @f$c_i@f$
+ * @param[in] polys : polynomials @f$p_i@f$
+ * @return @f$\sum_i c_i \cdot p_i@f$
+ */
+Poly PolyLinComb(size_t count, const poly_coeff_t coeffs[],
+                 const Poly polys[]);
+
 /**
  * @brief Multiplies two polynomials.
  * @details Function creates monomials by multiplying each
@@ -214,12 +241,23 @@ Poly PolyAddMonos(size_t count, const Mono monos[]);
  * @f$\deg(p) \cdot \deg(q)@f$.
  * Next - if needed, decreases the size of this array and using
  *  PolyAddMonos creates a polynomial that is a product.
+ * Checks #CancelPoll after every product of monomials; if it tells to stop,
+ * frees what it computed and returns 0 at once.
  * @param[in] p : polynomial @f$p@f$
  * @param[in] q : polynomial @f$q@f$
  * @return @f$p * q@f$
  */
 Poly PolyMul(const Poly *p, const Poly *q);
 
+/**
+ * Multiplies an array of polynomials. The product is computed in a balanced
+ * tree, so that the factors of each multiplication have similar sizes.
+ * @param[in] count : number of polynomials
+ * @param[in] polys : polynomials
+ * @return product of the polynomials (1 if @p count is 0)
+ */
+Poly PolyProductMany(size_t count, const Poly polys[]);
+
 /**
  * Multiplies two monomials.
  * @param[in] m : monomial
@@ -308,6 +346,31 @@ static inline poly_exp_t MonoDeg(const Mono *m) {
     return m->exp + PolyDeg(&m->p);
 }
 
+/**
+ * Counts the terms of a polynomial written as a sum of products of
+ * variables, that is its nonzero constant coefficients.
+ * @param[in] p : polynomial
+ * @return number of terms
+ */
+size_t PolyTermCount(const Poly *p);
+
+/**
+ * Counts the monomials of a polynomial on all of the levels of its
+ * recursive representation.
+ * @param[in] p : polynomial
+ * @return number of monomials
+ */
+size_t PolyNodeCount(const Poly *p);
+
+/**
+ * Computes the heap memory taken by a polynomial. Arrays of monomials of
+ * polynomials are always exactly as long as needed, so this is the size of
+ * all of its monomials.
+ * @param[in] p : polynomial
+ * @return number of bytes
+ */
+size_t PolyByteSize(const Poly *p);
+
 /**
  * @brief Determines the equality of two polynomials.
  * @details After checking trivial cases, checks if number of monomials
@@ -336,14 +399,48 @@ static inline bool MonoIsEq(const Mono *m, const Mono *n) {
  * the variables' indices are decreased by 1.
  * Formally, for polynomial @f$p(x_0, x_1, x_2, \ldots)@f$, the result is
  * a polynomial @f$p(x, x_0, x_1, \ldots)@f$.
- * Creates a zero polynomial and then adds to it values of each monomial in
- * @p p, freeing the memory along the way.
+ * Computes values of each monomial in @p p and adds them all at once with
+ * #PolySumMany.
  * @param[in] p : polynomial @f$p@f$
  * @param[in] x : value of the argument @f$x@f$
  * @return @f$p(x, x_0, x_1, \ldots)@f$
  */
 Poly PolyAt(const Poly *p, poly_coeff_t x);
 
+/**
+ * Finds the coefficient of @f$x_0^{exp}@f$ using binary search on the sorted
+ * exponents. Nothing is copied - the result points into @p p.
+ * @param[in] p : polynomial
+ * @param[in] exp : exponent of @f$x_0@f$
+ * @return coefficient, as a polynomial of @f$x_1, x_2, \ldots@f$, or NULL
+ * if it is 0
+ */
+const Poly *PolyCoeffOf(const Poly *p, poly_exp_t exp);
+
+/**
+ * Replaces a polynomial with its coefficient of @f$x_0^{exp}@f$, with
+ * the indices of the variables decreased by 1 like in #PolyAt.
+ * The coefficient is moved out of the polynomial, not copied.
+ * @param[in,out] p : polynomial
+ * @param[in] exp : exponent of @f$x_0@f$
+ */
+void PolyToCoeff(Poly *p, poly_exp_t exp);
+
+/**
+ * Removes terms of total degree higher than @p deg from a polynomial,
+ * in place. Coefficients which become 0 are removed too.
+ * @param[in,out] p : polynomial
+ * @param[in] deg : highest kept degree, a negative one removes everything
+ */
+void PolyTruncate(Poly *p, poly_exp_t deg);
+
+/**
+ * Replaces a polynomial with its leading term in the lexicographic order
+ * (the highest power of @f$x_0@f$, then of @f$x_1@f$ and so on), in place.
+ * @param[in,out] p : polynomial
+ */
+void PolyToLead(Poly *p);
+
 /**
  * Computes @p nth power of @p x.
  * Uses the fast exponentiation algorithm.
@@ -409,6 +506,7 @@ Poly PolyCloneMonos(size_t count, const Mono monos[]);
  * for @f$i=0,1,2,...,min(k,l) - 1@f$ in @f$p@f$. If @f$k<l@f$ then
  * variables @f$x_k,...,x_{l-1}@f$ are replaced with 0. For example,
  * if @f$k=0@f$ then the result of compose is @f$p(0,0,0,...)@f$.
+ * Like #PolyMul, it stops early and returns 0 when #CancelPoll tells it to.
  * @param p : polynomial that will have its variables replaced
  * @param k : number of polynomials in array
  * @param q : array of polynomials for replacing
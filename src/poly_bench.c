@@ -0,0 +1,451 @@
+/** @file
+  Microbenchmarks of the operations of the polynomial library.
+
+  Every operation of poly.h is run on pairs of polynomials of a few
+  families (sparse and dense, shallow and deep, small and huge). After
+  warmup runs each case is timed a number of times and a line of JSON
+  with the median and percentiles of the times is written to the standard
+  output.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef _POSIX_C_SOURCE
+/// Directive necessary for clock_gettime to work.
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "error_handler.h"
+#include "generator.h"
+#include "poly.h"
+
+/// Default number of timed runs of a case.
+#define DEFAULT_RUNS 21
+
+/// Default number of warmup runs of a case.
+#define DEFAULT_WARMUP 3
+
+/// Number of timed runs which are always done, whatever the time budget.
+#define MIN_RUNS 5
+
+/// Time after which no more warmup or timed runs of a case are started.
+#define TIME_BUDGET_NS 1000000000ull
+
+/// Number of nanoseconds in a second.
+#define NS_PER_SECOND 1000000000ull
+
+/// Base of numbers of the arguments.
+#define DECIMAL_BASE 10
+
+/// Value at which polynomials are evaluated by At.
+#define AT_VALUE 3
+
+/// Usage message of the program.
+#define USAGE_MESSAGE "usage: poly_bench [-r runs] [-w warmup] [operation...]\n"
+
+/**
+ * Family of generated polynomials.
+ */
+typedef struct Family {
+    const char *name;       ///< name of the family
+    GenShape shape;         ///< shape of its polynomials
+} Family;
+
+/// Density of sparse families, which draw their exponents from
+/// @f$[0, 2^{20}]@f$.
+#define SPARSE(terms) ((double) (terms) / (double) ((1 << 20) + 1))
+
+/// Families of polynomials.
+static const Family families[] = {
+    {"small-shallow", {1, 7, 1, 1, 10, GEN_NEST_FULL}},
+    {"small-deep", {6, 1, 1, 1, 10, GEN_NEST_FULL}},
+    {"dense-shallow", {1, 511, 1, 1, 1000, GEN_NEST_FULL}},
+    {"sparse-shallow", {1, 1 << 20, SPARSE(512), 1, 1000, GEN_NEST_FULL}},
+    {"dense-deep", {4, 5, 1, 1, 1000, GEN_NEST_FULL}},
+    {"sparse-deep", {4, 1 << 20, SPARSE(6), 1, 1000, GEN_NEST_FULL}},
+    {"chain-deep", {8, 7, 1, 1, 1000, GEN_NEST_CHAIN}},
+    {"huge-shallow", {1, 2047, 1, -1000000, 1000000, GEN_NEST_FULL}},
+    {"huge-deep", {3, 15, 1, -1000000, 1000000, GEN_NEST_FULL}},
+};
+
+/// Number of families.
+#define FAMILY_COUNT (sizeof(families) / sizeof(families[0]))
+
+/// Seed of the generator of operands.
+#define SEED 1
+
+/**
+ * Operands of a benchmarked operation.
+ */
+typedef struct Operands {
+    const Family *family;   ///< family of the polynomials
+    Poly p;                 ///< first polynomial
+    Poly q;                 ///< second polynomial
+    Poly p_copy;            ///< copy of the first one
+    Poly *args;             ///< polynomials substituted by Compose
+    Mono *monos;            ///< monomials of both, for AddMonos
+    size_t mono_count;      ///< number of the monomials
+} Operands;
+
+/**
+ * Benchmarked operation.
+ */
+typedef struct Operation {
+    const char *name;       ///< name of the function, without "Poly"
+    /// Runs the operation; its result is destroyed before the next run.
+    Poly (*run)(Operands *ops, Mono *monos);
+    bool uses_monos;        ///< does it take a fresh copy of the monomials
+} Operation;
+
+/**
+ * Prepares operands of a family.
+ * @param g : generator
+ * @param family : family
+ * @return operands
+ */
+static Operands BenchOperands(Generator *g, const Family *family) {
+    Operands ops = {.family = family, .p = GenPoly(g, &family->shape),
+                    .q = GenPoly(g, &family->shape)};
+    ops.p_copy = PolyClone(&ops.p);
+
+    ops.args = malloc(family->shape.vars * sizeof(Poly));
+    CHECK_PTR(ops.args);
+    for (size_t i = 0; i < family->shape.vars; i++) {  // (i + 2) x_0
+        Poly c = PolyFromCoeff((poly_coeff_t) i + 2);
+        Mono m = MonoFromPoly(&c, 1);
+        ops.args[i] = PolyAddMonos(1, &m);
+    }
+
+    size_t p_size = PolyIsCoeff(&ops.p) ? 0 : ops.p.size;
+    size_t q_size = PolyIsCoeff(&ops.q) ? 0 : ops.q.size;
+    ops.mono_count = p_size + q_size;
+    ops.monos = malloc(ops.mono_count * sizeof(Mono));
+    CHECK_PTR(ops.monos);
+    for (size_t i = 0; i < p_size; i++) {
+        ops.monos[i] = ops.p.arr[i];
+    }
+    for (size_t i = 0; i < q_size; i++) {
+        ops.monos[p_size + i] = ops.q.arr[i];
+    }
+    return ops;
+}
+
+/**
+ * Frees operands.
+ * @param ops : operands
+ */
+static void BenchOperandsDestroy(Operands *ops) {
+    for (size_t i = 0; i < ops->family->shape.vars; i++) {
+        PolyDestroy(&ops->args[i]);
+    }
+    free(ops->args);
+    free(ops->monos);   // shallow copies of monomials of p and q
+    PolyDestroy(&ops->p);
+    PolyDestroy(&ops->q);
+    PolyDestroy(&ops->p_copy);
+}
+
+/**
+ * Runs #PolyAdd.
+ * @param ops : operands
+ * @param monos : unused
+ * @return result
+ */
+static Poly BenchAdd(Operands *ops, Mono *monos) {
+    (void) monos;
+    return PolyAdd(&ops->p, &ops->q);
+}
+
+/**
+ * Runs #PolyMul.
+ * @param ops : operands
+ * @param monos : unused
+ * @return result
+ */
+static Poly BenchMul(Operands *ops, Mono *monos) {
+    (void) monos;
+    return PolyMul(&ops->p, &ops->q);
+}
+
+/**
+ * Runs #PolyNeg.
+ * @param ops : operands
+ * @param monos : unused
+ * @return result
+ */
+static Poly BenchNeg(Operands *ops, Mono *monos) {
+    (void) monos;
+    return PolyNeg(&ops->p);
+}
+
+/**
+ * Runs #PolySub.
+ * @param ops : operands
+ * @param monos : unused
+ * @return result
+ */
+static Poly BenchSub(Operands *ops, Mono *monos) {
+    (void) monos;
+    return PolySub(&ops->p, &ops->q);
+}
+
+/**
+ * Runs #PolyAt.
+ * @param ops : operands
+ * @param monos : unused
+ * @return result
+ */
+static Poly BenchAt(Operands *ops, Mono *monos) {
+    (void) monos;
+    return PolyAt(&ops->p, AT_VALUE);
+}
+
+/**
+ * Runs #PolyCompose, substituting @f$(i + 2) x_0@f$ for every
+ * @f$x_i@f$, which merges all of the variables into one.
+ * @param ops : operands
+ * @param monos : unused
+ * @return result
+ */
+static Poly BenchCompose(Operands *ops, Mono *monos) {
+    (void) monos;
+    return PolyCompose(&ops->p, ops->family->shape.vars, ops->args);
+}
+
+/**
+ * Runs #PolyClone.
+ * @param ops : operands
+ * @param monos : unused
+ * @return result
+ */
+static Poly BenchClone(Operands *ops, Mono *monos) {
+    (void) monos;
+    return PolyClone(&ops->p);
+}
+
+/**
+ * Runs #PolyIsEq on equal polynomials, which have to be compared whole.
+ * @param ops : operands
+ * @param monos : unused
+ * @return its result as a constant polynomial
+ */
+static Poly BenchIsEq(Operands *ops, Mono *monos) {
+    (void) monos;
+    return PolyFromCoeff(PolyIsEq(&ops->p, &ops->p_copy));
+}
+
+/**
+ * Runs #PolyDeg.
+ * @param ops : operands
+ * @param monos : unused
+ * @return its result as a constant polynomial
+ */
+static Poly BenchDeg(Operands *ops, Mono *monos) {
+    (void) monos;
+    return PolyFromCoeff(PolyDeg(&ops->p));
+}
+
+/**
+ * Runs #PolyDegBy for the deepest variable.
+ * @param ops : operands
+ * @param monos : unused
+ * @return its result as a constant polynomial
+ */
+static Poly BenchDegBy(Operands *ops, Mono *monos) {
+    (void) monos;
+    return PolyFromCoeff(PolyDegBy(&ops->p, ops->family->shape.vars - 1));
+}
+
+/**
+ * Runs #PolyAddMonos on the monomials of both polynomials.
+ * @param ops : operands
+ * @param monos : fresh copy of the monomials, taken over by the operation
+ * @return result
+ */
+static Poly BenchAddMonos(Operands *ops, Mono *monos) {
+    return PolyAddMonos(ops->mono_count, monos);
+}
+
+/// Benchmarked operations.
+static const Operation operations[] = {
+    {"Add", BenchAdd, false},
+    {"Mul", BenchMul, false},
+    {"Neg", BenchNeg, false},
+    {"Sub", BenchSub, false},
+    {"At", BenchAt, false},
+    {"Compose", BenchCompose, false},
+    {"Clone", BenchClone, false},
+    {"IsEq", BenchIsEq, false},
+    {"Deg", BenchDeg, false},
+    {"DegBy", BenchDegBy, false},
+    {"AddMonos", BenchAddMonos, true},
+};
+
+/// Number of operations.
+#define OPERATION_COUNT (sizeof(operations) / sizeof(operations[0]))
+
+/**
+ * Reads a monotonic clock.
+ * @return time in nanoseconds
+ */
+static uint64_t BenchNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * NS_PER_SECOND + (uint64_t) now.tv_nsec;
+}
+
+/**
+ * Runs an operation once.
+ * @param op : operation
+ * @param ops : operands
+ * @return time of the operation in nanoseconds, without preparing
+ * its operands and destroying its result
+ */
+static uint64_t BenchRun(const Operation *op, Operands *ops) {
+    Mono *monos = NULL;
+
+    if (op->uses_monos) {   // the operation takes over the monomials
+        monos = malloc(ops->mono_count * sizeof(Mono));
+        CHECK_PTR(monos);
+        for (size_t i = 0; i < ops->mono_count; i++) {
+            monos[i] = MonoClone(&ops->monos[i]);
+        }
+    }
+
+    uint64_t start = BenchNow();
+    Poly result = op->run(ops, monos);
+    uint64_t time = BenchNow() - start;
+
+    PolyDestroy(&result);
+    free(monos);
+    return time;
+}
+
+/**
+ * Compares two times.
+ * @param a : first time
+ * @param b : second time
+ * @return result of comparison
+ */
+static int BenchCompare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Gives a percentile of sorted times (the nearest rank).
+ * @param times : sorted times
+ * @param count : number of times
+ * @param percent : percentile
+ * @return time
+ */
+static uint64_t BenchPercentile(const uint64_t *times, size_t count,
+                                size_t percent) {
+    size_t rank = (percent * count + 99) / 100;
+    return times[rank > 0 ? rank - 1 : 0];
+}
+
+/**
+ * Benchmarks an operation on operands and writes a line of JSON with
+ * the results.
+ * @param op : operation
+ * @param ops : operands
+ * @param runs : highest number of timed runs
+ * @param warmup : number of warmup runs
+ */
+static void BenchCase(const Operation *op, Operands *ops, size_t runs,
+                      size_t warmup) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < warmup && total < TIME_BUDGET_NS; i++) {
+        total += BenchRun(op, ops);
+    }
+
+    uint64_t *times = malloc(runs * sizeof(uint64_t));
+    CHECK_PTR(times);
+    total = 0;
+    size_t done = 0;
+    while (done < runs && (done < MIN_RUNS || total < TIME_BUDGET_NS)) {
+        times[done] = BenchRun(op, ops);
+        total += times[done++];
+    }
+    qsort(times, done, sizeof(uint64_t), BenchCompare);
+
+    printf("{\"op\": \"%s\", \"family\": \"%s\", \"terms\": [%zu, %zu], "
+           "\"runs\": %zu, \"min_ns\": %llu, \"median_ns\": %llu, "
+           "\"p90_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu}\n",
+           op->name, ops->family->name, PolyTermCount(&ops->p),
+           PolyTermCount(&ops->q), done, (unsigned long long) times[0],
+           (unsigned long long) BenchPercentile(times, done, 50),
+           (unsigned long long) BenchPercentile(times, done, 90),
+           (unsigned long long) BenchPercentile(times, done, 99),
+           (unsigned long long) times[done - 1]);
+    fflush(stdout);
+    free(times);
+}
+
+/**
+ * Parses a number of runs given after an option.
+ * @param string : argument
+ * @param value : place for the number
+ * @return is the number valid
+ */
+static bool BenchParseCount(const char *string, size_t *value) {
+    char *last;
+
+    if (string == NULL || string[0] < '0' || string[0] > '9') {
+        return false;
+    }
+    *value = strtoull(string, &last, DECIMAL_BASE);
+    return *last == '\0';
+}
+
+/**
+ * Runs the benchmarks. Operations given as arguments are run alone.
+ * @param argc : number of arguments
+ * @param argv : arguments
+ * @return exit code of the program
+ */
+int main(int argc, char **argv) {
+    size_t runs = DEFAULT_RUNS, warmup = DEFAULT_WARMUP;
+    bool chosen[OPERATION_COUNT] = {false};
+    bool any_chosen = false;
+
+    for (int i = 1; i < argc; i++) {
+        bool valid = false;
+        if (strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "-w") == 0) {
+            valid = BenchParseCount(argv[i + 1], argv[i][1] == 'r' ? &runs
+                                                                   : &warmup);
+            i++;
+        } else {
+            for (size_t j = 0; j < OPERATION_COUNT; j++) {
+                if (strcmp(argv[i], operations[j].name) == 0) {
+                    chosen[j] = any_chosen = valid = true;
+                }
+            }
+        }
+        if (!valid || runs == 0) {
+            fprintf(stderr, USAGE_MESSAGE);
+            return EXIT_FAILURE;
+        }
+    }
+
+    Generator g;
+    GenInit(&g, SEED);
+    for (size_t i = 0; i < FAMILY_COUNT; i++) {
+        Operands ops = BenchOperands(&g, &families[i]);
+        for (size_t j = 0; j < OPERATION_COUNT; j++) {
+            if (!any_chosen || chosen[j]) {
+                BenchCase(&operations[j], &ops, runs, warmup);
+            }
+        }
+        BenchOperandsDestroy(&ops);
+    }
+    return EXIT_SUCCESS;
+}
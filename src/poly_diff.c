@@ -0,0 +1,1071 @@
+/** @file
+  Differential tests of the operations of the library.
+
+  Runs every operation of @ref poly.h on random inputs and compares its
+  result with a reference implementation, which works on polynomials
+  written as sorted lists of terms and computes with the same wrapping
+  arithmetic of coefficients. The result also has to be in the canonical
+  form of the library. A failing case is shrunk - polynomials, terms,
+  coefficients and exponents are removed or made smaller as long as it
+  still fails - and written to the standard error stream.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "error_handler.h"
+#include "generator.h"
+#include "input_output.h"
+#include "mono_array.h"
+#include "streams.h"
+
+/// Highest number of variables of polynomials, including the ones of
+/// results.
+#define DIFF_VARS 4
+
+/// Highest number of polynomials of a case.
+#define DIFF_MAX_POLYS 6
+
+/// Default number of cases of every operation.
+#define DEFAULT_CASES 2000
+
+/// Default seed.
+#define DEFAULT_SEED 1
+
+/// Highest number of tries of smaller cases while shrinking.
+#define SHRINK_TRIES 20000
+
+/// Part of cases whose coefficients can take any value, in eighths.
+#define WIDE_EIGHTHS 3
+
+/// Highest absolute value of narrow coefficients.
+#define NARROW_COEFF 10
+
+/// Base of numbers of the arguments.
+#define DECIMAL_BASE 10
+
+/// Usage message of the program.
+#define USAGE_MESSAGE \
+    "usage: poly_diff [-s seed] [-n cases] [operation...]\n"
+
+/**
+ * Term of a polynomial: a coefficient and the exponents of all variables.
+ */
+typedef struct DiffTerm {
+    poly_exp_t exps[DIFF_VARS]; ///< exponents, starting with @f$x_0@f$
+    poly_coeff_t coeff;         ///< coefficient
+} DiffTerm;
+
+/**
+ * Polynomial written as a list of terms. In the canonical form the terms
+ * are sorted by their exponents, which are pairwise different, and no
+ * coefficient is 0.
+ */
+typedef struct DiffTerms {
+    DiffTerm *terms;    ///< terms
+    size_t size;        ///< number of terms
+} DiffTerms;
+
+/**
+ * Input of an operation.
+ */
+typedef struct DiffCase {
+    size_t count;                           ///< number of polynomials
+    DiffTerms polys[DIFF_MAX_POLYS];        ///< polynomials
+    poly_coeff_t values[DIFF_MAX_POLYS];    ///< numbers of the operation
+} DiffCase;
+
+/**
+ * Kind of the numbers of a case.
+ */
+typedef enum DiffValue {
+    DIFF_VALUE_NONE,    ///< none
+    DIFF_VALUE_COEFF,   ///< coefficients, one per polynomial
+    DIFF_VALUE_EXP,     ///< exponents, one per polynomial
+    DIFF_VALUE_POINT,   ///< a single point
+} DiffValue;
+
+/**
+ * Tested operation.
+ */
+typedef struct DiffOperation {
+    const char *name;       ///< name of the operation
+    size_t min_count;       ///< lowest number of polynomials
+    size_t max_count;       ///< highest number of polynomials
+    size_t max_vars;        ///< highest number of variables of inputs
+    poly_exp_t max_exp;     ///< highest exponent of inputs
+    DiffValue value;        ///< kind of the numbers
+    Poly (*run)(const Poly polys[], const DiffCase *c);  ///< the library
+    DiffTerms (*reference)(const DiffCase *c);          ///< the reference
+} DiffOperation;
+
+/**
+ * Adds coefficients with wrapping.
+ * @param a : coefficient
+ * @param b : coefficient
+ * @return @f$a + b@f$ modulo @f$2^{64}@f$
+ */
+static poly_coeff_t DiffAdd(poly_coeff_t a, poly_coeff_t b) {
+    return (poly_coeff_t) ((uint64_t) a + (uint64_t) b);
+}
+
+/**
+ * Multiplies coefficients with wrapping.
+ * @param a : coefficient
+ * @param b : coefficient
+ * @return @f$a \cdot b@f$ modulo @f$2^{64}@f$
+ */
+static poly_coeff_t DiffMul(poly_coeff_t a, poly_coeff_t b) {
+    return (poly_coeff_t) ((uint64_t) a * (uint64_t) b);
+}
+
+/**
+ * Creates a list of terms.
+ * @param size : number of terms
+ * @return list with room for them
+ */
+static DiffTerms DiffNew(size_t size) {
+    DiffTerms t = {.terms = malloc((size > 0 ? size : 1) * sizeof(DiffTerm)),
+                   .size = size};
+    CHECK_PTR(t.terms);
+    return t;
+}
+
+/**
+ * Copies a list of terms.
+ * @param t : list
+ * @return copy
+ */
+static DiffTerms DiffCopy(const DiffTerms *t) {
+    DiffTerms copy = DiffNew(t->size);
+    memcpy(copy.terms, t->terms, t->size * sizeof(DiffTerm));
+    return copy;
+}
+
+/**
+ * Compares the exponents of two terms.
+ * @param a : first term
+ * @param b : second term
+ * @return result of comparison
+ */
+static int DiffCompare(const void *a, const void *b) {
+    const DiffTerm *x = a, *y = b;
+
+    for (size_t v = 0; v < DIFF_VARS; v++) {
+        if (x->exps[v] != y->exps[v]) {
+            return x->exps[v] < y->exps[v] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Brings a list of terms to the canonical form.
+ * @param t : list
+ */
+static void DiffCanonize(DiffTerms *t) {
+    size_t used = 0;
+
+    qsort(t->terms, t->size, sizeof(DiffTerm), DiffCompare);
+    for (size_t i = 0; i < t->size; i++) {
+        if (used > 0 && DiffCompare(&t->terms[used - 1], &t->terms[i]) == 0) {
+            t->terms[used - 1].coeff = DiffAdd(t->terms[used - 1].coeff,
+                                               t->terms[i].coeff);
+        } else {
+            t->terms[used++] = t->terms[i];
+        }
+        if (t->terms[used - 1].coeff == 0) {
+            used--;
+        }
+    }
+    t->size = used;
+}
+
+/**
+ * Adds terms of a polynomial to a list.
+ * @param p : polynomial
+ * @param level : index of its variable
+ * @param prefix : term with the exponents of the previous variables and
+ * zeros, changed on the way
+ * @param t : list with enough room
+ * @return is the polynomial shallow enough
+ */
+static bool DiffFlattenLevel(const Poly *p, size_t level, DiffTerm *prefix,
+                             DiffTerms *t) {
+    if (PolyIsCoeff(p)) {
+        if (p->coeff != 0) {
+            prefix->coeff = p->coeff;
+            t->terms[t->size++] = *prefix;
+        }
+        return true;
+    }
+    if (level == DIFF_VARS) {
+        return false;
+    }
+
+    bool valid = true;
+    for (size_t i = 0; i < p->size && valid; i++) {
+        prefix->exps[level] = p->arr[i].exp;
+        valid = DiffFlattenLevel(&p->arr[i].p, level + 1, prefix, t);
+    }
+    prefix->exps[level] = 0;
+    return valid;
+}
+
+/**
+ * Writes a polynomial as a list of terms.
+ * @param p : polynomial
+ * @param t : place for the list
+ * @return has it at most #DIFF_VARS variables
+ */
+static bool DiffFlatten(const Poly *p, DiffTerms *t) {
+    DiffTerm prefix = {.exps = {0}, .coeff = 0};
+
+    *t = DiffNew(PolyTermCount(p));
+    t->size = 0;
+    return DiffFlattenLevel(p, 0, &prefix, t);
+}
+
+/**
+ * Builds the canonical polynomial of a range of canonical terms, which
+ * have the same exponents of the variables before @p level.
+ * @param terms : terms
+ * @param size : number of terms, at least 1
+ * @param level : index of the variable
+ * @return polynomial
+ */
+static Poly DiffBuildLevel(const DiffTerm *terms, size_t size, size_t level) {
+    if (level == DIFF_VARS) {   // exponents of canonical terms differ
+        return PolyFromCoeff(terms[0].coeff);
+    }
+
+    bool constant = size == 1;
+    for (size_t v = level; v < DIFF_VARS && constant; v++) {
+        constant = terms[0].exps[v] == 0;
+    }
+    if (constant) {
+        return PolyFromCoeff(terms[0].coeff);
+    }
+
+    size_t count = 1;
+    for (size_t i = 1; i < size; i++) {
+        count += terms[i].exps[level] != terms[i - 1].exps[level];
+    }
+
+    Mono *monos = MonoNewArray(count);
+    size_t first = 0;
+    for (size_t m = 0; m < count; m++) {
+        size_t last = first + 1;
+        while (last < size
+               && terms[last].exps[level] == terms[first].exps[level]) {
+            last++;
+        }
+        Poly coeff = DiffBuildLevel(&terms[first], last - first, level + 1);
+        monos[m] = MonoFromPoly(&coeff, terms[first].exps[level]);
+        first = last;
+    }
+    return PolyFromSizeAndArray(count, monos);
+}
+
+/**
+ * Builds the canonical polynomial of a canonical list of terms, without
+ * using the operations which are tested.
+ * @param t : list
+ * @return polynomial
+ */
+static Poly DiffBuild(const DiffTerms *t) {
+    return t->size == 0 ? PolyZero() : DiffBuildLevel(t->terms, t->size, 0);
+}
+
+/**
+ * Checks that a polynomial is in the canonical form of the library:
+ * its monomials have increasing exponents and nonzero coefficients,
+ * and it is not a single monomial with exponent 0 and a constant
+ * coefficient.
+ * @param p : polynomial
+ * @return is it canonical
+ */
+static bool DiffCanonical(const Poly *p) {
+    if (PolyIsCoeff(p)) {
+        return true;
+    }
+    if (p->size == 0 || (p->size == 1 && p->arr[0].exp == 0
+                         && PolyIsCoeff(&p->arr[0].p))) {
+        return false;
+    }
+    for (size_t i = 0; i < p->size; i++) {
+        if (p->arr[i].exp < 0 || (i > 0 && p->arr[i].exp <= p->arr[i - 1].exp)
+            || PolyIsZero(&p->arr[i].p) || !DiffCanonical(&p->arr[i].p)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Adds lists of terms.
+ * @param a : list
+ * @param b : list
+ * @return canonical sum
+ */
+static DiffTerms DiffSum(const DiffTerms *a, const DiffTerms *b) {
+    DiffTerms sum = DiffNew(a->size + b->size);
+    memcpy(sum.terms, a->terms, a->size * sizeof(DiffTerm));
+    memcpy(sum.terms + a->size, b->terms, b->size * sizeof(DiffTerm));
+    DiffCanonize(&sum);
+    return sum;
+}
+
+/**
+ * Multiplies lists of terms term by term.
+ * @param a : list
+ * @param b : list
+ * @return canonical product
+ */
+static DiffTerms DiffProduct(const DiffTerms *a, const DiffTerms *b) {
+    DiffTerms product = DiffNew(a->size * b->size);
+    for (size_t i = 0; i < a->size; i++) {
+        for (size_t j = 0; j < b->size; j++) {
+            DiffTerm *term = &product.terms[i * b->size + j];
+            for (size_t v = 0; v < DIFF_VARS; v++) {
+                term->exps[v] = a->terms[i].exps[v] + b->terms[j].exps[v];
+            }
+            term->coeff = DiffMul(a->terms[i].coeff, b->terms[j].coeff);
+        }
+    }
+    DiffCanonize(&product);
+    return product;
+}
+
+/**
+ * Multiplies a list of terms by a coefficient.
+ * @param t : list, changed in place
+ * @param c : coefficient
+ */
+static void DiffScale(DiffTerms *t, poly_coeff_t c) {
+    for (size_t i = 0; i < t->size; i++) {
+        t->terms[i].coeff = DiffMul(t->terms[i].coeff, c);
+    }
+    DiffCanonize(t);
+}
+
+/**
+ * Replaces a list with its sum with another one.
+ * @param acc : list, changed in place
+ * @param t : list which is added
+ */
+static void DiffAccumulate(DiffTerms *acc, const DiffTerms *t) {
+    DiffTerms sum = DiffSum(acc, t);
+    free(acc->terms);
+    *acc = sum;
+}
+
+/**
+ * Replaces a list with its product with another one.
+ * @param acc : list, changed in place
+ * @param t : list by which it is multiplied
+ */
+static void DiffMultiply(DiffTerms *acc, const DiffTerms *t) {
+    DiffTerms product = DiffProduct(acc, t);
+    free(acc->terms);
+    *acc = product;
+}
+
+/**
+ * Creates the list of a constant.
+ * @param c : constant
+ * @return canonical list
+ */
+static DiffTerms DiffConstant(poly_coeff_t c) {
+    DiffTerms t = DiffNew(1);
+    t.terms[0] = (DiffTerm) {.exps = {0}, .coeff = c};
+    DiffCanonize(&t);
+    return t;
+}
+
+/**
+ * Tells whether a polynomial of an #AddMonos case is the coefficient of
+ * a monomial with its exponent. A zero coefficient can only have
+ * exponent 0.
+ * @param c : case
+ * @param i : index of the polynomial
+ * @return exponent of its monomial
+ */
+static poly_exp_t DiffMonoExp(const DiffCase *c, size_t i) {
+    return c->polys[i].size == 0 ? 0 : (poly_exp_t) c->values[i];
+}
+
+/**
+ * Adds polynomials with #PolyAdd.
+ * @param polys : polynomials of the case
+ * @param c : case
+ * @return sum
+ */
+static Poly RunAdd(const Poly polys[], const DiffCase *c) {
+    (void) c;
+    return PolyAdd(&polys[0], &polys[1]);
+}
+
+/**
+ * Subtracts polynomials with #PolySub.
+ * @param polys : polynomials of the case
+ * @param c : case
+ * @return difference
+ */
+static Poly RunSub(const Poly polys[], const DiffCase *c) {
+    (void) c;
+    return PolySub(&polys[0], &polys[1]);
+}
+
+/**
+ * Negates a polynomial with #PolyNeg.
+ * @param polys : polynomials of the case
+ * @param c : case
+ * @return negation
+ */
+static Poly RunNeg(const Poly polys[], const DiffCase *c) {
+    (void) c;
+    return PolyNeg(&polys[0]);
+}
+
+/**
+ * Multiplies polynomials with #PolyMul.
+ * @param polys : polynomials of the case
+ * @param c : case
+ * @return product
+ */
+static Poly RunMul(const Poly polys[], const DiffCase *c) {
+    (void) c;
+    return PolyMul(&polys[0], &polys[1]);
+}
+
+/**
+ * Adds polynomials with #PolySumMany.
+ * @param polys : polynomials of the case
+ * @param c : case
+ * @return sum
+ */
+static Poly RunSumMany(const Poly polys[], const DiffCase *c) {
+    return PolySumMany(c->count, polys);
+}
+
+/**
+ * Computes a linear combination with #PolyLinComb.
+ * @param polys : polynomials of the case
+ * @param c : case
+ * @return linear combination
+ */
+static Poly RunLinComb(const Poly polys[], const DiffCase *c) {
+    return PolyLinComb(c->count, c->values, polys);
+}
+
+/**
+ * Multiplies polynomials with #PolyProductMany.
+ * @param polys : polynomials of the case
+ * @param c : case
+ * @return product
+ */
+static Poly RunProductMany(const Poly polys[], const DiffCase *c) {
+    return PolyProductMany(c->count, polys);
+}
+
+/**
+ * Adds monomials with #PolyAddMonos.
+ * @param polys : coefficients of the monomials
+ * @param c : case
+ * @return sum
+ */
+static Poly RunAddMonos(const Poly polys[], const DiffCase *c) {
+    Mono monos[DIFF_MAX_POLYS];
+    for (size_t i = 0; i < c->count; i++) {
+        Poly coeff = PolyClone(&polys[i]);
+        monos[i] = MonoFromPoly(&coeff, DiffMonoExp(c, i));
+    }
+    return PolyAddMonos(c->count, monos);
+}
+
+/**
+ * Computes a value with #PolyAt.
+ * @param polys : polynomials of the case
+ * @param c : case
+ * @return value
+ */
+static Poly RunAt(const Poly polys[], const DiffCase *c) {
+    return PolyAt(&polys[0], c->values[0]);
+}
+
+/**
+ * Composes polynomials with #PolyCompose.
+ * @param polys : composed polynomial and the substituted ones
+ * @param c : case
+ * @return composition
+ */
+static Poly RunCompose(const Poly polys[], const DiffCase *c) {
+    return PolyCompose(&polys[0], c->count - 1, &polys[1]);
+}
+
+/**
+ * Reference of #PolyAdd.
+ * @param c : case
+ * @return sum
+ */
+static DiffTerms ReferenceAdd(const DiffCase *c) {
+    return DiffSum(&c->polys[0], &c->polys[1]);
+}
+
+/**
+ * Reference of #PolySub.
+ * @param c : case
+ * @return difference
+ */
+static DiffTerms ReferenceSub(const DiffCase *c) {
+    DiffTerms negated = DiffCopy(&c->polys[1]);
+    DiffScale(&negated, -1);
+    DiffTerms difference = DiffSum(&c->polys[0], &negated);
+    free(negated.terms);
+    return difference;
+}
+
+/**
+ * Reference of #PolyNeg.
+ * @param c : case
+ * @return negation
+ */
+static DiffTerms ReferenceNeg(const DiffCase *c) {
+    DiffTerms negated = DiffCopy(&c->polys[0]);
+    DiffScale(&negated, -1);
+    return negated;
+}
+
+/**
+ * Reference of #PolyMul.
+ * @param c : case
+ * @return product
+ */
+static DiffTerms ReferenceMul(const DiffCase *c) {
+    return DiffProduct(&c->polys[0], &c->polys[1]);
+}
+
+/**
+ * Reference of #PolySumMany.
+ * @param c : case
+ * @return sum
+ */
+static DiffTerms ReferenceSumMany(const DiffCase *c) {
+    DiffTerms sum = DiffConstant(0);
+    for (size_t i = 0; i < c->count; i++) {
+        DiffAccumulate(&sum, &c->polys[i]);
+    }
+    return sum;
+}
+
+/**
+ * Reference of #PolyLinComb.
+ * @param c : case
+ * @return linear combination
+ */
+static DiffTerms ReferenceLinComb(const DiffCase *c) {
+    DiffTerms sum = DiffConstant(0);
+    for (size_t i = 0; i < c->count; i++) {
+        DiffTerms scaled = DiffCopy(&c->polys[i]);
+        DiffScale(&scaled, c->values[i]);
+        DiffAccumulate(&sum, &scaled);
+        free(scaled.terms);
+    }
+    return sum;
+}
+
+/**
+ * Reference of #PolyProductMany.
+ * @param c : case
+ * @return product
+ */
+static DiffTerms ReferenceProductMany(const DiffCase *c) {
+    DiffTerms product = DiffConstant(1);
+    for (size_t i = 0; i < c->count; i++) {
+        DiffMultiply(&product, &c->polys[i]);
+    }
+    return product;
+}
+
+/**
+ * Reference of #PolyAddMonos. The variables of a coefficient of
+ * a monomial are the ones after @f$x_0@f$.
+ * @param c : case
+ * @return sum
+ */
+static DiffTerms ReferenceAddMonos(const DiffCase *c) {
+    size_t total = 0;
+    for (size_t i = 0; i < c->count; i++) {
+        total += c->polys[i].size;
+    }
+
+    DiffTerms sum = DiffNew(total);
+    sum.size = 0;
+    for (size_t i = 0; i < c->count; i++) {
+        for (size_t j = 0; j < c->polys[i].size; j++) {
+            DiffTerm *term = &sum.terms[sum.size++];
+            *term = c->polys[i].terms[j];
+            memmove(term->exps + 1, term->exps,
+                    (DIFF_VARS - 1) * sizeof(poly_exp_t));
+            term->exps[0] = DiffMonoExp(c, i);
+        }
+    }
+    DiffCanonize(&sum);
+    return sum;
+}
+
+/**
+ * Reference of #PolyAt.
+ * @param c : case
+ * @return value
+ */
+static DiffTerms ReferenceAt(const DiffCase *c) {
+    DiffTerms value = DiffCopy(&c->polys[0]);
+    for (size_t i = 0; i < value.size; i++) {
+        DiffTerm *term = &value.terms[i];
+        for (poly_exp_t e = 0; e < term->exps[0]; e++) {
+            term->coeff = DiffMul(term->coeff, c->values[0]);
+        }
+        memmove(term->exps, term->exps + 1,
+                (DIFF_VARS - 1) * sizeof(poly_exp_t));
+        term->exps[DIFF_VARS - 1] = 0;
+    }
+    DiffCanonize(&value);
+    return value;
+}
+
+/**
+ * Reference of #PolyCompose: every term is replaced by the product of
+ * powers of the substituted polynomials, computed by repeated
+ * multiplication, and variables without a polynomial become 0.
+ * @param c : case
+ * @return composition
+ */
+static DiffTerms ReferenceCompose(const DiffCase *c) {
+    size_t k = c->count - 1;
+    DiffTerms sum = DiffConstant(0);
+
+    for (size_t i = 0; i < c->polys[0].size; i++) {
+        const DiffTerm *term = &c->polys[0].terms[i];
+        bool vanishes = false;
+        for (size_t v = k; v < DIFF_VARS; v++) {
+            vanishes |= term->exps[v] > 0;
+        }
+        if (vanishes) {
+            continue;
+        }
+
+        DiffTerms product = DiffConstant(term->coeff);
+        for (size_t v = 0; v < k && v < DIFF_VARS; v++) {
+            for (poly_exp_t e = 0; e < term->exps[v]; e++) {
+                DiffMultiply(&product, &c->polys[v + 1]);
+            }
+        }
+        DiffAccumulate(&sum, &product);
+        free(product.terms);
+    }
+    return sum;
+}
+
+/// Tested operations.
+static const DiffOperation operations[] = {
+    {"Add", 2, 2, 3, 6, DIFF_VALUE_NONE, RunAdd, ReferenceAdd},
+    {"Sub", 2, 2, 3, 6, DIFF_VALUE_NONE, RunSub, ReferenceSub},
+    {"Neg", 1, 1, 3, 6, DIFF_VALUE_NONE, RunNeg, ReferenceNeg},
+    {"Mul", 2, 2, 3, 4, DIFF_VALUE_NONE, RunMul, ReferenceMul},
+    {"SumMany", 0, DIFF_MAX_POLYS, 3, 4, DIFF_VALUE_NONE, RunSumMany,
+     ReferenceSumMany},
+    {"LinComb", 0, DIFF_MAX_POLYS, 3, 4, DIFF_VALUE_COEFF, RunLinComb,
+     ReferenceLinComb},
+    {"ProductMany", 0, 4, 2, 2, DIFF_VALUE_NONE, RunProductMany,
+     ReferenceProductMany},
+    {"AddMonos", 1, DIFF_MAX_POLYS, 3, 4, DIFF_VALUE_EXP, RunAddMonos,
+     ReferenceAddMonos},
+    {"At", 1, 1, 3, 6, DIFF_VALUE_POINT, RunAt, ReferenceAt},
+    {"Compose", 1, 4, 2, 2, DIFF_VALUE_NONE, RunCompose, ReferenceCompose},
+};
+
+/// Number of tested operations.
+#define OPERATION_COUNT (sizeof(operations) / sizeof(operations[0]))
+
+/**
+ * Frees the polynomials of a case.
+ * @param c : case
+ */
+static void DiffCaseDestroy(DiffCase *c) {
+    for (size_t i = 0; i < c->count; i++) {
+        free(c->polys[i].terms);
+    }
+    c->count = 0;
+}
+
+/**
+ * Copies a case.
+ * @param c : case
+ * @return copy
+ */
+static DiffCase DiffCaseCopy(const DiffCase *c) {
+    DiffCase copy = *c;
+    for (size_t i = 0; i < c->count; i++) {
+        copy.polys[i] = DiffCopy(&c->polys[i]);
+    }
+    return copy;
+}
+
+/**
+ * Draws a coefficient of a case.
+ * @param g : generator
+ * @param wide : can it take any value
+ * @return coefficient
+ */
+static poly_coeff_t DiffDrawCoeff(Generator *g, bool wide) {
+    if (wide) {
+        return (poly_coeff_t) GenRandom(g);
+    }
+    return (poly_coeff_t) GenRange(g, 0, 2 * NARROW_COEFF) - NARROW_COEFF;
+}
+
+/**
+ * Draws a random case of an operation.
+ * @param g : generator
+ * @param op : operation
+ * @return case
+ */
+static DiffCase DiffDraw(Generator *g, const DiffOperation *op) {
+    DiffCase c = {.count = (size_t) GenRange(g, op->min_count,
+                                             op->max_count)};
+    bool wide = GenRange(g, 0, 7) < WIDE_EIGHTHS;
+    GenShape shape = {
+        .min_coeff = wide ? INT64_MIN : -NARROW_COEFF,
+        .max_coeff = wide ? INT64_MAX : NARROW_COEFF,
+        .nesting = (GenNesting) GenRange(g, GEN_NEST_FULL, GEN_NEST_CHAIN),
+    };
+
+    for (size_t i = 0; i < c.count; i++) {
+        shape.vars = (size_t) GenRange(g, 0, op->max_vars);
+        shape.max_exp = (poly_exp_t) GenRange(g, 0, (uint64_t) op->max_exp);
+        shape.density = GenFraction(g);
+        Poly p = GenPoly(g, &shape);
+        DiffFlatten(&p, &c.polys[i]);
+        PolyDestroy(&p);
+
+        if (op->value == DIFF_VALUE_EXP) {
+            c.values[i] = (poly_coeff_t) GenRange(g, 0,
+                                                  (uint64_t) op->max_exp);
+        } else if (op->value != DIFF_VALUE_NONE) {
+            c.values[i] = DiffDrawCoeff(g, wide);
+        }
+    }
+    return c;
+}
+
+/**
+ * Checks an operation on a case.
+ * @param op : operation
+ * @param c : case
+ * @param expected : place for the result of the reference or NULL
+ * @param got : place for the result of the library or NULL
+ * @return does the library agree with the reference
+ */
+static bool DiffCheck(const DiffOperation *op, const DiffCase *c,
+                      Poly *expected, Poly *got) {
+    Poly polys[DIFF_MAX_POLYS];
+    for (size_t i = 0; i < c->count; i++) {
+        polys[i] = DiffBuild(&c->polys[i]);
+    }
+    Poly result = op->run(polys, c);
+    for (size_t i = 0; i < c->count; i++) {
+        PolyDestroy(&polys[i]);
+    }
+
+    DiffTerms reference = op->reference(c);
+    DiffTerms flat;
+    bool valid = DiffFlatten(&result, &flat) && DiffCanonical(&result);
+    if (valid) {
+        DiffCanonize(&flat);
+        valid = flat.size == reference.size
+                && memcmp(flat.terms, reference.terms,
+                          flat.size * sizeof(DiffTerm)) == 0;
+    }
+    free(flat.terms);
+
+    if (expected != NULL) {
+        *expected = DiffBuild(&reference);
+    }
+    free(reference.terms);
+    if (got != NULL) {
+        *got = result;
+    } else {
+        PolyDestroy(&result);
+    }
+    return valid;
+}
+
+/**
+ * Tries a smaller case. If it still fails, it replaces the current one.
+ * @param op : operation
+ * @param c : failing case, replaced by the smaller one if it fails
+ * @param smaller : smaller case, which is taken over
+ * @param tries : number of tries, increased by one
+ * @return does the smaller case fail
+ */
+static bool DiffTry(const DiffOperation *op, DiffCase *c, DiffCase *smaller,
+                    size_t *tries) {
+    (*tries)++;
+    for (size_t i = 0; i < smaller->count; i++) {
+        DiffCanonize(&smaller->polys[i]);
+    }
+    if (!DiffCheck(op, smaller, NULL, NULL)) {
+        DiffCaseDestroy(c);
+        *c = *smaller;
+        return true;
+    }
+    DiffCaseDestroy(smaller);
+    return false;
+}
+
+/**
+ * Makes a number closer to 0.
+ * @param x : number
+ * @param step : 0 for 0, 1 for a half, 2 for the number closer by 1
+ * @return smaller number
+ */
+static poly_coeff_t DiffSmaller(poly_coeff_t x, int step) {
+    if (step == 0) {
+        return 0;
+    } else if (step == 1) {
+        return x / 2;
+    }
+    return x > 0 ? x - 1 : x + 1;
+}
+
+/**
+ * Performs a single successful step of shrinking, if there is one.
+ * @param op : operation
+ * @param c : failing case
+ * @param tries : number of tries, increased by the tried cases
+ * @return was the case shrunk
+ */
+static bool DiffShrinkStep(const DiffOperation *op, DiffCase *c,
+                           size_t *tries) {
+    for (size_t i = 0; i < c->count && c->count > op->min_count; i++) {
+        DiffCase smaller = DiffCaseCopy(c);
+        free(smaller.polys[i].terms);
+        memmove(&smaller.polys[i], &smaller.polys[i + 1],
+                (c->count - i - 1) * sizeof(DiffTerms));
+        memmove(&smaller.values[i], &smaller.values[i + 1],
+                (c->count - i - 1) * sizeof(poly_coeff_t));
+        smaller.count--;
+        if (DiffTry(op, c, &smaller, tries)) {
+            return true;
+        }
+    }
+
+    for (size_t i = 0; i < c->count; i++) {
+        for (size_t j = 0; j < c->polys[i].size; j++) {
+            DiffCase smaller = DiffCaseCopy(c);
+            DiffTerms *t = &smaller.polys[i];
+            t->terms[j] = t->terms[--t->size];
+            if (DiffTry(op, c, &smaller, tries)) {
+                return true;
+            }
+        }
+    }
+
+    for (int step = 0; step < 3; step++) {
+        for (size_t i = 0; i < c->count; i++) {
+            for (size_t j = 0; j < c->polys[i].size; j++) {
+                for (size_t v = 0; v < DIFF_VARS; v++) {
+                    poly_exp_t e = c->polys[i].terms[j].exps[v];
+                    if (e == 0) {
+                        continue;
+                    }
+                    DiffCase smaller = DiffCaseCopy(c);
+                    smaller.polys[i].terms[j].exps[v] =
+                        (poly_exp_t) DiffSmaller(e, step);
+                    if (DiffTry(op, c, &smaller, tries)) {
+                        return true;
+                    }
+                }
+
+                poly_coeff_t coeff = c->polys[i].terms[j].coeff;
+                if (step > 0 && coeff != 1 && coeff != -1) {
+                    DiffCase smaller = DiffCaseCopy(c);
+                    smaller.polys[i].terms[j].coeff = DiffSmaller(coeff, step);
+                    if (DiffTry(op, c, &smaller, tries)) {
+                        return true;
+                    }
+                }
+            }
+
+            if (op->value != DIFF_VALUE_NONE && c->values[i] != 0) {
+                DiffCase smaller = DiffCaseCopy(c);
+                smaller.values[i] = DiffSmaller(c->values[i], step);
+                if (DiffTry(op, c, &smaller, tries)) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Shrinks a failing case until no smaller case fails.
+ * @param op : operation
+ * @param c : failing case, replaced by the smallest found one
+ */
+static void DiffShrink(const DiffOperation *op, DiffCase *c) {
+    size_t tries = 0;
+    while (tries < SHRINK_TRIES && DiffShrinkStep(op, c, &tries)) {
+    }
+}
+
+/**
+ * Writes a polynomial as a line of the error stream.
+ * @param label : label of the line
+ * @param p : polynomial
+ */
+static void DiffPrint(const char *label, Poly *p) {
+    fprintf(stderr, "  %s: ", label);
+    SetStreams(NULL, stderr, NULL);
+    PolyPrint(p);
+    SetStreams(NULL, NULL, NULL);
+    fputc('\n', stderr);
+}
+
+/**
+ * Writes a shrunk failing case to the error stream.
+ * @param op : operation
+ * @param c : case
+ * @param seed : seed
+ * @param index : index of the case before shrinking
+ */
+static void DiffReport(const DiffOperation *op, const DiffCase *c,
+                       uint64_t seed, size_t index) {
+    fprintf(stderr, "poly_diff: %s differs from the reference in case %zu "
+                    "of seed %llu, shrunk to:\n", op->name, index,
+            (unsigned long long) seed);
+    for (size_t i = 0; i < c->count; i++) {
+        char label[32];
+        Poly p = DiffBuild(&c->polys[i]);
+        snprintf(label, sizeof(label), "input %zu", i);
+        DiffPrint(label, &p);
+        PolyDestroy(&p);
+        if (op->value != DIFF_VALUE_NONE
+            && (op->value != DIFF_VALUE_POINT || i == 0)) {
+            fprintf(stderr, "  value %zu: %ld\n", i, c->values[i]);
+        }
+    }
+
+    Poly expected, got;
+    DiffCheck(op, c, &expected, &got);
+    DiffPrint("expected", &expected);
+    DiffPrint("got", &got);
+    if (!DiffCanonical(&got)) {
+        fprintf(stderr, "  (not in the canonical form)\n");
+    }
+    PolyDestroy(&expected);
+    PolyDestroy(&got);
+}
+
+/**
+ * Runs the cases of an operation and writes a line of JSON with their
+ * numbers. The first failing case is shrunk and reported.
+ * @param op : operation
+ * @param seed : seed
+ * @param cases : number of cases
+ * @return did all of the cases pass
+ */
+static bool DiffOperationRun(const DiffOperation *op, uint64_t seed,
+                             size_t cases) {
+    Generator g;
+    GenInit(&g, seed);
+    size_t passed = 0;
+    bool valid = true;
+
+    for (size_t i = 0; i < cases && valid; i++) {
+        DiffCase c = DiffDraw(&g, op);
+        valid = DiffCheck(op, &c, NULL, NULL);
+        if (valid) {
+            passed++;
+        } else {
+            DiffShrink(op, &c);
+            DiffReport(op, &c, seed, i);
+        }
+        DiffCaseDestroy(&c);
+    }
+
+    printf("{\"operation\": \"%s\", \"cases\": %zu, \"passed\": %zu}\n",
+           op->name, passed + !valid, passed);
+    fflush(stdout);
+    return valid;
+}
+
+/**
+ * Tells whether an operation is selected by the arguments.
+ * @param name : name of the operation
+ * @param argc : number of the names of selected operations
+ * @param argv : names of selected operations, all if there are none
+ * @return is it selected
+ */
+static bool DiffSelected(const char *name, int argc, char **argv) {
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(name, argv[i]) == 0) {
+            return true;
+        }
+    }
+    return argc == 0;
+}
+
+/**
+ * Runs the differential tests.
+ * @param argc : number of arguments
+ * @param argv : arguments
+ * @return exit code of the program, failure if a case failed
+ */
+int main(int argc, char **argv) {
+    unsigned long long seed = DEFAULT_SEED, cases = DEFAULT_CASES;
+    int i = 1;
+
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        unsigned long long *value = strcmp(argv[i], "-s") == 0 ? &seed
+                                    : strcmp(argv[i], "-n") == 0 ? &cases
+                                    : NULL;
+        char *last;
+        if (value == NULL || argv[i + 1][0] < '0' || argv[i + 1][0] > '9') {
+            fprintf(stderr, USAGE_MESSAGE);
+            return EXIT_FAILURE;
+        }
+        *value = strtoull(argv[i + 1], &last, DECIMAL_BASE);
+        if (*last != '\0') {
+            fprintf(stderr, USAGE_MESSAGE);
+            return EXIT_FAILURE;
+        }
+    }
+    for (int j = i; j < argc; j++) {
+        bool known = false;
+        for (size_t k = 0; k < OPERATION_COUNT; k++) {
+            known |= strcmp(argv[j], operations[k].name) == 0;
+        }
+        if (!known) {
+            fprintf(stderr, USAGE_MESSAGE);
+            return EXIT_FAILURE;
+        }
+    }
+
+    bool valid = true;
+    for (size_t k = 0; k < OPERATION_COUNT; k++) {
+        if (DiffSelected(operations[k].name, argc - i, argv + i)) {
+            valid &= DiffOperationRun(&operations[k], seed + k,
+                                      (size_t) cases);
+        }
+    }
+    return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,232 @@
+/** @file
+  Generator of random polynomials and calculator scripts.
+
+  Writes polynomials of a given shape, one per line, or a whole script
+  with a given mix of commands to the standard output. The same seed
+  always gives the same output.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "error_handler.h"
+#include "generator.h"
+
+/// Base of numbers of the arguments.
+#define DECIMAL_BASE 10
+
+/// Default mix of commands of scripts.
+#define DEFAULT_MIX "POLY:6,ADD:2,SUB:1,MUL:2,CLONE:1,NEG:1,AT:1,DEG:1," \
+                    "IS_EQ:1,COMPOSE:1,PRINT:2,POP:2"
+
+/// Default highest size of the stack of scripts.
+#define DEFAULT_MAX_DEPTH 16
+
+/// Separator of commands of a mix.
+#define MIX_SEPARATOR ','
+
+/// Separator of a command of a mix from its weight.
+#define WEIGHT_SEPARATOR ':'
+
+/// Usage message of the program.
+#define USAGE_MESSAGE \
+    "usage: poly_gen [-s seed] [-n count] [-v vars] [-e max_exp] " \
+    "[-d density]\n" \
+    "                [-c min:max] [-p full|random|chain]\n" \
+    "                [--script lines [-m command:weight,...] " \
+    "[-k max_depth]]\n"
+
+/**
+ * Parses an unsigned number.
+ * @param string : number
+ * @param last : place for the end of the number or NULL if it has to end
+ * the string
+ * @param value : place for the number
+ * @return is the number valid
+ */
+static bool GenParseUnsigned(char *string, char **last,
+                             unsigned long long *value) {
+    char *end;
+
+    if (string == NULL || string[0] < '0' || string[0] > '9') {
+        return false;
+    }
+    errno = 0;
+    *value = strtoull(string, &end, DECIMAL_BASE);
+    if (last != NULL) {
+        *last = end;
+    }
+    return errno == 0 && (last != NULL || *end == '\0');
+}
+
+/**
+ * Parses a range of coefficients.
+ * @param string : range, min:max
+ * @param shape : shape for the range
+ * @return is the range valid
+ */
+static bool GenParseCoeffs(char *string, GenShape *shape) {
+    char *last;
+
+    if (string == NULL) {
+        return false;
+    }
+    errno = 0;
+    shape->min_coeff = strtol(string, &last, DECIMAL_BASE);
+    if (errno != 0 || last == string || *last != WEIGHT_SEPARATOR) {
+        return false;
+    }
+    string = last + 1;
+    shape->max_coeff = strtol(string, &last, DECIMAL_BASE);
+    return errno == 0 && last != string && *last == '\0'
+           && shape->min_coeff <= shape->max_coeff;
+}
+
+/**
+ * Parses a mix of commands. The string is split in place.
+ * @param string : mix, command[:weight],...
+ * @param script : script for the mix
+ * @return is the mix valid
+ */
+static bool GenParseMix(char *string, GenScript *script) {
+    size_t count = 1;
+
+    for (char *c = string; *c != '\0'; c++) {
+        count += *c == MIX_SEPARATOR;
+    }
+    GenMix *mix = malloc(count * sizeof(GenMix));
+    CHECK_PTR(mix);
+
+    for (size_t i = 0; i < count; i++) {
+        char *end = strchr(string, MIX_SEPARATOR);
+        if (end != NULL) {
+            *end = '\0';
+        }
+
+        unsigned long long weight = 1;
+        char *colon = strchr(string, WEIGHT_SEPARATOR);
+        if (colon != NULL) {
+            *colon = '\0';
+            if (!GenParseUnsigned(colon + 1, NULL, &weight)
+                || weight > UINT32_MAX) {
+                free(mix);
+                return false;
+            }
+        }
+        mix[i] = (GenMix) {.name = string, .weight = (unsigned) weight};
+        string = end + 1;
+    }
+
+    script->mix = mix;
+    script->mix_count = count;
+    return true;
+}
+
+/**
+ * Parses the name of a pattern of nesting.
+ * @param string : name
+ * @param nesting : place for the pattern
+ * @return is the name valid
+ */
+static bool GenParseNesting(const char *string, GenNesting *nesting) {
+    if (string == NULL) {
+        return false;
+    }
+    if (strcmp(string, "full") == 0) {
+        *nesting = GEN_NEST_FULL;
+    } else if (strcmp(string, "random") == 0) {
+        *nesting = GEN_NEST_RANDOM;
+    } else if (strcmp(string, "chain") == 0) {
+        *nesting = GEN_NEST_CHAIN;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Generates polynomials or a script as asked by the arguments.
+ * @param argc : number of arguments
+ * @param argv : arguments
+ * @return exit code of the program
+ */
+int main(int argc, char **argv) {
+    unsigned long long seed = 1, count = 1, value;
+    GenShape shape = {.vars = 2, .max_exp = 4, .density = 0.5,
+                      .min_coeff = -10, .max_coeff = 10,
+                      .nesting = GEN_NEST_RANDOM};
+    GenScript script = {.lines = 0, .mix = NULL, .mix_count = 0,
+                        .max_depth = DEFAULT_MAX_DEPTH};
+    char default_mix[] = DEFAULT_MIX;
+    bool is_script = false, valid = true;
+
+    for (int i = 1; i < argc && valid; i += 2) {
+        const char *option = argv[i];
+        char *arg = argv[i + 1];
+        char *last;
+
+        if (strcmp(option, "-s") == 0) {
+            valid = GenParseUnsigned(arg, NULL, &seed);
+        } else if (strcmp(option, "-n") == 0) {
+            valid = GenParseUnsigned(arg, NULL, &count);
+        } else if (strcmp(option, "-v") == 0) {
+            valid = GenParseUnsigned(arg, NULL, &value);
+            shape.vars = (size_t) value;
+        } else if (strcmp(option, "-e") == 0) {
+            valid = GenParseUnsigned(arg, NULL, &value) && value <= INT32_MAX;
+            shape.max_exp = (poly_exp_t) value;
+        } else if (strcmp(option, "-d") == 0) {
+            valid = arg != NULL;
+            if (valid) {
+                shape.density = strtod(arg, &last);
+                valid = last != arg && *last == '\0' && shape.density >= 0
+                        && shape.density <= 1;
+            }
+        } else if (strcmp(option, "-c") == 0) {
+            valid = GenParseCoeffs(arg, &shape);
+        } else if (strcmp(option, "-p") == 0) {
+            valid = GenParseNesting(arg, &shape.nesting);
+        } else if (strcmp(option, "--script") == 0) {
+            valid = GenParseUnsigned(arg, NULL, &value);
+            script.lines = (size_t) value;
+            is_script = true;
+        } else if (strcmp(option, "-m") == 0 && script.mix == NULL) {
+            valid = arg != NULL && GenParseMix(arg, &script);
+        } else if (strcmp(option, "-k") == 0) {
+            valid = GenParseUnsigned(arg, NULL, &value) && value > 0;
+            script.max_depth = (size_t) value;
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid) {
+        fprintf(stderr, USAGE_MESSAGE);
+        free((GenMix *) script.mix);
+        return EXIT_FAILURE;
+    }
+
+    Generator g;
+    GenInit(&g, seed);
+    int result = EXIT_SUCCESS;
+    if (is_script) {
+        if (script.mix == NULL) {
+            GenParseMix(default_mix, &script);
+        }
+        script.shape = shape;
+        if (!GenPrintScript(&g, &script)) {
+            fprintf(stderr, "poly_gen: unknown command in the mix\n");
+            result = EXIT_FAILURE;
+        }
+    } else {
+        for (unsigned long long i = 0; i < count; i++) {
+            GenPrintPoly(&g, &shape);
+        }
+    }
+
+    free((GenMix *) script.mix);
+    return result;
+}
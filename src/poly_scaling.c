@@ -0,0 +1,509 @@
+/** @file
+  Scaling benchmark of the concurrent paths of the calculator.
+
+  Runs the calculator on generated scripts of independent multiplications,
+  additions and compositions with -j at 1, 2, 4, ... threads and on
+  generated files of literals in the batch mode with as many workers,
+  for operands of increasing size. For every size it writes the speedup
+  and efficiency at every number of threads, and for every path the
+  crossover: the smallest size from which two threads are faster than
+  one. The smallest crossover of the -j paths is suggested as the value
+  of --parallel-terms. Outputs of the -j paths, which end with STATS, are
+  checked to be the same at every number of threads.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef _GNU_SOURCE
+/// Directive necessary for mkdtemp to work.
+#define _GNU_SOURCE
+#endif
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "error_handler.h"
+#include "generator.h"
+#include "input_output.h"
+#include "streams.h"
+
+/// Default number of timed runs of a script.
+#define DEFAULT_RUNS 3
+
+/// Seed of the scripts.
+#define SEED 2021
+
+/// Number of nanoseconds in a second.
+#define NS_PER_SECOND 1000000000.0
+
+/// Size of buffers for paths and the output of the calculator.
+#define BUFFER_SIZE (1 << 16)
+
+/// Base of numbers of the arguments.
+#define DECIMAL_BASE 10
+
+/// Exit code of a child which could not run the calculator.
+#define EXEC_FAILED 127
+
+/// Speedup at two threads from which concurrency is considered to pay.
+#define MIN_SPEEDUP 1.1
+
+/// Work of a script, in operations of the cost model of its path.
+#define WORK_BUDGET 5000000.0
+
+/// Lowest number of blocks of a script.
+#define MIN_BLOCKS 16
+
+/// Highest number of blocks of a script.
+#define MAX_BLOCKS 20000
+
+/// Number of sizes of operands of every path.
+#define SIZE_COUNT 6
+
+/// Number of files of the batch path.
+#define BATCH_FILES 16
+
+/// Option disabling the cutoff of the calculator.
+#define NO_CUTOFF "0"
+
+/// Usage message of the program.
+#define USAGE_MESSAGE \
+    "usage: poly_scaling [-t max_threads] [-r runs] path/to/poly\n"
+
+/**
+ * Concurrent path of the calculator.
+ */
+typedef struct Path {
+    const char *name;       ///< name of the path
+    const char *command;    ///< command of a block or NULL for the batch mode
+    GenShape shape;         ///< shape of the operands
+    poly_exp_t sizes[SIZE_COUNT]; ///< highest exponents of operands
+    unsigned cost_power;    ///< cost of a block is about terms to this power
+} Path;
+
+/// Paths which are measured. A block of a -j path pushes two operands,
+/// executes its command and pops the result, so blocks are independent;
+/// the result of the last block is left for STATS. A block of the batch
+/// path is a literal which is popped.
+static const Path paths[] = {
+    {"mul", "MUL", {2, 0, 0.5, -100, 100, GEN_NEST_FULL},
+     {1, 3, 7, 15, 23, 31}, 2},
+    {"add", "ADD", {2, 0, 0.5, -100, 100, GEN_NEST_FULL},
+     {1, 3, 7, 15, 31, 63}, 1},
+    {"compose", "COMPOSE 1", {1, 0, 1, -10, 10, GEN_NEST_FULL},
+     {1, 2, 3, 4, 8, 16}, 5},
+    {"parse", NULL, {2, 0, 0.5, -1000000, 1000000, GEN_NEST_FULL},
+     {1, 3, 7, 15, 31, 63}, 1},
+};
+
+/// Number of measured paths.
+#define PATH_COUNT (sizeof(paths) / sizeof(paths[0]))
+
+/**
+ * Reads a monotonic clock.
+ * @return time in nanoseconds
+ */
+static double ScalingNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec * NS_PER_SECOND + (double) now.tv_nsec;
+}
+
+/**
+ * Writes a script of blocks of a path.
+ * @param g : generator
+ * @param path : path
+ * @param shape : shape of the operands
+ * @param blocks : number of blocks
+ * @param file_path : path of the file for the script
+ * @param terms : place to which the terms of the operands are added
+ * @param operands : place to which the number of the operands is added
+ * @return could the file be written
+ */
+static bool ScalingGenerate(Generator *g, const Path *path,
+                            const GenShape *shape, size_t blocks,
+                            const char *file_path, double *terms,
+                            size_t *operands) {
+    FILE *file = fopen(file_path, "w");
+    if (file == NULL) {
+        return false;
+    }
+
+    SetStreams(NULL, file, NULL);
+    for (size_t i = 0; i < blocks; i++) {
+        for (size_t j = 0; j < (path->command != NULL ? 2 : 1); j++) {
+            Poly p = GenPoly(g, shape);
+            *terms += (double) PolyTermCount(&p);
+            (*operands)++;
+            PolyPrint(&p);
+            fputc('\n', file);
+            PolyDestroy(&p);
+        }
+        if (path->command != NULL) {
+            fprintf(file, "%s\n", path->command);
+        }
+        if (path->command == NULL || i + 1 < blocks) {
+            fputs("POP\n", file);
+        }
+    }
+    if (path->command != NULL) {
+        fputs("STATS\n", file);
+    }
+    SetStreams(NULL, NULL, NULL);
+    return fclose(file) == 0;
+}
+
+/**
+ * Runs the calculator once.
+ * @param argv : arguments of the calculator, the first one is its path
+ * @param script : path of the standard input or NULL
+ * @param result : path of the file for the standard output or NULL
+ * @param wall_ns : place for the wall time
+ * @return did the calculator run
+ */
+static bool ScalingRun(char **argv, const char *script, const char *result,
+                       double *wall_ns) {
+    double start = ScalingNow();
+    pid_t pid = fork();
+    if (pid == 0) {
+        int input = open(script != NULL ? script : "/dev/null", O_RDONLY);
+        int output = result != NULL
+                     ? open(result, O_WRONLY | O_CREAT | O_TRUNC, 0644)
+                     : open("/dev/null", O_WRONLY);
+        int errors = open("/dev/null", O_WRONLY);
+        if (input < 0 || output < 0 || errors < 0
+            || dup2(input, STDIN_FILENO) < 0
+            || dup2(output, STDOUT_FILENO) < 0
+            || dup2(errors, STDERR_FILENO) < 0) {
+            _exit(EXEC_FAILED);
+        }
+        close(input);
+        close(output);
+        close(errors);
+        execv(argv[0], argv);
+        _exit(EXEC_FAILED);
+    }
+    if (pid < 0) {
+        return false;
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) != pid) {
+        return false;
+    }
+    *wall_ns = ScalingNow() - start;
+    return WIFEXITED(status) && WEXITSTATUS(status) != EXEC_FAILED;
+}
+
+/**
+ * Compares two measured wall times.
+ * @param a : first time
+ * @param b : second time
+ * @return result of comparison
+ */
+static int ScalingCompare(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Measures the median wall time of the calculator on a path with a given
+ * number of threads.
+ * @param poly : path of the calculator
+ * @param path : path
+ * @param files : generated files, one script of a -j path
+ * @param threads : number of threads
+ * @param runs : number of timed runs
+ * @param result : path of the file for the output of the first run or NULL
+ * @param wall_ns : place for the median time
+ * @return did the calculator run
+ */
+static bool ScalingMeasure(char *poly, const Path *path, char **files,
+                           size_t threads, size_t runs, const char *result,
+                           double *wall_ns) {
+    char jobs[BUFFER_SIZE], no_cutoff[] = NO_CUTOFF;
+    char batch_option[] = "--batch", jobs_option[] = "-j",
+         terms_option[] = "--parallel-terms";
+    char *argv[BATCH_FILES + 5] = {poly};
+    size_t argc = 1;
+    const char *script = NULL;
+
+    snprintf(jobs, sizeof(jobs), "%zu", threads);
+    if (path->command == NULL) {
+        argv[argc++] = batch_option;
+        argv[argc++] = jobs_option;
+        argv[argc++] = jobs;
+        for (size_t i = 0; i < BATCH_FILES; i++) {
+            argv[argc++] = files[i];
+        }
+    } else {
+        script = files[0];
+        if (threads > 1) {
+            argv[argc++] = jobs_option;
+            argv[argc++] = jobs;
+            argv[argc++] = terms_option;
+            argv[argc++] = no_cutoff;
+        }
+    }
+    argv[argc] = NULL;
+
+    double *times = malloc(runs * sizeof(double));
+    CHECK_PTR(times);
+    bool valid = true;
+    for (size_t i = 0; i < runs && valid; i++) {
+        valid = ScalingRun(argv, script, i == 0 ? result : NULL, &times[i]);
+    }
+    if (valid) {
+        qsort(times, runs, sizeof(double), ScalingCompare);
+        *wall_ns = times[runs / 2];
+    }
+    free(times);
+    return valid;
+}
+
+/**
+ * Checks if two files have the same contents.
+ * @param first : path of the first file
+ * @param second : path of the second file
+ * @return are both of them readable and the same
+ */
+static bool ScalingSame(const char *first, const char *second) {
+    FILE *a = fopen(first, "r"), *b = fopen(second, "r");
+    bool same = a != NULL && b != NULL;
+    int c = 0;
+
+    while (same && c != EOF) {
+        c = fgetc(a);
+        same = c == fgetc(b);
+    }
+    if (a != NULL) {
+        fclose(a);
+    }
+    if (b != NULL) {
+        fclose(b);
+    }
+    return same;
+}
+
+/**
+ * Removes the files of the batch path together with their results.
+ * @param files : paths of the files
+ * @param count : number of the files
+ */
+static void ScalingRemove(char **files, size_t count) {
+    char result[BUFFER_SIZE];
+
+    for (size_t i = 0; i < count; i++) {
+        unlink(files[i]);
+        snprintf(result, sizeof(result), "%s.out", files[i]);
+        unlink(result);
+        snprintf(result, sizeof(result), "%s.err", files[i]);
+        unlink(result);
+    }
+}
+
+/**
+ * Measures a path at all of its sizes and writes a line of JSON for every
+ * size and one with the crossover of the path.
+ * @param poly : path of the calculator
+ * @param path : path
+ * @param directory : directory for temporary files
+ * @param threads : numbers of threads, starting with 1
+ * @param thread_count : number of the numbers
+ * @param runs : number of timed runs
+ * @param crossover : place for the crossover in terms or -1 if there is none
+ * @return did the calculator run
+ */
+static bool ScalingPath(char *poly, const Path *path, const char *directory,
+                        const size_t *threads, size_t thread_count,
+                        size_t runs, double *crossover) {
+    char names[BATCH_FILES][BUFFER_SIZE];
+    char *files[BATCH_FILES];
+    char results[2][BUFFER_SIZE];
+    size_t file_count = path->command != NULL ? 1 : BATCH_FILES;
+    double *wall_ns = malloc(thread_count * sizeof(double));
+    CHECK_PTR(wall_ns);
+    bool valid = true;
+
+    *crossover = -1;
+    for (size_t i = 0; i < file_count; i++) {
+        snprintf(names[i], sizeof(names[i]), "%s/%s.%zu", directory,
+                 path->name, i);
+        files[i] = names[i];
+    }
+    for (size_t i = 0; i < 2; i++) {
+        snprintf(results[i], sizeof(results[i]), "%s/%s.result.%zu",
+                 directory, path->name, i);
+    }
+
+    for (size_t s = 0; s < SIZE_COUNT && valid; s++) {
+        GenShape shape = path->shape;
+        shape.max_exp = path->sizes[s];
+
+        Generator g;
+        GenInit(&g, SEED);
+        Poly probe = GenPoly(&g, &shape);
+        double probe_terms = (double) PolyTermCount(&probe), cost = 1;
+        PolyDestroy(&probe);
+        for (unsigned i = 0; i < path->cost_power; i++) {
+            cost *= probe_terms;
+        }
+        double wanted = WORK_BUDGET / (cost > 1 ? cost : 1);
+        size_t blocks = wanted < MIN_BLOCKS ? MIN_BLOCKS
+                        : wanted > MAX_BLOCKS ? MAX_BLOCKS : (size_t) wanted;
+
+        double terms = 0;
+        size_t operands = 0;
+        for (size_t i = 0; i < file_count && valid; i++) {
+            valid = ScalingGenerate(&g, path, &shape,
+                                    (blocks + file_count - 1) / file_count,
+                                    files[i], &terms, &operands);
+        }
+        for (size_t t = 0; t < thread_count && valid; t++) {
+            const char *result = path->command == NULL ? NULL
+                                 : results[t == 0 ? 0 : 1];
+            valid = ScalingMeasure(poly, path, files, threads[t], runs, result,
+                                   &wall_ns[t]);
+            if (valid && t > 0 && result != NULL
+                && !ScalingSame(results[0], result)) {
+                fprintf(stderr, "poly_scaling: output of %s with -j %zu "
+                                "differs from the sequential one\n",
+                        path->name, threads[t]);
+                valid = false;
+            }
+        }
+        ScalingRemove(files, file_count);
+        unlink(results[0]);
+        unlink(results[1]);
+        if (!valid) {
+            break;
+        }
+
+        terms /= (double) operands;
+        printf("{\"path\": \"%s\", \"terms\": %.1f, \"blocks\": %zu, "
+               "\"threads\": [", path->name, terms, blocks);
+        for (size_t t = 0; t < thread_count; t++) {
+            double speedup = wall_ns[0] / wall_ns[t];
+            printf("%s{\"threads\": %zu, \"wall_ns\": %.1f, \"speedup\": %.3f, "
+                   "\"efficiency\": %.3f}", t == 0 ? "" : ", ", threads[t],
+                   wall_ns[t], speedup, speedup / (double) threads[t]);
+        }
+        printf("]}\n");
+        fflush(stdout);
+
+        if (thread_count > 1 && wall_ns[0] / wall_ns[1] >= MIN_SPEEDUP) {
+            if (*crossover < 0) {
+                *crossover = terms;
+            }
+        } else {
+            *crossover = -1;    // it has to pay at all of the larger sizes
+        }
+    }
+
+    free(wall_ns);
+    return valid;
+}
+
+/**
+ * Parses a positive number of an option.
+ * @param string : number
+ * @param value : place for the number
+ * @return is the number valid
+ */
+static bool ScalingParse(const char *string, size_t *value) {
+    char *last;
+
+    if (string[0] < '0' || string[0] > '9') {
+        return false;
+    }
+    *value = strtoull(string, &last, DECIMAL_BASE);
+    return *last == '\0' && *value > 0;
+}
+
+/**
+ * Runs the benchmark.
+ * @param argc : number of arguments
+ * @param argv : arguments
+ * @return exit code of the program
+ */
+int main(int argc, char **argv) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t max_threads = online > 1 ? (size_t) online : 2;
+    size_t runs = DEFAULT_RUNS;
+    int i = 1;
+    bool valid = true;
+
+    for (; i + 1 < argc && valid; i += 2) {
+        if (strcmp(argv[i], "-t") == 0) {
+            valid = ScalingParse(argv[i + 1], &max_threads);
+        } else if (strcmp(argv[i], "-r") == 0) {
+            valid = ScalingParse(argv[i + 1], &runs);
+        } else {
+            break;
+        }
+    }
+    if (!valid || i + 1 != argc) {
+        fprintf(stderr, USAGE_MESSAGE);
+        return EXIT_FAILURE;
+    }
+    char *poly = argv[i];
+
+    size_t threads[sizeof(size_t) * 8 + 1];
+    size_t thread_count = 0;
+    for (size_t t = 1; t < max_threads; t *= 2) {
+        threads[thread_count++] = t;
+    }
+    threads[thread_count++] = max_threads;
+
+    const char *tmp = getenv("TMPDIR");
+    char directory[BUFFER_SIZE];
+    snprintf(directory, sizeof(directory), "%s/poly_scaling.XXXXXX",
+             tmp != NULL ? tmp : "/tmp");
+    if (mkdtemp(directory) == NULL) {
+        fprintf(stderr, "poly_scaling: cannot create %s\n", directory);
+        return EXIT_FAILURE;
+    }
+
+    double suggested = -1;
+    for (size_t p = 0; p < PATH_COUNT && valid; p++) {
+        double crossover;
+        valid = ScalingPath(poly, &paths[p], directory, threads, thread_count,
+                            runs, &crossover);
+        if (valid) {
+            if (crossover < 0) {
+                printf("{\"path\": \"%s\", \"crossover_terms\": null}\n",
+                       paths[p].name);
+            } else {
+                printf("{\"path\": \"%s\", \"crossover_terms\": %.1f}\n",
+                       paths[p].name, crossover);
+            }
+            if (paths[p].command != NULL && crossover >= 0
+                && (suggested < 0 || crossover < suggested)) {
+                suggested = crossover;
+            }
+        }
+    }
+    rmdir(directory);
+    if (!valid) {
+        fprintf(stderr, "poly_scaling: cannot run %s\n", poly);
+        return EXIT_FAILURE;
+    }
+
+    if (suggested < 0) {
+        printf("{\"suggested_parallel_terms\": null}\n");
+        fprintf(stderr, "poly_scaling: concurrency doesn't pay at any "
+                        "measured size\n");
+    } else {
+        printf("{\"suggested_parallel_terms\": %zu}\n", (size_t) suggested);
+        fprintf(stderr, "poly_scaling: run poly -j %zu --parallel-terms %zu, "
+                        "or set SCHEDULER_PARALLEL_TERMS to it\n",
+                max_threads, (size_t) suggested);
+    }
+    return EXIT_SUCCESS;
+}
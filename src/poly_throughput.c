@@ -0,0 +1,456 @@
+/** @file
+  End-to-end throughput benchmark of the calculator.
+
+  Generates a fixed corpus of scripts which mirror typical use (parsing
+  large literals, multiplication, composition, printing and many small
+  commands), runs the calculator on each of them a few times and writes
+  a JSON report with lines per second, megabytes per second of input and
+  output, peak resident memory and the time of reading, executing and
+  the rest, as measured by the calculator's own --stats report. Given
+  a saved report it also gives the percentage change of every metric.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef _GNU_SOURCE
+/// Directive necessary for mkdtemp and wait4 to work.
+#define _GNU_SOURCE
+#endif
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "error_handler.h"
+#include "generator.h"
+#include "streams.h"
+
+/// Default number of timed runs of a script.
+#define DEFAULT_RUNS 3
+
+/// Seed of the corpus.
+#define SEED 2021
+
+/// Number of nanoseconds in a second.
+#define NS_PER_SECOND 1000000000.0
+
+/// Number of bytes in a megabyte.
+#define BYTES_PER_MB 1000000.0
+
+/// Size of the buffer for the output of the calculator.
+#define BUFFER_SIZE (1 << 16)
+
+/// Base of numbers of the arguments.
+#define DECIMAL_BASE 10
+
+/// Exit code of a child which could not run the calculator.
+#define EXEC_FAILED 127
+
+/// Option of the calculator naming the file for its report.
+#define STATS_OPTION "--stats"
+
+/// Usage message of the program.
+#define USAGE_MESSAGE \
+    "usage: poly_throughput [-r runs] [-b baseline.json] path/to/poly\n"
+
+/**
+ * Script of the corpus.
+ */
+typedef struct Corpus {
+    const char *name;       ///< name of the script
+    GenScript script;       ///< parameters of its generator
+} Corpus;
+
+/// Literals followed by POP: reading and parsing.
+static const GenMix parse_mix[] = {{"POLY", 1}, {"POP", 1}};
+
+/// Products of small polynomials. With at most two polynomials on
+/// the stack products are rarely multiplied again, so they stay small.
+static const GenMix mul_mix[] = {{"POLY", 2}, {"MUL", 1}, {"POP", 2}};
+
+/// Compositions of small polynomials, mostly popped right away, because
+/// composing compositions makes their degrees explode.
+static const GenMix compose_mix[] = {{"POLY", 3}, {"COMPOSE", 1},
+                                     {"POP", 4}};
+
+/// Printing of medium polynomials.
+static const GenMix print_mix[] = {{"POLY", 1}, {"PRINT", 4}, {"POP", 1}};
+
+/// Many cheap commands on small polynomials.
+static const GenMix small_mix[] = {
+    {"POLY", 2}, {"ZERO", 1}, {"CLONE", 2}, {"ADD", 2}, {"NEG", 1},
+    {"IS_ZERO", 1}, {"IS_EQ", 1}, {"DEG", 1}, {"SWAP", 1}, {"POP", 3},
+};
+
+/// Number of commands of a mix.
+#define MIX(mix) mix, sizeof(mix) / sizeof(mix[0])
+
+/// Scripts of the corpus.
+static const Corpus corpus[] = {
+    {"parse", {20000, MIX(parse_mix), {3, 20, 0.3, -1000000, 1000000,
+                                       GEN_NEST_FULL}, 4}},
+    {"mul", {200000, MIX(mul_mix), {2, 6, 0.5, -100, 100,
+                                    GEN_NEST_RANDOM}, 2}},
+    {"compose", {40000, MIX(compose_mix), {2, 3, 0.6, -10, 10,
+                                           GEN_NEST_RANDOM}, 3}},
+    {"print", {20000, MIX(print_mix), {3, 10, 0.4, -1000000, 1000000,
+                                       GEN_NEST_FULL}, 4}},
+    {"small", {300000, MIX(small_mix), {1, 3, 1, -10, 10,
+                                        GEN_NEST_FULL}, 8}},
+};
+
+/// Number of scripts of the corpus.
+#define CORPUS_COUNT (sizeof(corpus) / sizeof(corpus[0]))
+
+/**
+ * Measurements of a single run of the calculator.
+ */
+typedef struct Run {
+    double wall_ns;         ///< wall time
+    size_t output_bytes;    ///< bytes written to both output streams
+    long peak_rss_kb;       ///< peak resident memory in kilobytes
+} Run;
+
+/**
+ * Metric of the report which is compared with the baseline.
+ */
+typedef struct Metric {
+    const char *name;       ///< name of the metric
+    bool higher_is_better;  ///< is its growth an improvement
+} Metric;
+
+/// Metrics which are compared with the baseline.
+static const Metric metrics[] = {
+    {"lines_per_s", true}, {"input_mb_per_s", true},
+    {"output_mb_per_s", true}, {"wall_ns", false}, {"peak_rss_kb", false},
+    {"read_ns", false}, {"execute_ns", false}, {"other_ns", false},
+};
+
+/// Number of compared metrics.
+#define METRIC_COUNT (sizeof(metrics) / sizeof(metrics[0]))
+
+/**
+ * Reads a monotonic clock.
+ * @return time in nanoseconds
+ */
+static double ThroughputNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec * NS_PER_SECOND + (double) now.tv_nsec;
+}
+
+/**
+ * Generates a script of the corpus.
+ * @param entry : script of the corpus
+ * @param path : path of the file for it
+ * @return could the file be written
+ */
+static bool ThroughputGenerate(const Corpus *entry, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        return false;
+    }
+
+    Generator g;
+    GenInit(&g, SEED);
+    SetStreams(NULL, file, NULL);
+    GenPrintScript(&g, &entry->script);
+    SetStreams(NULL, NULL, NULL);
+    return fclose(file) == 0;
+}
+
+/**
+ * Runs the calculator on a script.
+ * @param poly : path of the calculator
+ * @param script : path of the script
+ * @param stats : path for its --stats report or NULL
+ * @param run : place for the measurements
+ * @return did the calculator run
+ */
+static bool ThroughputRun(const char *poly, const char *script,
+                          const char *stats, Run *run) {
+    int output[2];
+    if (pipe(output) != 0) {
+        return false;
+    }
+
+    double start = ThroughputNow();
+    pid_t pid = fork();
+    if (pid == 0) {
+        int input = open(script, O_RDONLY);
+        if (input < 0 || dup2(input, STDIN_FILENO) < 0
+            || dup2(output[1], STDOUT_FILENO) < 0
+            || dup2(output[1], STDERR_FILENO) < 0) {
+            _exit(EXEC_FAILED);
+        }
+        close(input);
+        close(output[0]);
+        close(output[1]);
+        if (stats != NULL) {
+            execl(poly, poly, STATS_OPTION, stats, (char *) NULL);
+        } else {
+            execl(poly, poly, (char *) NULL);
+        }
+        _exit(EXEC_FAILED);
+    }
+    close(output[1]);
+    if (pid < 0) {
+        close(output[0]);
+        return false;
+    }
+
+    char buffer[BUFFER_SIZE];
+    ssize_t length;
+    run->output_bytes = 0;
+    while ((length = read(output[0], buffer, BUFFER_SIZE)) > 0) {
+        run->output_bytes += (size_t) length;
+    }
+    close(output[0]);
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid) {
+        return false;
+    }
+    run->wall_ns = ThroughputNow() - start;
+    run->peak_rss_kb = usage.ru_maxrss;
+    return WIFEXITED(status) && WEXITSTATUS(status) != EXEC_FAILED;
+}
+
+/**
+ * Reads a whole file.
+ * @param path : path of the file
+ * @return contents of the file, which have to be freed, or NULL
+ */
+static char *ThroughputReadFile(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    size_t size = 0, reserved = BUFFER_SIZE;
+    char *contents = malloc(reserved);
+    CHECK_PTR(contents);
+    size_t length;
+    while ((length = fread(contents + size, 1, reserved - size - 1, file))
+           > 0) {
+        size += length;
+        if (size + 1 == reserved) {
+            reserved *= 2;
+            contents = realloc(contents, reserved);
+            CHECK_PTR(contents);
+        }
+    }
+    contents[size] = '\0';
+    fclose(file);
+    return contents;
+}
+
+/**
+ * Finds a number in a JSON report, in the object of a script or, if no
+ * script is given, anywhere.
+ * @param json : report
+ * @param script : name of the script or NULL
+ * @param name : name of the number
+ * @param value : place for the number
+ * @return was the number found
+ */
+static bool ThroughputLookup(const char *json, const char *script,
+                             const char *name, double *value) {
+    char key[BUFFER_SIZE];
+    const char *end = NULL;
+
+    if (script != NULL) {
+        snprintf(key, sizeof(key), "\"%s\": {", script);
+        json = strstr(json, key);
+        if (json == NULL) {
+            return false;
+        }
+        end = strchr(json, '}');
+    }
+
+    snprintf(key, sizeof(key), "\"%s\": ", name);
+    const char *found = strstr(json, key);
+    if (found == NULL || (end != NULL && found > end)) {
+        return false;
+    }
+    *value = strtod(found + strlen(key), NULL);
+    return true;
+}
+
+/**
+ * Compares two measured wall times.
+ * @param a : first time
+ * @param b : second time
+ * @return result of comparison
+ */
+static int ThroughputCompare(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Benchmarks the calculator on a script of the corpus and writes its
+ * object of the report.
+ * @param poly : path of the calculator
+ * @param entry : script of the corpus
+ * @param directory : directory for temporary files
+ * @param runs : number of timed runs
+ * @param baseline : saved report or NULL
+ * @param first : is it the first script of the report
+ * @return did the calculator run
+ */
+static bool ThroughputScript(const char *poly, const Corpus *entry,
+                             const char *directory, size_t runs,
+                             const char *baseline, bool first) {
+    char script[BUFFER_SIZE], stats[BUFFER_SIZE];
+    struct stat info;
+    if (snprintf(script, sizeof(script), "%s/%s.in", directory,
+                 entry->name) >= (int) sizeof(script)
+        || snprintf(stats, sizeof(stats), "%s/%s.json", directory,
+                    entry->name) >= (int) sizeof(stats)
+        || !ThroughputGenerate(entry, script) || stat(script, &info) != 0) {
+        fprintf(stderr, "poly_throughput: cannot write %s\n", script);
+        return false;
+    }
+
+    double *times = malloc(runs * sizeof(double));
+    CHECK_PTR(times);
+    Run run = {0};
+    long peak_rss_kb = 0;
+    bool valid = true;
+    for (size_t i = 0; i < runs && valid; i++) {
+        valid = ThroughputRun(poly, script, NULL, &run);
+        times[i] = run.wall_ns;
+        if (run.peak_rss_kb > peak_rss_kb) {
+            peak_rss_kb = run.peak_rss_kb;
+        }
+    }
+
+    Run instrumented;
+    char *report = NULL;
+    double read_ns = 0, execute_ns = 0;
+    valid = valid && ThroughputRun(poly, script, stats, &instrumented)
+            && (report = ThroughputReadFile(stats)) != NULL
+            && ThroughputLookup(report, NULL, "read_ns", &read_ns)
+            && ThroughputLookup(report, NULL, "execute_ns", &execute_ns);
+    free(report);
+    unlink(stats);
+    unlink(script);
+    if (!valid) {
+        fprintf(stderr, "poly_throughput: cannot run %s\n", poly);
+        free(times);
+        return false;
+    }
+
+    qsort(times, runs, sizeof(double), ThroughputCompare);
+    double wall_ns = times[runs / 2];
+    double seconds = wall_ns / NS_PER_SECOND;
+    double other_ns = instrumented.wall_ns - read_ns - execute_ns;
+    double values[METRIC_COUNT] = {
+        (double) entry->script.lines / seconds,
+        (double) info.st_size / BYTES_PER_MB / seconds,
+        (double) run.output_bytes / BYTES_PER_MB / seconds,
+        wall_ns, (double) peak_rss_kb, read_ns, execute_ns,
+        other_ns > 0 ? other_ns : 0};
+    free(times);
+
+    printf("%s\n    \"%s\": {\"lines\": %zu, \"input_bytes\": %lld, "
+           "\"output_bytes\": %zu", first ? "" : ",", entry->name,
+           entry->script.lines, (long long) info.st_size, run.output_bytes);
+    for (size_t i = 0; i < METRIC_COUNT; i++) {
+        printf(", \"%s\": %.1f", metrics[i].name, values[i]);
+    }
+
+    if (baseline != NULL) {
+        printf(", \"change_percent\": {");
+        bool first_change = true;
+        for (size_t i = 0; i < METRIC_COUNT; i++) {
+            double old;
+            if (!ThroughputLookup(baseline, entry->name, metrics[i].name,
+                                  &old) || old == 0) {
+                continue;
+            }
+            double change = (values[i] - old) / old * 100;
+            printf("%s\"%s\": %.1f", first_change ? "" : ", ",
+                   metrics[i].name, change);
+            fprintf(stderr, "%-8s %-16s %14.1f -> %14.1f %+7.1f%%%s\n",
+                    entry->name, metrics[i].name, old, values[i], change,
+                    (change > 0) == metrics[i].higher_is_better
+                    ? "" : " (worse)");
+            first_change = false;
+        }
+        printf("}");
+    }
+    printf("}");
+    fflush(stdout);
+    return true;
+}
+
+/**
+ * Runs the benchmark.
+ * @param argc : number of arguments
+ * @param argv : arguments
+ * @return exit code of the program
+ */
+int main(int argc, char **argv) {
+    size_t runs = DEFAULT_RUNS;
+    const char *baseline_path = NULL;
+    int i = 1;
+
+    for (; i + 1 < argc; i += 2) {
+        char *last;
+        if (strcmp(argv[i], "-r") == 0) {
+            runs = strtoull(argv[i + 1], &last, DECIMAL_BASE);
+            if (*last != '\0' || runs == 0) {
+                break;
+            }
+        } else if (strcmp(argv[i], "-b") == 0) {
+            baseline_path = argv[i + 1];
+        } else {
+            break;
+        }
+    }
+    if (i + 1 != argc) {
+        fprintf(stderr, USAGE_MESSAGE);
+        return EXIT_FAILURE;
+    }
+    const char *poly = argv[i];
+
+    char *baseline = NULL;
+    if (baseline_path != NULL
+        && (baseline = ThroughputReadFile(baseline_path)) == NULL) {
+        fprintf(stderr, "poly_throughput: cannot read %s\n", baseline_path);
+        return EXIT_FAILURE;
+    }
+
+    const char *tmp = getenv("TMPDIR");
+    char directory[BUFFER_SIZE];
+    snprintf(directory, sizeof(directory), "%s/poly_throughput.XXXXXX",
+             tmp != NULL ? tmp : "/tmp");
+    if (mkdtemp(directory) == NULL) {
+        fprintf(stderr, "poly_throughput: cannot create %s\n", directory);
+        free(baseline);
+        return EXIT_FAILURE;
+    }
+
+    bool valid = true;
+    printf("{\n  \"poly\": \"%s\",\n  \"runs\": %zu,\n  \"scripts\": {",
+           poly, runs);
+    for (size_t j = 0; j < CORPUS_COUNT && valid; j++) {
+        valid = ThroughputScript(poly, &corpus[j], directory, runs, baseline,
+                                 j == 0);
+    }
+    printf("\n  }\n}\n");
+
+    rmdir(directory);
+    free(baseline);
+    return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
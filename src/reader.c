@@ -0,0 +1,300 @@
+/** @file
+  Implementation of a reader of calculator commands, which expands loops
+  and macros.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "error_handler.h"
+#include "reader.h"
+#include "streams.h"
+
+/// When increasing an array's size, this is the multiplier.
+#define SIZE_EXPAND_CONST 2
+
+/**
+ * Single element of a block - a command or a nested block.
+ */
+typedef struct Step {
+    Command cmd;    ///< command or #CMD_NONE if the step is a nested block
+    size_t count;   ///< number of repetitions of the nested block
+    Block *body;    ///< nested block or NULL
+} Step;
+
+/**
+ * Pre-parsed body of a loop or a macro. Blocks are shared by macros,
+ * calls and frames, so they count their references.
+ */
+struct Block {
+    Step *steps;        ///< steps of the body
+    size_t count;       ///< number of steps
+    size_t reserved;    ///< amount of reserved space
+    size_t refs;        ///< number of references
+};
+
+/**
+ * Macro defined by DEF.
+ */
+struct Macro {
+    char *name;     ///< name of the macro
+    Block *body;    ///< body of the macro
+};
+
+/**
+ * Loop or macro call which is being expanded.
+ */
+struct Frame {
+    Block *body;        ///< expanded block
+    size_t next;        ///< index of the next step
+    size_t remaining;   ///< number of remaining repetitions, with this one
+};
+
+/**
+ * Creates an empty block with a single reference.
+ * @return block
+ */
+static Block *BlockNew(void) {
+    Block *block = malloc(sizeof(Block));
+    CHECK_PTR(block);
+    *block = (Block) {.steps = NULL, .count = 0, .reserved = 0, .refs = 1};
+    return block;
+}
+
+/**
+ * Appends a step to a block.
+ * @param block : block
+ * @param step : step to append
+ */
+static void BlockAdd(Block *block, Step step) {
+    if (block->count == block->reserved) {
+        block->reserved = block->reserved * SIZE_EXPAND_CONST + 1;
+        block->steps = realloc(block->steps, block->reserved * sizeof(Step));
+        CHECK_PTR(block->steps);
+    }
+    block->steps[block->count++] = step;
+}
+
+/**
+ * Drops a reference to a block and frees it if it was the last one.
+ * @param block : block
+ */
+static void BlockRelease(Block *block) {
+    if (--block->refs > 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < block->count; i++) {
+        if (block->steps[i].body != NULL) {
+            BlockRelease(block->steps[i].body);
+        }
+        else {
+            CommandDestroy(&block->steps[i].cmd);
+        }
+    }
+    free(block->steps);
+    free(block);
+}
+
+/**
+ * Finds a macro.
+ * @param r : reader
+ * @param name : name of the macro
+ * @return macro or NULL if it is not defined
+ */
+static Macro *ReaderFind(Reader *r, const char *name) {
+    for (size_t i = 0; i < r->macro_count; i++) {
+        if (strcmp(r->macros[i].name, name) == 0) {
+            return &r->macros[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Defines a macro, replacing its previous definition. Calls that were
+ * already read keep the previous body. Takes over the name and the body.
+ * @param r : reader
+ * @param name : name of the macro
+ * @param body : body of the macro
+ */
+static void ReaderDefine(Reader *r, char *name, Block *body) {
+    Macro *macro = ReaderFind(r, name);
+
+    if (macro != NULL) {
+        free(name);
+        BlockRelease(macro->body);
+        macro->body = body;
+        return;
+    }
+
+    if (r->macro_count == r->macro_reserved) {
+        r->macro_reserved = r->macro_reserved * SIZE_EXPAND_CONST + 1;
+        r->macros = realloc(r->macros, r->macro_reserved * sizeof(Macro));
+        CHECK_PTR(r->macros);
+    }
+    r->macros[r->macro_count++] = (Macro) {.name = name, .body = body};
+}
+
+/**
+ * Starts expanding a block. Empty blocks and loops with no repetitions
+ * are skipped right away.
+ * @param r : reader
+ * @param body : block
+ * @param count : number of repetitions
+ */
+static void ReaderPush(Reader *r, Block *body, size_t count) {
+    if (count == 0 || body->count == 0) {
+        return;
+    }
+
+    if (r->frame_count == r->frame_reserved) {
+        r->frame_reserved = r->frame_reserved * SIZE_EXPAND_CONST + 1;
+        r->frames = realloc(r->frames, r->frame_reserved * sizeof(Frame));
+        CHECK_PTR(r->frames);
+    }
+    body->refs++;
+    r->frames[r->frame_count++] = (Frame) {.body = body, .next = 0,
+                                           .remaining = count};
+}
+
+static bool ReaderStep(Reader *r, Step *step);
+
+/**
+ * Reads steps of a body up to the matching END.
+ * @param r : reader
+ * @param body : block for the steps
+ * @return false if the input ended before END
+ */
+static bool ReaderBlock(Reader *r, Block *body) {
+    while (!feof(InputStream())) {
+        Step step;
+        if (!ReaderStep(r, &step)) {
+            return true;
+        }
+        if (step.body != NULL || step.cmd.type != CMD_NONE) {
+            BlockAdd(body, step);
+        }
+    }
+    return false;
+}
+
+/**
+ * Reads a single line of the input, together with the body of a block
+ * if the line begins one. DEF defines its macro right away and CALL
+ * becomes a block which is repeated once.
+ * @param r : reader
+ * @param step : place for the read step
+ * @return false if the line is END
+ */
+static bool ReaderStep(Reader *r, Step *step) {
+    r->line_number++;
+    Command cmd = CommandRead(&r->line, &r->size, r->line_number);
+    Command error = {.type = CMD_ERROR, .line_number = cmd.line_number};
+    *step = (Step) {.cmd = {.type = CMD_NONE}, .count = 0, .body = NULL};
+
+    if (cmd.type == CMD_END) {
+        return false;
+    }
+    else if (cmd.type == CMD_REPEAT || cmd.type == CMD_DEF) {
+        Block *body = BlockNew();
+
+        if (!ReaderBlock(r, body)) {
+            BlockRelease(body);
+            CommandDestroy(&cmd);
+            error.error_code = MISSING_END_CODE;
+            step->cmd = error;
+        }
+        else if (cmd.type == CMD_REPEAT) {
+            step->count = cmd.param;
+            step->body = body;
+        }
+        else {
+            ReaderDefine(r, cmd.name, body);
+        }
+    }
+    else if (cmd.type == CMD_CALL) {
+        Macro *macro = ReaderFind(r, cmd.name);
+
+        if (macro == NULL) {
+            error.error_code = MACRO_UNDEFINED_CODE;
+            step->cmd = error;
+        }
+        else {
+            step->count = 1;
+            step->body = macro->body;
+            step->body->refs++;
+        }
+        CommandDestroy(&cmd);
+    }
+    else {
+        step->cmd = cmd;
+    }
+    return true;
+}
+
+void ReaderInit(Reader *r) {
+    *r = (Reader) {.line = NULL, .size = 0, .line_number = 0,
+                   .macros = NULL, .macro_count = 0, .macro_reserved = 0,
+                   .frames = NULL, .frame_count = 0, .frame_reserved = 0};
+}
+
+bool ReaderNext(Reader *r, Command *cmd) {
+    for (;;) {
+        if (r->frame_count > 0) {
+            Frame *frame = &r->frames[r->frame_count - 1];
+
+            if (frame->next == frame->body->count) {
+                if (--frame->remaining == 0) {
+                    BlockRelease(frame->body);
+                    r->frame_count--;
+                    continue;
+                }
+                frame->next = 0;
+            }
+
+            Step *step = &frame->body->steps[frame->next++];
+            if (step->body != NULL) {
+                ReaderPush(r, step->body, step->count);
+                continue;
+            }
+            *cmd = CommandClone(&step->cmd);
+            return true;
+        }
+
+        if (feof(InputStream())) {
+            return false;
+        }
+
+        Step step;
+        if (!ReaderStep(r, &step)) {    // END outside of a block
+            *cmd = (Command) {.type = CMD_ERROR, .line_number = r->line_number,
+                              .error_code = WRONG_COMMAND_CODE};
+            return true;
+        }
+        if (step.body != NULL) {
+            ReaderPush(r, step.body, step.count);
+            BlockRelease(step.body);
+        }
+        else if (step.cmd.type != CMD_NONE) {
+            *cmd = step.cmd;
+            return true;
+        }
+    }
+}
+
+void ReaderDestroy(Reader *r) {
+    for (size_t i = 0; i < r->frame_count; i++) {
+        BlockRelease(r->frames[i].body);
+    }
+    for (size_t i = 0; i < r->macro_count; i++) {
+        free(r->macros[i].name);
+        BlockRelease(r->macros[i].body);
+    }
+    free(r->frames);
+    free(r->macros);
+    free(r->line);
+}
@@ -0,0 +1,70 @@
+/** @file
+  Interface of a reader of calculator commands, which expands loops
+  and macros.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef READER_H
+#define READER_H
+
+#include "command.h"
+
+/**
+ * Pre-parsed body of a loop or a macro.
+ */
+typedef struct Block Block;
+
+/**
+ * Macro defined by DEF.
+ */
+typedef struct Macro Macro;
+
+/**
+ * Loop or macro call which is being expanded.
+ */
+typedef struct Frame Frame;
+
+/**
+ * @brief Reader of the commands of the input stream.
+ * @details Bodies of REPEAT and DEF are parsed once, up to the matching END.
+ * Later they are expanded command after command from the parsed form, so
+ * the executors never see blocks. Macros are defined when they are read
+ * and CALL refers to the definition that is visible at that point, so
+ * a macro can't call itself.
+ */
+typedef struct Reader {
+    char *line;             ///< buffer for the line
+    size_t size;            ///< size of the buffer
+    size_t line_number;     ///< number of the last read line
+    Macro *macros;          ///< defined macros
+    size_t macro_count;     ///< number of macros
+    size_t macro_reserved;  ///< amount of reserved space for macros
+    Frame *frames;          ///< blocks being expanded, innermost last
+    size_t frame_count;     ///< number of frames
+    size_t frame_reserved;  ///< amount of reserved space for frames
+} Reader;
+
+/**
+ * Initializes a reader of the input stream.
+ * @param r : reader
+ */
+void ReaderInit(Reader *r);
+
+/**
+ * Gives the next command to execute, skipping blank lines and comments.
+ * @param r : reader
+ * @param cmd : place for the command
+ * @return false if there are no more commands
+ */
+bool ReaderNext(Reader *r, Command *cmd);
+
+/**
+ * Frees a reader together with its macros.
+ * @param r : reader
+ */
+void ReaderDestroy(Reader *r);
+
+#endif //READER_H
@@ -0,0 +1,155 @@
+/** @file
+  Implementation of named polynomial registers.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "error_handler.h"
+#include "registers.h"
+
+/// Number of slots of a table when the first register is stored.
+#define INITIAL_CAPACITY 16
+
+/// When increasing the table's size, this is the multiplier.
+#define SIZE_EXPAND_CONST 2
+
+/// Offset basis of the FNV-1a hash.
+#define FNV_OFFSET 14695981039346656037ULL
+
+/// Prime of the FNV-1a hash.
+#define FNV_PRIME 1099511628211ULL
+
+void RegistersInit(Registers *r) {
+    r->slots = NULL;
+    r->capacity = 0;
+    r->count = 0;
+}
+
+/**
+ * Computes the FNV-1a hash of a name.
+ * @param name : name
+ * @return hash
+ */
+static uint64_t Hash(const char *name) {
+    uint64_t hash = FNV_OFFSET;
+    for (; *name != '\0'; name++) {
+        hash ^= (unsigned char) *name;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * Finds the slot of a register, or the free slot where it would be stored.
+ * Requires a table with at least one free slot.
+ * @param r : registers
+ * @param name : name of the register
+ * @return index of the slot
+ */
+static size_t FindSlot(const Registers *r, const char *name) {
+    size_t mask = r->capacity - 1;
+    size_t index = Hash(name) & mask;
+
+    while (r->slots[index].name != NULL
+           && strcmp(r->slots[index].name, name) != 0) {
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+/**
+ * Resizes the table, moving all of the registers.
+ * @param r : registers
+ * @param capacity : new number of slots, a power of 2
+ */
+static void Rehash(Registers *r, size_t capacity) {
+    Register *old_slots = r->slots;
+    size_t old_capacity = r->capacity;
+
+    r->slots = calloc(capacity, sizeof(Register));
+    CHECK_PTR(r->slots);
+    r->capacity = capacity;
+
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_slots[i].name != NULL) {
+            r->slots[FindSlot(r, old_slots[i].name)] = old_slots[i];
+        }
+    }
+    free(old_slots);
+}
+
+void RegistersStore(Registers *r, const char *name, Poly poly) {
+    if (r->capacity == 0) {
+        Rehash(r, INITIAL_CAPACITY);
+    }
+    else if ((r->count + 1) * 2 > r->capacity) {  // keeping load below 1/2
+        Rehash(r, r->capacity * SIZE_EXPAND_CONST);
+    }
+
+    Register *slot = &r->slots[FindSlot(r, name)];
+    if (slot->name != NULL) {
+        PolyDestroy(&slot->poly);
+    }
+    else {
+        size_t len = strlen(name);
+        slot->name = malloc(len + 1);
+        CHECK_PTR(slot->name);
+        memcpy(slot->name, name, len + 1);
+        r->count++;
+    }
+    slot->poly = poly;
+}
+
+Poly *RegistersFind(Registers *r, const char *name) {
+    if (r->count == 0) {
+        return NULL;
+    }
+
+    Register *slot = &r->slots[FindSlot(r, name)];
+    return slot->name != NULL ? &slot->poly : NULL;
+}
+
+bool RegistersTake(Registers *r, const char *name, Poly *poly) {
+    if (r->count == 0) {
+        return false;
+    }
+
+    size_t mask = r->capacity - 1;
+    size_t hole = FindSlot(r, name);
+    if (r->slots[hole].name == NULL) {
+        return false;
+    }
+
+    *poly = r->slots[hole].poly;
+    free(r->slots[hole].name);
+    r->slots[hole].name = NULL;
+    r->count--;
+
+    // moves back the following registers, so no probe sequence is broken
+    for (size_t i = (hole + 1) & mask; r->slots[i].name != NULL;
+         i = (i + 1) & mask) {
+        size_t home = Hash(r->slots[i].name) & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            r->slots[hole] = r->slots[i];
+            r->slots[i].name = NULL;
+            hole = i;
+        }
+    }
+    return true;
+}
+
+void RegistersDestroy(Registers *r) {
+    for (size_t i = 0; i < r->capacity; i++) {
+        if (r->slots[i].name != NULL) {
+            free(r->slots[i].name);
+            PolyDestroy(&r->slots[i].poly);
+        }
+    }
+    free(r->slots);
+    RegistersInit(r);
+}
@@ -0,0 +1,69 @@
+/** @file
+  Interface of named polynomial registers.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef REGISTERS_H
+#define REGISTERS_H
+
+#include "poly.h"
+
+/**
+ * Single slot of the hash table of registers.
+ */
+typedef struct Register {
+    char *name; ///< name of the register, NULL if the slot is free
+    Poly poly;  ///< stored polynomial
+} Register;
+
+/**
+ * Hash table (with linear probing) mapping names to polynomials.
+ */
+typedef struct Registers {
+    Register *slots;    ///< slots of the table
+    size_t capacity;    ///< number of slots, a power of 2 or 0
+    size_t count;       ///< number of used slots
+} Registers;
+
+/**
+ * Initializes an empty set of registers.
+ * @param r : registers to initialize
+ */
+void RegistersInit(Registers *r);
+
+/**
+ * Stores a polynomial in a register, destroying its previous contents.
+ * Takes over the polynomial.
+ * @param r : registers
+ * @param name : name of the register
+ * @param poly : polynomial to store
+ */
+void RegistersStore(Registers *r, const char *name, Poly poly);
+
+/**
+ * Finds a register.
+ * @param r : registers
+ * @param name : name of the register
+ * @return pointer to the stored polynomial or NULL if the register is empty
+ */
+Poly *RegistersFind(Registers *r, const char *name);
+
+/**
+ * Empties a register, moving its polynomial out without copying it.
+ * @param r : registers
+ * @param name : name of the register
+ * @param poly : place for the polynomial
+ * @return was the register not empty
+ */
+bool RegistersTake(Registers *r, const char *name, Poly *poly);
+
+/**
+ * Destroys all registers with their contents.
+ * @param r : registers
+ */
+void RegistersDestroy(Registers *r);
+
+#endif //REGISTERS_H
@@ -0,0 +1,625 @@
+/** @file
+  Implementation of the concurrent executor of calculator commands.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef _POSIX_C_SOURCE
+/// Directive necessary for open_memstream to work.
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "command.h"
+#include "error_handler.h"
+#include "reader.h"
+#include "scheduler.h"
+#include "streams.h"
+
+/// Maximal number of commands analysed and executed together.
+#define SCHEDULER_WINDOW 4096
+
+/// Marks a value that is not produced by any task of the window.
+#define NO_TASK SIZE_MAX
+
+/// Marks an empty register.
+#define NO_VALUE SIZE_MAX
+
+/// When increasing an array's size, this is the multiplier.
+#define SIZE_EXPAND_CONST 2
+
+/**
+ * Dynamic array of indices.
+ */
+typedef struct IndexArray {
+    size_t *data;       ///< indices
+    size_t size;        ///< number of indices
+    size_t reserved;    ///< amount of reserved space
+} IndexArray;
+
+/**
+ * Polynomial that is on the stack at some point of a window.
+ */
+typedef struct Value {
+    Poly poly;          ///< polynomial, valid once its producer is done
+    size_t producer;    ///< task producing the value or #NO_TASK
+    IndexArray readers; ///< tasks using the value without taking it over
+} Value;
+
+/**
+ * Command of a window together with its place in the dataflow graph.
+ */
+typedef struct Task {
+    Command cmd;            ///< command to execute
+    bool fails;             ///< will the command only report an error
+    size_t depth;           ///< size of the stack in sequential execution
+    size_t first_input;     ///< first index of its inputs in the input array
+    size_t input_count;     ///< number of used values, bottom to top
+    size_t first_output;    ///< first value that it pushes
+    size_t output_count;    ///< number of values that it pushes
+    size_t remaining;       ///< number of unfinished tasks it depends on
+    IndexArray successors;  ///< tasks depending on it
+    char *out;              ///< buffer with its output
+    size_t out_len;         ///< length of the output
+    char *err;              ///< buffer with its error messages
+    size_t err_len;         ///< length of the error messages
+} Task;
+
+/**
+ * Register used in a window.
+ */
+typedef struct RegisterValue {
+    char *name;     ///< name of the register
+    size_t value;   ///< value stored in it or #NO_VALUE
+} RegisterValue;
+
+/**
+ * State of the concurrent executor.
+ */
+typedef struct Scheduler {
+    pthread_mutex_t lock;   ///< protects the ready tasks and the counters
+    pthread_cond_t changed; ///< signalled when a task gets ready or all are done
+    bool stop;              ///< should the workers finish
+    Task *tasks;            ///< tasks of the current window
+    size_t task_count;      ///< number of tasks of the current window
+    size_t finished;        ///< number of finished tasks
+    IndexArray ready;       ///< tasks that can be run
+    Value *values;          ///< values of the current window
+    size_t value_count;     ///< number of values
+    size_t value_reserved;  ///< amount of reserved space for values
+    IndexArray inputs;      ///< inputs of all of the tasks
+    IndexArray stack;       ///< values on top of the real stack, bottom to top
+    RegisterValue *registers; ///< registers used in the window
+    size_t register_count;  ///< number of used registers
+    size_t register_reserved; ///< amount of reserved space for registers
+    CalcState *real;        ///< state as it was before the window
+    size_t terms;           ///< terms of the values brought into the window
+    size_t parallel_terms;  ///< lowest mean terms per task run concurrently
+    FILE *out;              ///< output stream of the calculator
+    FILE *err;              ///< error stream of the calculator
+} Scheduler;
+
+/**
+ * Appends an index to an array.
+ * @param array : array
+ * @param index : index to append
+ */
+static void IndexArrayAdd(IndexArray *array, size_t index) {
+    if (array->size == array->reserved) {
+        array->reserved = array->reserved * SIZE_EXPAND_CONST + 1;
+        array->data = realloc(array->data, array->reserved * sizeof(size_t));
+        CHECK_PTR(array->data);
+    }
+    array->data[array->size++] = index;
+}
+
+/**
+ * Frees an array.
+ * @param array : array
+ */
+static void IndexArrayFree(IndexArray *array) {
+    free(array->data);
+    *array = (IndexArray) {.data = NULL, .size = 0, .reserved = 0};
+}
+
+/**
+ * Creates a new value of the window.
+ * @param sch : scheduler
+ * @param poly : polynomial, if it is already known
+ * @param producer : task producing the value or #NO_TASK
+ * @return index of the value
+ */
+static size_t SchedulerNewValue(Scheduler *sch, Poly poly, size_t producer) {
+    if (sch->value_count == sch->value_reserved) {
+        sch->value_reserved = sch->value_reserved * SIZE_EXPAND_CONST + 1;
+        sch->values = realloc(sch->values,
+                              sch->value_reserved * sizeof(Value));
+        CHECK_PTR(sch->values);
+    }
+
+    if (producer == NO_TASK) {
+        sch->terms += PolyTermCount(&poly);
+    }
+    sch->values[sch->value_count] = (Value) {.poly = poly,
+                                             .producer = producer,
+                                             .readers = {NULL, 0, 0}};
+    return sch->value_count++;
+}
+
+/**
+ * Adds an edge of the dataflow graph.
+ * @param sch : scheduler
+ * @param from : task that has to be done first or #NO_TASK
+ * @param to : task that depends on it
+ */
+static void SchedulerDepend(Scheduler *sch, size_t from, size_t to) {
+    if (from != NO_TASK) {
+        IndexArrayAdd(&sch->tasks[from].successors, to);
+        sch->tasks[to].remaining++;
+    }
+}
+
+/**
+ * Makes sure that at least @p need values are on the symbolic stack by
+ * moving polynomials from the top of the real stack under them.
+ * @param sch : scheduler
+ * @param need : number of needed values
+ */
+static void SchedulerPull(Scheduler *sch, size_t need) {
+    if (sch->stack.size >= need) {
+        return;
+    }
+
+    size_t missing = need - sch->stack.size;
+    for (size_t i = 0; i < missing; i++) {
+        IndexArrayAdd(&sch->stack, 0);
+    }
+    memmove(sch->stack.data + missing, sch->stack.data,
+            (sch->stack.size - missing) * sizeof(size_t));
+    for (size_t i = missing; i > 0; i--) {
+        sch->stack.data[i - 1] = SchedulerNewValue(sch, Pop(&sch->real->stack),
+                                                   NO_TASK);
+    }
+}
+
+/**
+ * Returns a register as seen by the window, moving its polynomial from
+ * the real registers when it is used for the first time.
+ * @param sch : scheduler
+ * @param name : name of the register
+ * @return register
+ */
+static RegisterValue *SchedulerRegister(Scheduler *sch, const char *name) {
+    for (size_t i = 0; i < sch->register_count; i++) {
+        if (strcmp(sch->registers[i].name, name) == 0) {
+            return &sch->registers[i];
+        }
+    }
+
+    if (sch->register_count == sch->register_reserved) {
+        sch->register_reserved = sch->register_reserved * SIZE_EXPAND_CONST + 1;
+        sch->registers = realloc(sch->registers,
+                                 sch->register_reserved * sizeof(RegisterValue));
+        CHECK_PTR(sch->registers);
+    }
+
+    RegisterValue *reg = &sch->registers[sch->register_count++];
+    reg->name = malloc(strlen(name) + 1);
+    CHECK_PTR(reg->name);
+    strcpy(reg->name, name);
+
+    Poly poly;
+    if (RegistersTake(&sch->real->registers, name, &poly)) {
+        reg->value = SchedulerNewValue(sch, poly, NO_TASK);
+    }
+    else {
+        reg->value = NO_VALUE;
+    }
+    return reg;
+}
+
+/**
+ * Adds a task for a command, without any inputs and outputs yet.
+ * @param sch : scheduler
+ * @param cmd : command
+ * @return index of the task
+ */
+static size_t SchedulerNewTask(Scheduler *sch, Command *cmd) {
+    size_t index = sch->task_count++;
+    sch->tasks[index] = (Task) {.cmd = *cmd, .first_input = sch->inputs.size,
+                                .fails = cmd->type == CMD_ERROR,
+                                .depth = sch->stack.size
+                                         + StackSize(&sch->real->stack)};
+    return index;
+}
+
+/**
+ * Adds an input of a task. The task has to be the last one.
+ * @param sch : scheduler
+ * @param index : index of the task
+ * @param id : value used by the task
+ * @param taken : does the task take the value over
+ */
+static void SchedulerUse(Scheduler *sch, size_t index, size_t id, bool taken) {
+    Value *value = &sch->values[id];
+
+    IndexArrayAdd(&sch->inputs, id);
+    sch->tasks[index].input_count++;
+    SchedulerDepend(sch, value->producer, index);
+    if (taken) {
+        for (size_t r = 0; r < value->readers.size; r++) {
+            SchedulerDepend(sch, value->readers.data[r], index);
+        }
+    }
+    else {
+        IndexArrayAdd(&value->readers, index);
+    }
+}
+
+/**
+ * Pushes the values produced by a task on the symbolic stack.
+ * @param sch : scheduler
+ * @param index : index of the task
+ * @param count : number of produced values
+ */
+static void SchedulerProduce(Scheduler *sch, size_t index, size_t count) {
+    sch->tasks[index].first_output = sch->value_count;
+    sch->tasks[index].output_count = count;
+    for (size_t i = 0; i < count; i++) {
+        IndexArrayAdd(&sch->stack, SchedulerNewValue(sch, PolyZero(), index));
+    }
+}
+
+/**
+ * Applies a register command to the symbolic registers. Storing only moves
+ * a value, loading clones it and dropping pops it, so that the registers
+ * don't stop the analysis of the window.
+ * @param sch : scheduler
+ * @param cmd : register command
+ */
+static void SchedulerAnalyzeRegister(Scheduler *sch, Command *cmd) {
+    size_t available = sch->stack.size + StackSize(&sch->real->stack);
+    if (cmd->type == CMD_STORE && available == 0) {
+        sch->tasks[SchedulerNewTask(sch, cmd)].fails = true;
+        return;
+    }
+
+    RegisterValue *reg = SchedulerRegister(sch, cmd->name);
+    if (cmd->type != CMD_STORE && reg->value == NO_VALUE) {
+        sch->tasks[SchedulerNewTask(sch, cmd)].fails = true;
+        return;
+    }
+
+    size_t id = reg->value;
+    CommandType type = cmd->type;
+    CommandDestroy(cmd);
+    if (type == CMD_STORE) {
+        SchedulerPull(sch, 1);
+        reg->value = sch->stack.data[--sch->stack.size];
+        if (id == NO_VALUE) {
+            return;
+        }
+        cmd->type = CMD_POP;            // destroys the replaced value
+    }
+    else if (type == CMD_LOAD) {
+        cmd->type = CMD_CLONE;
+    }
+    else {
+        cmd->type = CMD_POP;
+        reg->value = NO_VALUE;
+    }
+
+    size_t index = SchedulerNewTask(sch, cmd);
+    sch->tasks[index].depth = available;    // as before storing
+    SchedulerUse(sch, index, id, cmd->type == CMD_POP);
+    if (cmd->type == CMD_CLONE) {       // only the copy goes on the stack
+        SchedulerProduce(sch, index, 1);
+    }
+}
+
+/**
+ * Applies a command reordering the stack. Moving polynomials only permutes
+ * the symbolic stack, so it needs no task, and PICK becomes a CLONE task of
+ * the picked value.
+ * @param sch : scheduler
+ * @param cmd : SWAP, ROT, PICK or ROLL command
+ */
+static void SchedulerAnalyzeShuffle(Scheduler *sch, Command *cmd) {
+    StackEffect effect = CommandStackEffect(cmd);
+    if (sch->stack.size + StackSize(&sch->real->stack) < effect.need) {
+        sch->tasks[SchedulerNewTask(sch, cmd)].fails = true;
+        return;
+    }
+
+    SchedulerPull(sch, effect.need);
+    size_t *top = &sch->stack.data[sch->stack.size - 1];
+    size_t depth = effect.need - 1;
+    size_t id = *(top - depth);
+    if (cmd->type == CMD_PICK) {
+        cmd->type = CMD_CLONE;
+        size_t index = SchedulerNewTask(sch, cmd);
+        SchedulerUse(sch, index, id, false);
+        SchedulerProduce(sch, index, 1);
+    }
+    else {
+        memmove(top - depth, top - depth + 1, depth * sizeof(size_t));
+        *top = id;
+        CommandDestroy(cmd);
+    }
+}
+
+/**
+ * Computes the place of a command in the dataflow graph by applying its
+ * stack effect to the symbolic stack. Polynomial literals don't need a task,
+ * their values are ready right away.
+ * @param sch : scheduler
+ * @param cmd : command
+ */
+static void SchedulerAnalyze(Scheduler *sch, Command *cmd) {
+    if (cmd->type == CMD_POLY || cmd->type == CMD_ZERO) {
+        Poly poly = cmd->type == CMD_POLY ? cmd->poly : PolyZero();
+        IndexArrayAdd(&sch->stack, SchedulerNewValue(sch, poly, NO_TASK));
+        return;
+    }
+    if (cmd->type == CMD_STORE || cmd->type == CMD_LOAD
+        || cmd->type == CMD_DROP) {
+        SchedulerAnalyzeRegister(sch, cmd);
+        return;
+    }
+    if (cmd->type == CMD_SWAP || cmd->type == CMD_ROT
+        || cmd->type == CMD_PICK || cmd->type == CMD_ROLL) {
+        SchedulerAnalyzeShuffle(sch, cmd);
+        return;
+    }
+
+    size_t index = SchedulerNewTask(sch, cmd);
+    StackEffect effect = CommandStackEffect(cmd);
+    if (sch->stack.size + StackSize(&sch->real->stack) < effect.need) {
+        sch->tasks[index].fails = true;
+        return;
+    }
+    if (effect.whole) {     // uses all of the values, like in program order
+        effect.need = sch->stack.size + StackSize(&sch->real->stack);
+    }
+
+    SchedulerPull(sch, effect.need);
+    size_t base = sch->stack.size - effect.need;
+    for (size_t i = 0; i < effect.need; i++) {
+        SchedulerUse(sch, index, sch->stack.data[base + i],
+                     i >= effect.need - effect.pops);
+    }
+    sch->stack.size = base + effect.need - effect.pops;
+    SchedulerProduce(sch, index, effect.pushes);
+}
+
+/**
+ * Executes a task on a stack made of its inputs, printing to its buffers.
+ * Its registers are empty, since register commands that succeed are turned
+ * into stack commands.
+ * @param sch : scheduler
+ * @param task : task
+ */
+static void TaskRun(Scheduler *sch, Task *task) {
+    FILE *in = InputStream(), *out = NULL, *err = NULL;
+    FILE *old_out = OutputStream(), *old_err = ErrorStream();
+
+    if (CommandStackEffect(&task->cmd).prints && !task->fails) {
+        out = open_memstream(&task->out, &task->out_len);
+        CHECK_PTR(out);
+    }
+    if (task->fails) {
+        err = open_memstream(&task->err, &task->err_len);
+        CHECK_PTR(err);
+    }
+    SetStreams(in, out, err);
+
+    CalcState state;
+    CalcStateInit(&state);
+    state.below = task->depth > task->input_count
+                  ? task->depth - task->input_count : 0;
+    for (size_t i = 0; i < task->input_count; i++) {
+        Push(&state.stack,
+             sch->values[sch->inputs.data[task->first_input + i]].poly);
+    }
+
+    CommandExecute(&state, &task->cmd);
+
+    for (size_t i = task->output_count; i > 0; i--) {
+        sch->values[task->first_output + i - 1].poly = Pop(&state.stack);
+    }
+    while (!StackIsEmpty(&state.stack)) {   // inputs that were only read
+        Pop(&state.stack);
+    }
+    CalcStateDestroy(&state);
+
+    SetStreams(in, old_out, old_err);
+    if (out != NULL) {
+        fclose(out);
+    }
+    if (err != NULL) {
+        fclose(err);
+    }
+}
+
+/**
+ * Takes a ready task, runs it and marks its successors.
+ * Requires the lock and at least one ready task.
+ * @param sch : scheduler
+ */
+static void SchedulerStep(Scheduler *sch) {
+    size_t index = sch->ready.data[--sch->ready.size];
+    Task *task = &sch->tasks[index];
+
+    pthread_mutex_unlock(&sch->lock);
+    TaskRun(sch, task);
+    pthread_mutex_lock(&sch->lock);
+
+    for (size_t i = 0; i < task->successors.size; i++) {
+        Task *successor = &sch->tasks[task->successors.data[i]];
+        if (--successor->remaining == 0) {
+            IndexArrayAdd(&sch->ready, task->successors.data[i]);
+        }
+    }
+    sch->finished++;
+    pthread_cond_broadcast(&sch->changed);
+}
+
+/**
+ * Worker thread. Runs ready tasks until the scheduler stops.
+ * @param arg : scheduler
+ * @return NULL
+ */
+static void *SchedulerWorker(void *arg) {
+    Scheduler *sch = arg;
+
+    pthread_mutex_lock(&sch->lock);
+    for (;;) {
+        while (!sch->stop && sch->ready.size == 0) {
+            pthread_cond_wait(&sch->changed, &sch->lock);
+        }
+        if (sch->stop) {
+            break;
+        }
+        SchedulerStep(sch);
+    }
+    pthread_mutex_unlock(&sch->lock);
+    return NULL;
+}
+
+/**
+ * Executes all of the tasks of the window. The calling thread helps
+ * the workers, or runs the tasks alone in program order if they are too
+ * small to pay for waking the workers.
+ * @param sch : scheduler
+ */
+static void SchedulerExecute(Scheduler *sch) {
+    if (sch->terms < sch->parallel_terms * sch->task_count) {
+        for (size_t i = 0; i < sch->task_count; i++) {
+            TaskRun(sch, &sch->tasks[i]);   // tasks depend only on earlier ones
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&sch->lock);
+    sch->finished = 0;
+    for (size_t i = sch->task_count; i > 0; i--) {
+        if (sch->tasks[i - 1].remaining == 0) {
+            IndexArrayAdd(&sch->ready, i - 1);
+        }
+    }
+    pthread_cond_broadcast(&sch->changed);
+
+    while (sch->finished < sch->task_count) {
+        if (sch->ready.size > 0) {
+            SchedulerStep(sch);
+        }
+        else {
+            pthread_cond_wait(&sch->changed, &sch->lock);
+        }
+    }
+    pthread_mutex_unlock(&sch->lock);
+}
+
+/**
+ * Writes the buffers of the tasks in program order, moves values left on
+ * the symbolic stack and in the symbolic registers to the real state
+ * and clears the window.
+ * @param sch : scheduler
+ */
+static void SchedulerFinishWindow(Scheduler *sch) {
+    for (size_t i = 0; i < sch->task_count; i++) {
+        Task *task = &sch->tasks[i];
+
+        if (task->out != NULL) {
+            fwrite(task->out, 1, task->out_len, sch->out);
+            free(task->out);
+        }
+        if (task->err != NULL) {
+            fwrite(task->err, 1, task->err_len, sch->err);
+            free(task->err);
+        }
+        CommandDestroy(&task->cmd);
+        IndexArrayFree(&task->successors);
+    }
+
+    for (size_t i = 0; i < sch->stack.size; i++) {
+        Push(&sch->real->stack, sch->values[sch->stack.data[i]].poly);
+    }
+    for (size_t i = 0; i < sch->register_count; i++) {
+        RegisterValue *reg = &sch->registers[i];
+        if (reg->value != NO_VALUE) {
+            RegistersStore(&sch->real->registers, reg->name,
+                           sch->values[reg->value].poly);
+        }
+        free(reg->name);
+    }
+    for (size_t i = 0; i < sch->value_count; i++) {
+        IndexArrayFree(&sch->values[i].readers);
+    }
+
+    sch->task_count = 0;
+    sch->value_count = 0;
+    sch->inputs.size = 0;
+    sch->stack.size = 0;
+    sch->register_count = 0;
+    sch->terms = 0;
+}
+
+void SchedulerRun(size_t threads, size_t parallel_terms) {
+    CalcState state;
+    CalcStateInit(&state);
+
+    Scheduler sch = {.stop = false, .real = &state,
+                     .parallel_terms = parallel_terms,
+                     .out = OutputStream(), .err = ErrorStream()};
+    pthread_mutex_init(&sch.lock, NULL);
+    pthread_cond_init(&sch.changed, NULL);
+    sch.tasks = malloc(SCHEDULER_WINDOW * sizeof(Task));
+    CHECK_PTR(sch.tasks);
+
+    pthread_t *workers = malloc((threads - 1) * sizeof(pthread_t));
+    CHECK_PTR(workers);
+    size_t started = 0;
+    while (started < threads - 1 &&
+           pthread_create(&workers[started], NULL, SchedulerWorker, &sch) == 0) {
+        started++;
+    }
+
+    Reader reader;
+    ReaderInit(&reader);
+    Command cmd;
+    bool more = true;
+    while (more) {
+        while (sch.task_count < SCHEDULER_WINDOW
+               && (more = ReaderNext(&reader, &cmd))) {
+            SchedulerAnalyze(&sch, &cmd);
+        }
+        SchedulerExecute(&sch);
+        SchedulerFinishWindow(&sch);
+    }
+
+    pthread_mutex_lock(&sch.lock);
+    sch.stop = true;
+    pthread_cond_broadcast(&sch.changed);
+    pthread_mutex_unlock(&sch.lock);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    free(workers);
+    ReaderDestroy(&reader);
+    free(sch.tasks);
+    free(sch.values);
+    IndexArrayFree(&sch.ready);
+    IndexArrayFree(&sch.inputs);
+    IndexArrayFree(&sch.stack);
+    free(sch.registers);
+    pthread_cond_destroy(&sch.changed);
+    pthread_mutex_destroy(&sch.lock);
+    CalcStateDestroy(&state);
+}
@@ -0,0 +1,40 @@
+/** @file
+  Interface of the concurrent executor of calculator commands.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stddef.h>
+
+/// Default lowest mean number of terms of the polynomials which a window
+/// brings onto the stack per command, for which the window is executed
+/// concurrently. Smaller windows are executed by the reading thread alone,
+/// as waking the workers costs more than the commands. The crossovers
+/// measured by poly_scaling tell the best value for a machine.
+#define SCHEDULER_PARALLEL_TERMS 32
+
+/**
+ * @brief Runs the calculator on the input stream, executing independent
+ * commands concurrently.
+ * @details Commands are read in windows. For every window the stack effect
+ * of each command is used to build a dataflow graph over the polynomials
+ * on the stack - a command depends on the commands producing the polynomials
+ * it uses, and a command taking a polynomial over depends on the commands
+ * that only read it. Commands are then executed on @p threads threads as soon
+ * as their dependencies are done. Every command prints to its own buffer,
+ * and the buffers are written in program order when the window is done, so
+ * the output is the same as in sequential execution. Windows whose
+ * polynomials have on average fewer than @p parallel_terms terms per
+ * command are executed in program order by the calling thread.
+ * @param threads : number of threads, including the calling one
+ * @param parallel_terms : lowest mean number of terms per command of
+ * a window which is executed concurrently, 0 to execute all of them so
+ */
+void SchedulerRun(size_t threads, size_t parallel_terms);
+
+#endif //SCHEDULER_H
@@ -0,0 +1,502 @@
+/** @file
+  Implementation of statistics of the shape of polynomials.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+#include "shape.h"
+
+/// When increasing an array's size, this is the multiplier.
+#define SIZE_EXPAND_CONST 2
+
+/// Starting value of hashes of subpolynomials.
+#define HASH_SEED 0x9e3779b97f4a7c15u
+
+/// Value at which bounds of sizes saturate, far above any possible size.
+#define BOUND_CAP 1e30
+
+/**
+ * State of a walk over a polynomial.
+ */
+typedef struct ShapeWalk {
+    PolyShape *shape;       ///< computed shape
+    size_t reserved;        ///< amount of reserved space for levels
+    uint64_t *hashes;       ///< hashes of non-constant subpolynomials
+    size_t hash_count;      ///< number of hashes
+} ShapeWalk;
+
+/**
+ * Mixes bits of a value (the finalizer of SplitMix64).
+ * @param x : value
+ * @return mixed value
+ */
+static uint64_t ShapeMix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9u;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebu;
+    return x ^ (x >> 31);
+}
+
+/**
+ * Computes a histogram bucket of a size.
+ * @param size : size, greater than 0
+ * @return index of the bucket
+ */
+static size_t ShapeBucket(size_t size) {
+    size_t bucket = 0;
+    while (size > 1 && bucket + 1 < SHAPE_FANOUT_BUCKETS) {
+        size >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/**
+ * Counts the bits of the absolute value of a coefficient.
+ * @param c : coefficient
+ * @return number of bits
+ */
+static size_t ShapeBits(poly_coeff_t c) {
+    uint64_t value = c < 0 ? -(uint64_t) c : (uint64_t) c;
+    size_t bits = 0;
+    while (value > 0) {
+        value >>= 1;
+        bits++;
+    }
+    return bits;
+}
+
+/**
+ * Adds a level if it is new. Levels are visited in order, so it is
+ * at most one more than the existing ones.
+ * @param walk : state of the walk
+ * @param level : index of the level
+ */
+static void ShapeLevel(ShapeWalk *walk, size_t level) {
+    PolyShape *shape = walk->shape;
+
+    if (level == shape->depth) {
+        if (shape->depth == walk->reserved) {
+            walk->reserved = walk->reserved * SIZE_EXPAND_CONST + 1;
+            shape->levels = MemRealloc(shape->levels,
+                                       walk->reserved * sizeof(LevelShape));
+        }
+        memset(&shape->levels[shape->depth], 0, sizeof(LevelShape));
+        shape->depth++;
+    }
+}
+
+/**
+ * Adds a polynomial and its subpolynomials to the shape.
+ * @param walk : state of the walk
+ * @param p : polynomial
+ * @param level : its level
+ * @return hash of the polynomial
+ */
+static uint64_t ShapeVisit(ShapeWalk *walk, const Poly *p, size_t level) {
+    if (PolyIsCoeff(p)) {
+        if (!PolyIsZero(p)) {
+            walk->shape->leaves++;
+            walk->shape->coeff_bits[ShapeBits(p->coeff)]++;
+        }
+        return ShapeMix((uint64_t) p->coeff);
+    }
+
+    ShapeLevel(walk, level);    // deeper levels come after it
+    uint64_t hash = HASH_SEED;
+    for (size_t i = 0; i < p->size; i++) {
+        hash = ShapeMix(hash ^ (uint64_t) p->arr[i].exp);
+        hash = ShapeMix(hash ^ ShapeVisit(walk, &p->arr[i].p, level + 1));
+    }
+
+    LevelShape *shape = &walk->shape->levels[level];
+    poly_exp_t max_exp = p->arr[p->size - 1].exp;
+    shape->polys++;
+    shape->monos += p->size;
+    shape->fanouts[ShapeBucket(p->size)]++;
+    shape->exp_span += (size_t) max_exp + 1;
+    if (max_exp > shape->max_exp) {
+        shape->max_exp = max_exp;
+    }
+
+    walk->hashes[walk->hash_count++] = hash;
+    return hash;
+}
+
+/**
+ * Compares hashes for qsort.
+ * @param a : first hash
+ * @param b : second hash
+ * @return result of the comparison
+ */
+static int ShapeCompare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+PolyShape ShapeOf(const Poly *p) {
+    PolyShape shape;
+    memset(&shape, 0, sizeof(shape));
+
+    size_t nodes = PolyNodeCount(p);
+    ShapeWalk walk = {.shape = &shape, .reserved = 0, .hash_count = 0,
+                      .hashes = MemAlloc((nodes + 1) * sizeof(uint64_t))};
+    ShapeVisit(&walk, p, 0);
+
+    shape.subtrees = walk.hash_count;
+    qsort(walk.hashes, walk.hash_count, sizeof(uint64_t), ShapeCompare);
+    for (size_t i = 0; i < walk.hash_count; i++) {
+        if (i == 0 || walk.hashes[i] != walk.hashes[i - 1]) {
+            shape.distinct++;
+        }
+    }
+    MemFree(walk.hashes);
+    return shape;
+}
+
+size_t ShapeDepth(const Poly *p) {
+    if (PolyIsCoeff(p)) {
+        return 0;
+    }
+
+    size_t depth = 0;
+    for (size_t i = 0; i < p->size; i++) {
+        size_t sub = ShapeDepth(&p->arr[i].p);
+        if (sub > depth) {
+            depth = sub;
+        }
+    }
+    return depth + 1;
+}
+
+/**
+ * Multiplies two bounds, saturating at #BOUND_CAP.
+ * @param a : first bound
+ * @param b : second bound
+ * @return product
+ */
+static double BoundMul(double a, double b) {
+    double product = a * b;
+    return product < BOUND_CAP ? product : BOUND_CAP;
+}
+
+/**
+ * Adds two bounds, saturating at #BOUND_CAP.
+ * @param a : first bound
+ * @param b : second bound
+ * @return sum
+ */
+static double BoundAdd(double a, double b) {
+    double sum = a + b;
+    return sum < BOUND_CAP ? sum : BOUND_CAP;
+}
+
+/**
+ * Finds the highest exponents of variables of a polynomial.
+ * @param[in] p : polynomial
+ * @param level : index of the variable of @p p
+ * @param degs : highest exponents, updated from @p level on
+ */
+static void ShapeDegrees(const Poly *p, size_t level, poly_exp_t *degs) {
+    if (PolyIsCoeff(p)) {
+        return;
+    }
+
+    for (size_t i = 0; i < p->size; i++) {
+        if (p->arr[i].exp > degs[level]) {
+            degs[level] = p->arr[i].exp;
+        }
+        ShapeDegrees(&p->arr[i].p, level + 1, degs);
+    }
+}
+
+/**
+ * Computes the highest exponents of variables of a polynomial.
+ * @param[in] p : polynomial
+ * @param[out] depth : depth of @p p
+ * @return highest exponents of its variables, which have to be freed
+ */
+static poly_exp_t *ShapeDegreesOf(const Poly *p, size_t *depth) {
+    *depth = ShapeDepth(p);
+    poly_exp_t *degs = MemAlloc((*depth + 1) * sizeof(poly_exp_t));
+    memset(degs, 0, (*depth + 1) * sizeof(poly_exp_t));
+    ShapeDegrees(p, 0, degs);
+    return degs;
+}
+
+/**
+ * Makes a bound of the size of a result from a bound of its terms.
+ * @param terms : bound of the terms
+ * @param depth : bound of the depth
+ * @return bound of the size
+ */
+static SizeBound ShapeBound(double terms, size_t depth) {
+    // every term takes at most one monomial on each level
+    return (SizeBound) {
+        .terms = terms,
+        .bytes = BoundMul(BoundMul(terms, (double) depth),
+                          (double) sizeof(Mono))
+    };
+}
+
+SizeBound ShapeProductBound(size_t count, const Poly polys[]) {
+    double terms = 1;
+    size_t max_depth = 0;
+    double *sums = NULL;
+
+    for (size_t i = 0; i < count; i++) {
+        terms = BoundMul(terms, (double) PolyTermCount(&polys[i]));
+
+        size_t depth;
+        poly_exp_t *degs = ShapeDegreesOf(&polys[i], &depth);
+        if (depth > max_depth) {
+            sums = MemRealloc(sums, depth * sizeof(double));
+            for (size_t v = max_depth; v < depth; v++) {
+                sums[v] = 0;
+            }
+            max_depth = depth;
+        }
+        for (size_t v = 0; v < depth; v++) {
+            sums[v] = BoundAdd(sums[v], (double) degs[v]);
+        }
+        MemFree(degs);
+    }
+
+    double vectors = 1;
+    for (size_t v = 0; v < max_depth; v++) {
+        vectors = BoundMul(vectors, sums[v] + 1);
+    }
+    MemFree(sums);
+    return ShapeBound(terms < vectors ? terms : vectors, max_depth);
+}
+
+/**
+ * Bounds the terms of a product of polynomials and estimates the products
+ * of terms computed by #PolyProductMany in its balanced tree.
+ * @param[in] count : number of factors, at least 1
+ * @param[in] polys : factors
+ * @param work : estimate, increased by the one of this product
+ * @return bound of the terms of the product
+ */
+static double ShapeProductTree(size_t count, const Poly polys[],
+                               double *work) {
+    if (count == 1) {
+        return (double) PolyTermCount(&polys[0]);
+    }
+
+    size_t half = count / 2;
+    double left = ShapeProductTree(half, polys, work);
+    double right = ShapeProductTree(count - half, &polys[half], work);
+    *work = BoundAdd(*work, BoundMul(left, right));
+    return ShapeProductBound(count, polys).terms;
+}
+
+double ShapeProductWork(size_t count, const Poly polys[]) {
+    double work = 0;
+
+    if (count > 0) {
+        ShapeProductTree(count, polys, &work);
+    }
+    return work;
+}
+
+/**
+ * Polynomial substituted in a composition together with its metadata.
+ */
+typedef struct ComposeOperand {
+    double terms;           ///< number of its terms
+    size_t depth;           ///< its depth
+    poly_exp_t *degs;       ///< highest exponents of its variables
+} ComposeOperand;
+
+/**
+ * Bounds the terms of a power of a polynomial.
+ * @param[in] q : polynomial
+ * @param exp : exponent
+ * @return bound of the terms of @f$q^{exp}@f$
+ */
+static double ShapePowerBound(const ComposeOperand *q, poly_exp_t exp) {
+    if (exp == 0 || q->depth == 0) {
+        return q->terms > 0 || exp == 0 ? 1 : 0;
+    }
+
+    // multisets of exp terms: binomial(n - 1 + exp, min(exp, n - 1))
+    double n = q->terms, e = (double) exp;
+    double r = e < n - 1 ? e : n - 1;
+    double multisets = 1;
+    for (double j = 1; j <= r && multisets < BOUND_CAP; j++) {
+        multisets = BoundMul(multisets, (n - 1 + e - r + j) / j);
+    }
+
+    double vectors = 1;
+    for (size_t v = 0; v < q->depth; v++) {
+        vectors = BoundMul(vectors, BoundMul(e, (double) q->degs[v]) + 1);
+    }
+    return multisets < vectors ? multisets : vectors;
+}
+
+/**
+ * Estimates the products of terms computed by #PolyPower, which squares
+ * the base and halves the exponent until it is 1, multiplying by the base
+ * for odd exponents.
+ * @param[in] q : base
+ * @param exp : exponent
+ * @return estimate of the products of terms
+ */
+static double ShapePowerWork(const ComposeOperand *q, poly_exp_t exp) {
+    double work = 0;
+
+    for (poly_exp_t base = 1; exp > 1; base *= 2, exp /= 2) {
+        double square = ShapePowerBound(q, base);
+        work = BoundAdd(work, BoundMul(square, square));
+        if (exp & 1) {
+            work = BoundAdd(work, BoundMul(square, ShapePowerBound(
+                q, base * (exp - 1))));
+        }
+    }
+    return work;
+}
+
+/**
+ * Bounds the terms of a composition of a polynomial, the way
+ * #PolyCompose computes it.
+ * @param[in] p : polynomial to compose
+ * @param level : index of the variable of @p p
+ * @param k : number of polynomials substituted
+ * @param[in] q : polynomials substituted
+ * @param work : estimate of the products of terms, increased by the ones
+ * of this composition, or NULL if it is not needed
+ * @return bound of the terms
+ */
+static double ShapeComposeTerms(const Poly *p, size_t level, size_t k,
+                                const ComposeOperand *q, double *work) {
+    if (PolyIsCoeff(p)) {
+        return PolyIsZero(p) ? 0 : 1;
+    }
+
+    double sum = 0;
+    for (size_t i = 0; i < p->size; i++) {
+        poly_exp_t exp = p->arr[i].exp;
+        double terms = ShapeComposeTerms(&p->arr[i].p, level + 1, k, q, work);
+        if (exp == 0) {
+            sum = BoundAdd(sum, terms);
+        }
+        else if (level < k) {
+            double power = ShapePowerBound(&q[level], exp);
+            sum = BoundAdd(sum, BoundMul(terms, power));
+            if (work != NULL) {
+                *work = BoundAdd(BoundAdd(*work, BoundMul(terms, power)),
+                                 ShapePowerWork(&q[level], exp));
+            }
+        }
+    }
+    return sum;
+}
+
+/**
+ * Bounds the size of a composition and estimates the work of computing it.
+ * @param[in] p : polynomial to compose
+ * @param[in] k : number of polynomials substituted
+ * @param[in] q : polynomials substituted
+ * @param work : place for the estimate of the products of terms, or NULL
+ * if it is not needed
+ * @return bound of the size of the composition
+ */
+static SizeBound ShapeCompose(const Poly *p, size_t k, const Poly q[],
+                              double *work) {
+    size_t p_depth;
+    poly_exp_t *p_degs = ShapeDegreesOf(p, &p_depth);
+    size_t used = p_depth < k ? p_depth : k;
+    ComposeOperand *operands = MemAlloc((used + 1) * sizeof(ComposeOperand));
+
+    size_t max_depth = 0;
+    for (size_t i = 0; i < used; i++) {
+        operands[i].terms = (double) PolyTermCount(&q[i]);
+        operands[i].degs = ShapeDegreesOf(&q[i], &operands[i].depth);
+        if (p_degs[i] > 0 && operands[i].depth > max_depth) {
+            max_depth = operands[i].depth;
+        }
+    }
+
+    double terms = ShapeComposeTerms(p, 0, used, operands, work);
+
+    // the degree by a variable is at most the sum of the ones of powers
+    double vectors = 1;
+    for (size_t v = 0; v < max_depth; v++) {
+        double deg = 0;
+        for (size_t i = 0; i < used; i++) {
+            if (v < operands[i].depth) {
+                deg = BoundAdd(deg, BoundMul((double) p_degs[i],
+                                             (double) operands[i].degs[v]));
+            }
+        }
+        vectors = BoundMul(vectors, deg + 1);
+    }
+
+    for (size_t i = 0; i < used; i++) {
+        MemFree(operands[i].degs);
+    }
+    MemFree(operands);
+    MemFree(p_degs);
+    return ShapeBound(terms < vectors ? terms : vectors, max_depth);
+}
+
+SizeBound ShapeComposeBound(const Poly *p, size_t k, const Poly q[]) {
+    return ShapeCompose(p, k, q, NULL);
+}
+
+double ShapeComposeWork(const Poly *p, size_t k, const Poly q[]) {
+    double work = 0;
+    ShapeCompose(p, k, q, &work);
+    return work;
+}
+
+/**
+ * Writes a histogram without its trailing empty buckets.
+ * @param file : file to write to
+ * @param histogram : buckets
+ * @param size : number of buckets
+ */
+static void ShapeWriteHistogram(FILE *file, const size_t *histogram,
+                                size_t size) {
+    while (size > 0 && histogram[size - 1] == 0) {
+        size--;
+    }
+
+    fprintf(file, "[");
+    for (size_t i = 0; i < size; i++) {
+        fprintf(file, "%s%zu", i > 0 ? ", " : "", histogram[i]);
+    }
+    fprintf(file, "]");
+}
+
+void ShapeWrite(const PolyShape *shape, FILE *file) {
+    fprintf(file, "{\"depth\": %zu, \"leaves\": %zu, \"subtrees\": %zu, "
+            "\"distinct_subtrees\": %zu, \"coeff_bits\": ", shape->depth,
+            shape->leaves, shape->subtrees, shape->distinct);
+    ShapeWriteHistogram(file, shape->coeff_bits, SHAPE_BIT_BUCKETS);
+
+    fprintf(file, ", \"levels\": [");
+    for (size_t i = 0; i < shape->depth; i++) {
+        const LevelShape *level = &shape->levels[i];
+
+        fprintf(file, "%s{\"polys\": %zu, \"monos\": %zu, \"max_exp\": %d, "
+                "\"density\": %.4g, \"fanouts\": ", i > 0 ? ", " : "",
+                level->polys, level->monos, level->max_exp,
+                (double) level->monos / (double) level->exp_span);
+        ShapeWriteHistogram(file, level->fanouts, SHAPE_FANOUT_BUCKETS);
+        fprintf(file, "}");
+    }
+    fprintf(file, "]}\n");
+}
+
+void ShapeDestroy(PolyShape *shape) {
+    MemFree(shape->levels);
+    shape->levels = NULL;
+    shape->depth = 0;
+}
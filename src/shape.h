@@ -0,0 +1,139 @@
+/** @file
+  Interface of statistics of the shape of polynomials.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef SHAPE_H
+#define SHAPE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "poly.h"
+
+/// Number of buckets of histograms of fanouts. Bucket @f$i@f$ counts
+/// polynomials with @f$2^i@f$ to @f$2^{i+1} - 1@f$ monomials.
+#define SHAPE_FANOUT_BUCKETS 32
+
+/// Number of buckets of the histogram of coefficients. Bucket @f$i@f$
+/// counts coefficients whose absolute value has @f$i@f$ bits.
+#define SHAPE_BIT_BUCKETS 65
+
+/**
+ * Shape of a single level of polynomials, that is of polynomials of
+ * the same variable.
+ */
+typedef struct LevelShape {
+    size_t polys;           ///< non-constant polynomials of the level
+    size_t monos;           ///< their monomials
+    size_t fanouts[SHAPE_FANOUT_BUCKETS];   ///< histogram of their sizes
+    poly_exp_t max_exp;     ///< highest exponent
+    size_t exp_span;        ///< sum of the highest exponents plus 1
+} LevelShape;
+
+/**
+ * @brief Shape of a polynomial.
+ * @details Monomials per exponent span (exponent density) tell whether
+ * dense algorithms pay off, the depth and fanouts whether a recursive
+ * or a distributed representation fits and the numbers of all and of
+ * distinct non-constant subpolynomials how much could be saved by sharing
+ * equal subtrees.
+ */
+typedef struct PolyShape {
+    size_t depth;           ///< number of levels with monomials
+    LevelShape *levels;     ///< levels, starting with @f$x_0@f$
+    size_t leaves;          ///< nonzero constant coefficients
+    size_t coeff_bits[SHAPE_BIT_BUCKETS];   ///< histogram of coefficients
+    size_t subtrees;        ///< non-constant subpolynomials, with the root
+    size_t distinct;        ///< pairwise different ones among them
+} PolyShape;
+
+/**
+ * Computes the shape of a polynomial. Different subpolynomials are told
+ * apart by 64-bit hashes, so in theory two of them could be counted as one.
+ * @param[in] p : polynomial
+ * @return shape, which has to be freed with #ShapeDestroy
+ */
+PolyShape ShapeOf(const Poly *p);
+
+/**
+ * Computes the depth of a polynomial, that is the number of levels of its
+ * representation which contain monomials, without computing the rest of
+ * its shape.
+ * @param[in] p : polynomial
+ * @return depth, 0 for constant polynomials
+ */
+size_t ShapeDepth(const Poly *p);
+
+/**
+ * @brief Upper bound of the size of a result of an operation.
+ * @details Bounds are computed with saturating floating point arithmetic,
+ * so they never overflow and can be compared with any limit.
+ */
+typedef struct SizeBound {
+    double terms;           ///< terms of the result
+    double bytes;           ///< heap memory taken by the result
+} SizeBound;
+
+/**
+ * @brief Bounds the size of a product of polynomials.
+ * @details The number of terms is at most the product of numbers of terms
+ * of the factors and at most the number of exponent vectors with every
+ * exponent up to the sum of the highest exponents of its variable in the
+ * factors. Takes time linear in the size of the factors.
+ * @param[in] count : number of factors
+ * @param[in] polys : factors
+ * @return bound of the size of the product
+ */
+SizeBound ShapeProductBound(size_t count, const Poly polys[]);
+
+/**
+ * Estimates the work of #PolyProductMany as the number of products of
+ * constant terms it computes, which is exact for two factors.
+ * @param[in] count : number of factors
+ * @param[in] polys : factors
+ * @return estimate of the products of terms
+ */
+double ShapeProductWork(size_t count, const Poly polys[]);
+
+/**
+ * @brief Bounds the size of a composition, as computed by #PolyCompose.
+ * @details A term of @p p with exponents @f$e_i@f$ gives at most
+ * @f$\binom{n_i + e_i - 1}{e_i}@f$ terms for each @f$q_i^{e_i}@f$ with
+ * @f$n_i@f$ terms, which is also bounded by the exponent vectors the power
+ * can have. The sum of that over terms of @p p is bounded by the exponent
+ * vectors the whole result can have. Takes time linear in the size of
+ * the polynomials.
+ * @param[in] p : polynomial to compose
+ * @param[in] k : number of polynomials substituted
+ * @param[in] q : polynomials substituted for variables
+ * @return bound of the size of the composition
+ */
+SizeBound ShapeComposeBound(const Poly *p, size_t k, const Poly q[]);
+
+/**
+ * Estimates the work of #PolyCompose as the number of products of constant
+ * terms it computes, from the same bounds as #ShapeComposeBound.
+ * @param[in] p : polynomial to compose
+ * @param[in] k : number of polynomials substituted
+ * @param[in] q : polynomials substituted
+ * @return estimate of the products of terms
+ */
+double ShapeComposeWork(const Poly *p, size_t k, const Poly q[]);
+
+/**
+ * Writes a shape as a single line of JSON.
+ * @param[in] shape : shape
+ * @param file : file to write to
+ */
+void ShapeWrite(const PolyShape *shape, FILE *file);
+
+/**
+ * Frees a shape.
+ * @param shape : shape
+ */
+void ShapeDestroy(PolyShape *shape);
+
+#endif //SHAPE_H
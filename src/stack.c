@@ -6,6 +6,7 @@
   @date 2021
 */
 
+#include <string.h>
 #include "stack.h"
 #include "input_output.h"
 
@@ -60,6 +61,17 @@ Poly Pop(Tstack *s) {
     return to_return;
 }
 
+Poly *StackPeek(Tstack *s, size_t depth) {
+    return &s->elements[s->size - 1 - depth];
+}
+
+void StackRoll(Tstack *s, size_t depth) {
+    Poly rolled = s->elements[s->size - 1 - depth];
+    memmove(&s->elements[s->size - 1 - depth], &s->elements[s->size - depth],
+            depth * sizeof(Poly));
+    s->elements[s->size - 1] = rolled;
+}
+
 bool StackDoesHaveAtLeastTwoElements(Tstack *s) {
     return s->size >= 2;
 }
@@ -49,6 +49,24 @@ void Push(Tstack *s, Poly poly_to_push);
  */
 Poly Pop(Tstack *s);
 
+/**
+ * Returns a polynomial which is @p depth places below the top of the stack
+ * without taking it off. The pointer is valid until the stack changes.
+ * @param s : stack
+ * @param depth : depth of the polynomial, 0 is the top
+ * @return pointer to the polynomial
+ */
+Poly *StackPeek(Tstack *s, size_t depth);
+
+/**
+ * Moves a polynomial which is @p depth places below the top of the stack
+ * to the top. Polynomials above it go one place down. Only the handles are
+ * moved, the contents of the polynomials are not touched.
+ * @param s : stack
+ * @param depth : depth of the polynomial, 0 is the top
+ */
+void StackRoll(Tstack *s, size_t depth);
+
 /**
  * Checks if the stack has at least 2 polynomials.
  * @param s : stos
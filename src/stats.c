@@ -0,0 +1,389 @@
+/** @file
+  Implementation of the calculator's instrumentation.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef _POSIX_C_SOURCE
+/// Directive necessary for clock_gettime to work.
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <inttypes.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "alloc.h"
+#include "stats.h"
+
+/// Number of nanoseconds in a second.
+#define NS_PER_SECOND 1000000000u
+
+/// Number of decimal digits of the biggest 64-bit number.
+#define MAX_DIGITS 20
+
+/// Base of printed numbers.
+#define DECIMAL_BASE 10
+
+/// Size of the buffer of the execution trace.
+#define TRACE_BUFFER_SIZE (1 << 20)
+
+/// Header of the execution trace.
+#define TRACE_HEADER "line,command,wall_ns,cpu_ns,in_terms,in_depth," \
+                     "out_terms,bytes_allocated,bytes_freed\n"
+
+/**
+ * Data recorded for a single type of commands.
+ */
+typedef struct StatsEntry {
+    atomic_uint_least64_t count;        ///< number of executed commands
+    atomic_uint_least64_t total_ns;     ///< total time of the execution
+    atomic_uint_least64_t max_ns;       ///< longest execution
+    atomic_uint_least64_t terms_in;     ///< terms read from the stack
+    atomic_uint_least64_t terms_out;    ///< terms left on the stack
+    atomic_uint_least64_t allocs;       ///< allocations and reallocations
+    atomic_uint_least64_t peak_bytes;   ///< highest number of live bytes
+    atomic_uint_least64_t profiled;     ///< commands with hardware counters
+    atomic_uint_least64_t cycles;       ///< CPU cycles
+    atomic_uint_least64_t instructions; ///< retired instructions
+    atomic_uint_least64_t cache_misses; ///< last level cache misses
+    atomic_uint_least64_t branch_misses;    ///< mispredicted branches
+    atomic_uint_least64_t histogram[STATS_BUCKETS]; ///< latency histogram
+} StatsEntry;
+
+/// Is the instrumentation turned on.
+static bool enabled = false;
+
+/// Recorded data, indexed by types of commands.
+static StatsEntry entries[CMD_TYPE_COUNT];
+
+/// Time of reading and parsing lines in nanoseconds.
+static atomic_uint_least64_t read_ns = 0;
+
+/// Number of read lines.
+static atomic_uint_least64_t read_lines = 0;
+
+/// Number of read bytes.
+static atomic_uint_least64_t read_bytes = 0;
+
+/// File of the execution trace or NULL.
+static FILE *trace = NULL;
+
+/// Type of the last started command.
+static atomic_int current_type = CMD_NONE;
+
+/// Line of the last started command.
+static atomic_size_t current_line = 0;
+
+/// Size of the stack of the last started command.
+static atomic_size_t current_depth = 0;
+
+void StatsEnable(void) {
+    enabled = true;
+    MemEnableCounting();
+}
+
+bool StatsEnabled(void) {
+    return enabled;
+}
+
+bool StatsTraceOpen(const char *path) {
+    trace = fopen(path, "w");
+    if (trace == NULL) {
+        return false;
+    }
+
+    setvbuf(trace, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+    fputs(TRACE_HEADER, trace);
+    StatsEnable();
+    return true;
+}
+
+bool StatsTracing(void) {
+    return trace != NULL;
+}
+
+void StatsTraceClose(void) {
+    if (trace != NULL) {
+        fclose(trace);
+        trace = NULL;
+    }
+}
+
+/**
+ * Reads a clock.
+ * @param clock : clock
+ * @return time in nanoseconds
+ */
+static uint64_t StatsClock(clockid_t clock) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return (uint64_t) now.tv_sec * NS_PER_SECOND + (uint64_t) now.tv_nsec;
+}
+
+uint64_t StatsNow(void) {
+    return StatsClock(CLOCK_MONOTONIC);
+}
+
+uint64_t StatsCpuNow(void) {
+    return StatsClock(CLOCK_THREAD_CPUTIME_ID);
+}
+
+void StatsBegin(CommandType type, size_t line_number, size_t depth) {
+    MemNextCommand();
+    atomic_store_explicit(&current_type, type, memory_order_relaxed);
+    atomic_store_explicit(&current_line, line_number, memory_order_relaxed);
+    atomic_store_explicit(&current_depth, depth, memory_order_relaxed);
+}
+
+/**
+ * Appends text to a snapshot, cutting it if there is no space left.
+ * @param buffer : buffer of #STATS_SNAPSHOT_SIZE bytes
+ * @param used : length of the snapshot so far
+ * @param text : text to append
+ */
+static void StatsAppend(char *buffer, size_t *used, const char *text) {
+    size_t len = strlen(text);
+
+    if (len > STATS_SNAPSHOT_SIZE - 1 - *used) {
+        len = STATS_SNAPSHOT_SIZE - 1 - *used;
+    }
+    memcpy(buffer + *used, text, len);
+    *used += len;
+    buffer[*used] = '\0';
+}
+
+/**
+ * Appends a named number to a snapshot, without using stdio.
+ * @param buffer : buffer of #STATS_SNAPSHOT_SIZE bytes
+ * @param used : length of the snapshot so far
+ * @param name : JSON key preceded by a separator
+ * @param value : number
+ */
+static void StatsAppendNumber(char *buffer, size_t *used, const char *name,
+                              uint64_t value) {
+    char digits[MAX_DIGITS + 1];
+    size_t begin = MAX_DIGITS;
+
+    digits[begin] = '\0';
+    do {
+        digits[--begin] = (char) ('0' + value % DECIMAL_BASE);
+        value /= DECIMAL_BASE;
+    } while (value > 0);
+
+    StatsAppend(buffer, used, name);
+    StatsAppend(buffer, used, digits + begin);
+}
+
+size_t StatsSnapshot(char *buffer, const StatsPolys *polys) {
+    size_t used = 0;
+    buffer[0] = '\0';
+
+    StatsAppend(buffer, &used, "{\"command\": \"");
+    StatsAppend(buffer, &used,
+                CommandName((CommandType) atomic_load(&current_type)));
+    StatsAppendNumber(buffer, &used, "\", \"line\": ",
+                      atomic_load(&current_line));
+    StatsAppendNumber(buffer, &used, ", \"depth\": ",
+                      atomic_load(&current_depth));
+
+    if (polys != NULL) {
+        StatsAppendNumber(buffer, &used, ", \"nodes\": ", polys->nodes);
+        StatsAppendNumber(buffer, &used, ", \"poly_bytes\": ", polys->bytes);
+    }
+    if (enabled) {
+        MemCounters memory = MemTotalCounters();
+        StatsAppendNumber(buffer, &used, ", \"live_blocks\": ",
+                          memory.allocs - memory.frees);
+        StatsAppendNumber(buffer, &used, ", \"live_bytes\": ",
+                          memory.bytes_allocated - memory.bytes_freed);
+        StatsAppendNumber(buffer, &used, ", \"peak_bytes\": ",
+                          memory.peak_bytes);
+        StatsAppendNumber(buffer, &used, ", \"allocs\": ", memory.allocs);
+        StatsAppendNumber(buffer, &used, ", \"reallocs\": ",
+                          memory.reallocs);
+        StatsAppendNumber(buffer, &used, ", \"frees\": ", memory.frees);
+    }
+    StatsAppend(buffer, &used, "}\n");
+    return used;
+}
+
+/**
+ * Handler of SIGUSR1, writes a snapshot to the standard error stream.
+ * @param signal : number of the signal
+ */
+static void StatsSignalHandler(int signal) {
+    (void) signal;
+    char buffer[STATS_SNAPSHOT_SIZE];
+    size_t len = StatsSnapshot(buffer, NULL);
+
+    ssize_t written = write(STDERR_FILENO, buffer, len);
+    (void) written;
+}
+
+void StatsHandleSignals(void) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = StatsSignalHandler;
+    action.sa_flags = SA_RESTART;   // reading the input goes on
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGUSR1, &action, NULL);
+}
+
+/**
+ * Computes the histogram bucket of a time.
+ * @param ns : time in nanoseconds
+ * @return index of the bucket
+ */
+static size_t StatsBucket(uint64_t ns) {
+    size_t bucket = 0;
+    while (ns > 1 && bucket + 1 < STATS_BUCKETS) {
+        ns >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/**
+ * Adds a value to a counter.
+ * @param counter : counter
+ * @param value : value to add
+ */
+static void StatsAdd(atomic_uint_least64_t *counter, uint64_t value) {
+    atomic_fetch_add_explicit(counter, value, memory_order_relaxed);
+}
+
+/**
+ * Raises a counter to a value if it is lower.
+ * @param counter : counter
+ * @param value : value
+ */
+static void StatsRaise(atomic_uint_least64_t *counter, uint64_t value) {
+    uint64_t max = atomic_load_explicit(counter, memory_order_relaxed);
+    while (value > max
+           && !atomic_compare_exchange_weak_explicit(counter, &max, value,
+                                                     memory_order_relaxed,
+                                                     memory_order_relaxed)) {
+    }
+}
+
+void StatsRead(uint64_t ns, size_t bytes) {
+    StatsAdd(&read_ns, ns);
+    StatsAdd(&read_lines, 1);
+    StatsAdd(&read_bytes, bytes);
+}
+
+void StatsRecord(CommandType type, const StatsSample *sample) {
+    StatsEntry *entry = &entries[type];
+
+    StatsAdd(&entry->count, 1);
+    StatsAdd(&entry->total_ns, sample->ns);
+    StatsAdd(&entry->terms_in, sample->terms_in);
+    StatsAdd(&entry->terms_out, sample->terms_out);
+    StatsAdd(&entry->allocs, sample->allocs);
+    StatsAdd(&entry->histogram[StatsBucket(sample->ns)], 1);
+    StatsRaise(&entry->max_ns, sample->ns);
+    StatsRaise(&entry->peak_bytes, sample->peak_bytes);
+
+    if (trace != NULL) {
+        fprintf(trace, "%zu,%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%zu,%"
+                PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", sample->line_number,
+                CommandName(type), sample->ns, sample->cpu_ns,
+                sample->terms_in, sample->depth_in, sample->terms_out,
+                sample->bytes_allocated, sample->bytes_freed);
+    }
+
+    if (sample->profiled) {
+        StatsAdd(&entry->profiled, 1);
+        StatsAdd(&entry->cycles, sample->perf.cycles);
+        StatsAdd(&entry->instructions, sample->perf.instructions);
+        StatsAdd(&entry->cache_misses, sample->perf.cache_misses);
+        StatsAdd(&entry->branch_misses, sample->perf.branch_misses);
+    }
+}
+
+/**
+ * Writes the latency histogram of a type of commands, without the trailing
+ * empty buckets.
+ * @param file : file to write to
+ * @param entry : recorded data of the type
+ */
+static void StatsWriteHistogram(FILE *file, StatsEntry *entry) {
+    size_t used = STATS_BUCKETS;
+    while (used > 0 && atomic_load(&entry->histogram[used - 1]) == 0) {
+        used--;
+    }
+
+    fprintf(file, "[");
+    for (size_t i = 0; i < used; i++) {
+        fprintf(file, "%s%" PRIu64, i > 0 ? ", " : "",
+                (uint64_t) atomic_load(&entry->histogram[i]));
+    }
+    fprintf(file, "]");
+}
+
+void StatsWrite(FILE *file) {
+    bool first = true;
+    uint64_t execute_ns = 0;
+
+    fprintf(file, "{\n  \"commands\": {");
+    for (size_t type = 0; type < CMD_TYPE_COUNT; type++) {
+        StatsEntry *entry = &entries[type];
+        if (atomic_load(&entry->count) == 0) {
+            continue;
+        }
+
+        fprintf(file, "%s\n    \"%s\": {\"count\": %" PRIu64
+                ", \"total_ns\": %" PRIu64 ", \"max_ns\": %" PRIu64
+                ", \"terms_in\": %" PRIu64 ", \"terms_out\": %" PRIu64
+                ", \"allocs\": %" PRIu64 ", \"peak_bytes\": %" PRIu64
+                ", \"histogram_ns\": ",
+                first ? "" : ",", CommandName((CommandType) type),
+                (uint64_t) atomic_load(&entry->count),
+                (uint64_t) atomic_load(&entry->total_ns),
+                (uint64_t) atomic_load(&entry->max_ns),
+                (uint64_t) atomic_load(&entry->terms_in),
+                (uint64_t) atomic_load(&entry->terms_out),
+                (uint64_t) atomic_load(&entry->allocs),
+                (uint64_t) atomic_load(&entry->peak_bytes));
+        execute_ns += atomic_load(&entry->total_ns);
+        StatsWriteHistogram(file, entry);
+        if (PerfEnabled()) {
+            fprintf(file, ", \"perf\": {\"profiled\": %" PRIu64
+                    ", \"cycles\": %" PRIu64 ", \"instructions\": %" PRIu64
+                    ", \"cache_misses\": %" PRIu64
+                    ", \"branch_misses\": %" PRIu64 "}",
+                    (uint64_t) atomic_load(&entry->profiled),
+                    (uint64_t) atomic_load(&entry->cycles),
+                    (uint64_t) atomic_load(&entry->instructions),
+                    (uint64_t) atomic_load(&entry->cache_misses),
+                    (uint64_t) atomic_load(&entry->branch_misses));
+        }
+        fprintf(file, "}");
+        first = false;
+    }
+
+    fprintf(file, "\n  },\n  \"phases\": {\"lines\": %" PRIu64
+            ", \"input_bytes\": %" PRIu64 ", \"read_ns\": %" PRIu64
+            ", \"execute_ns\": %" PRIu64 "}",
+            (uint64_t) atomic_load(&read_lines),
+            (uint64_t) atomic_load(&read_bytes),
+            (uint64_t) atomic_load(&read_ns), execute_ns);
+
+    MemCounters memory = MemTotalCounters();
+    fprintf(file, ",\n  \"memory\": {\"allocs\": %" PRIu64
+            ", \"reallocs\": %" PRIu64 ", \"frees\": %" PRIu64
+            ", \"bytes_allocated\": %" PRIu64 ", \"bytes_freed\": %" PRIu64
+            ", \"peak_bytes\": %" PRIu64 "}", memory.allocs,
+            memory.reallocs, memory.frees, memory.bytes_allocated,
+            memory.bytes_freed, memory.peak_bytes);
+#ifdef ALLOC_PROFILE
+    fprintf(file, ",\n  \"alloc_sites\": ");
+    MemWriteProfile(file);
+#endif
+    fprintf(file, "\n}\n");
+}
@@ -0,0 +1,153 @@
+/** @file
+  Interface of the calculator's instrumentation.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "command.h"
+#include "perf.h"
+
+/// Number of buckets of a latency histogram. Bucket @f$i@f$ counts commands
+/// which took from @f$2^i@f$ to @f$2^{i+1} - 1@f$ nanoseconds, the last one
+/// also all of the longer ones.
+#define STATS_BUCKETS 40
+
+/**
+ * Data measured for a single executed command.
+ */
+typedef struct StatsSample {
+    size_t line_number;     ///< line of the command
+    uint64_t ns;            ///< time of the execution in nanoseconds
+    uint64_t cpu_ns;        ///< CPU time of the thread in nanoseconds
+    uint64_t terms_in;      ///< terms of the polynomials it reads or takes
+    size_t depth_in;        ///< highest depth of them, if tracing
+    uint64_t terms_out;     ///< terms of the polynomials left by it
+    uint64_t allocs;        ///< allocations and reallocations done by it
+    uint64_t bytes_allocated;   ///< bytes allocated by it
+    uint64_t bytes_freed;   ///< bytes freed by it
+    uint64_t peak_bytes;    ///< highest number of live bytes meanwhile
+    bool profiled;          ///< were hardware counters read
+    PerfSample perf;        ///< growth of the counters, if they were read
+} StatsSample;
+
+/**
+ * @brief Turns on the instrumentation, together with counting allocations.
+ * @details It should be called before any other thread is started. Until
+ * then executing a command costs a single branch more.
+ */
+void StatsEnable(void);
+
+/**
+ * Tells whether the instrumentation is turned on.
+ * @return is it turned on
+ */
+bool StatsEnabled(void);
+
+/**
+ * @brief Opens a file for the execution trace and turns on
+ * the instrumentation.
+ * @details Every recorded command adds a CSV line to the trace: its line,
+ * name, wall and CPU time in nanoseconds, terms and highest depth of
+ * the polynomials it takes, terms of the ones it leaves and bytes
+ * it allocates and frees. The trace is buffered, so it is cheap to write.
+ * It should be called before any other thread is started.
+ * @param path : path of the file
+ * @return could the file be opened
+ */
+bool StatsTraceOpen(const char *path);
+
+/**
+ * Tells whether the execution is traced.
+ * @return is it traced
+ */
+bool StatsTracing(void);
+
+/**
+ * Closes the file of the execution trace if it is open.
+ */
+void StatsTraceClose(void);
+
+/**
+ * Reads a monotonic clock.
+ * @return time in nanoseconds
+ */
+uint64_t StatsNow(void);
+
+/**
+ * Reads the CPU time of the calling thread.
+ * @return time in nanoseconds
+ */
+uint64_t StatsCpuNow(void);
+
+/// Size of a buffer big enough for a snapshot of the calculator.
+#define STATS_SNAPSHOT_SIZE 512
+
+/**
+ * Records reading and parsing a single line of the input. It may be called
+ * from many threads.
+ * @param ns : time of reading and parsing it in nanoseconds
+ * @param bytes : length of the line
+ */
+void StatsRead(uint64_t ns, size_t bytes);
+
+/**
+ * Publishes the command that is being started, for snapshots.
+ * It may be called from many threads, the last call wins.
+ * @param type : type of the command
+ * @param line_number : number of its line
+ * @param depth : size of the stack it is executed on
+ */
+void StatsBegin(CommandType type, size_t line_number, size_t depth);
+
+/**
+ * Sizes of the polynomials of a stack, for snapshots.
+ */
+typedef struct StatsPolys {
+    uint64_t nodes;         ///< monomials on all levels of representations
+    uint64_t bytes;         ///< bytes taken by them
+} StatsPolys;
+
+/**
+ * @brief Writes a snapshot of the calculator as a single line of JSON.
+ * @details It contains the last started command, its line and stack depth,
+ * the sizes of the polynomials of the stack if they are given, and if
+ * allocations are counted (only with the instrumentation turned on, as
+ * counting costs atomic operations on every allocation), the number of
+ * live allocated blocks, the number of their bytes, its high-water mark
+ * and the totals of the allocator. It is async-signal-safe, so it may be
+ * used by a signal handler.
+ * @param buffer : buffer of at least #STATS_SNAPSHOT_SIZE bytes
+ * @param[in] polys : sizes of the polynomials of the stack, or NULL if they
+ * are not known, like in a signal handler
+ * @return length of the snapshot, without the terminating null char
+ */
+size_t StatsSnapshot(char *buffer, const StatsPolys *polys);
+
+/**
+ * Installs a handler of SIGUSR1 which writes a snapshot to the standard
+ * error stream.
+ */
+void StatsHandleSignals(void);
+
+/**
+ * Records a single executed command, and traces it if the execution is
+ * traced. It may be called from many threads.
+ * @param type : type of the command
+ * @param sample : measured data
+ */
+void StatsRecord(CommandType type, const StatsSample *sample);
+
+/**
+ * Writes the recorded data as a JSON object.
+ * @param file : file to write to
+ */
+void StatsWrite(FILE *file);
+
+#endif //STATS_H
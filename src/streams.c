@@ -0,0 +1,36 @@
+/** @file
+  Implementation of the calculator's input and output streams.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#include "streams.h"
+
+/// Input stream of the current thread, NULL means stdin.
+static _Thread_local FILE *input_stream = NULL;
+
+/// Output stream of the current thread, NULL means stdout.
+static _Thread_local FILE *output_stream = NULL;
+
+/// Error stream of the current thread, NULL means stderr.
+static _Thread_local FILE *error_stream = NULL;
+
+void SetStreams(FILE *in, FILE *out, FILE *err) {
+    input_stream = in;
+    output_stream = out;
+    error_stream = err;
+}
+
+FILE *InputStream(void) {
+    return input_stream != NULL ? input_stream : stdin;
+}
+
+FILE *OutputStream(void) {
+    return output_stream != NULL ? output_stream : stdout;
+}
+
+FILE *ErrorStream(void) {
+    return error_stream != NULL ? error_stream : stderr;
+}
@@ -0,0 +1,42 @@
+/** @file
+  Interface of the calculator's input and output streams.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef STREAMS_H
+#define STREAMS_H
+
+#include <stdio.h>
+
+/**
+ * @brief Sets streams that the calculator uses in the calling thread.
+ * @details Streams are stored per thread, so every worker of the batch mode
+ * can run its own script. Passing NULL restores the standard stream.
+ * @param in : stream from which commands are read
+ * @param out : stream to which results are printed
+ * @param err : stream to which error messages are printed
+ */
+void SetStreams(FILE *in, FILE *out, FILE *err);
+
+/**
+ * Returns the stream from which the calling thread reads commands.
+ * @return input stream (stdin by default)
+ */
+FILE *InputStream(void);
+
+/**
+ * Returns the stream to which the calling thread prints results.
+ * @return output stream (stdout by default)
+ */
+FILE *OutputStream(void);
+
+/**
+ * Returns the stream to which the calling thread prints error messages.
+ * @return error stream (stderr by default)
+ */
+FILE *ErrorStream(void);
+
+#endif //STREAMS_H
@@ -0,0 +1,309 @@
+/** @file
+  Implementation of recording workloads of the calculator and of replaying
+  them as synthetic scripts.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef _POSIX_C_SOURCE
+/// Directive necessary for getline to work.
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "error_handler.h"
+#include "generator.h"
+#include "input_output.h"
+#include "shape.h"
+#include "workload.h"
+
+/// First line of a record.
+#define RECORD_HEADER "# poly workload record\n"
+
+/// Tag of a recorded line of a command.
+#define COMMAND_TAG 'C'
+
+/// Tag of a recorded polynomial literal.
+#define POLY_TAG 'P'
+
+/// Tag of a recorded literal which is not a valid polynomial.
+#define WRONG_POLY_TAG 'E'
+
+/// Line which replaces literals which are not valid polynomials.
+#define WRONG_POLY_LINE "(1,-1)\n"
+
+/// Highest depth of a replayed polynomial.
+#define MAX_DEPTH 4096
+
+/// Highest bit length of a replayed coefficient.
+#define MAX_BITS 63
+
+/// Base of numbers of a record.
+#define DECIMAL_BASE 10
+
+/// File of the record or NULL.
+static FILE *record = NULL;
+
+/**
+ * Recorded shape of a single level of a literal, counted down while
+ * the literal is written.
+ */
+typedef struct ReplayLevel {
+    uint64_t polys;         ///< polynomials left to write
+    uint64_t monos;         ///< monomials left to give to them
+    uint64_t coeffs;        ///< monomials whose coefficients are not chosen
+    poly_exp_t max_exp;     ///< highest exponent
+    bool reached;           ///< was the highest exponent written
+} ReplayLevel;
+
+/**
+ * State of replaying a record.
+ */
+typedef struct Replay {
+    Generator gen;          ///< random generator
+    FILE *script;           ///< file for the script
+    size_t depth;           ///< depth of the current literal
+    unsigned min_bits;      ///< lowest bit length of its coefficients
+    unsigned max_bits;      ///< highest bit length of its coefficients
+    ReplayLevel *levels;    ///< its levels
+    size_t reserved;        ///< amount of reserved space for levels
+} Replay;
+
+bool WorkloadRecordOpen(const char *path) {
+    record = fopen(path, "w");
+    if (record == NULL) {
+        return false;
+    }
+
+    fputs(RECORD_HEADER, record);
+    return true;
+}
+
+bool WorkloadRecording(void) {
+    return record != NULL;
+}
+
+/**
+ * Records the shape of a polynomial literal.
+ * @param[in] p : polynomial
+ */
+static void WorkloadRecordPoly(const Poly *p) {
+    PolyShape shape = ShapeOf(p);
+    size_t min_bits = 0, max_bits = 0;
+
+    for (size_t bits = 0; bits < SHAPE_BIT_BUCKETS; bits++) {
+        if (shape.coeff_bits[bits] > 0) {
+            if (min_bits == 0) {
+                min_bits = bits;
+            }
+            max_bits = bits;
+        }
+    }
+
+    fprintf(record, "%c %zu %zu %zu", POLY_TAG, shape.depth, min_bits,
+            max_bits);
+    for (size_t i = 0; i < shape.depth; i++) {
+        fprintf(record, " %zu %zu %d", shape.levels[i].polys,
+                shape.levels[i].monos, shape.levels[i].max_exp);
+    }
+    fputc('\n', record);
+    ShapeDestroy(&shape);
+}
+
+void WorkloadRecord(const Command *cmd, const char *line) {
+    if (cmd->type == CMD_POLY) {
+        WorkloadRecordPoly(&cmd->poly);
+    }
+    else if (cmd->type == CMD_ERROR && cmd->error_code == WRONG_POLY_CODE) {
+        fprintf(record, "%c\n", WRONG_POLY_TAG);
+    }
+    else {
+        size_t length = strcspn(line, "\n");
+        fprintf(record, "%c %.*s\n", COMMAND_TAG, (int) length, line);
+    }
+}
+
+void WorkloadRecordClose(void) {
+    if (record != NULL) {
+        fclose(record);
+        record = NULL;
+    }
+}
+
+/**
+ * Writes a random nonzero coefficient with the recorded bit length.
+ * @param replay : state of replaying
+ */
+static void ReplayCoeff(Replay *replay) {
+    unsigned bits = (unsigned) GenRange(&replay->gen, replay->min_bits,
+                                        replay->max_bits);
+    uint64_t top = 1ull << (bits - 1);
+    poly_coeff_t coeff = (poly_coeff_t) (top | (GenRandom(&replay->gen)
+                                                & (top - 1)));
+
+    fprintf(replay->script, "%ld",
+            GenRandom(&replay->gen) & 1 ? -coeff : coeff);
+}
+
+/**
+ * Writes a random polynomial of a level of the recorded shape. Monomials
+ * and non-constant coefficients are dealt out so that the whole literal
+ * has as many of them on each level as the recorded one, and the first
+ * polynomial of a level gets its highest exponent.
+ * @param replay : state of replaying
+ * @param level : level of the polynomial, lower than the depth
+ */
+static void ReplayPoly(Replay *replay, size_t level) {
+    ReplayLevel *shape = &replay->levels[level];
+    uint64_t count = shape->monos;
+
+    if (shape->polys > 1) {
+        count = GenRound(&replay->gen, (double) shape->monos
+                                       / (double) shape->polys);
+        if (count + shape->polys - 1 > shape->monos) {
+            count = shape->monos - (shape->polys - 1);
+        }
+    }
+    if (count == 0) {
+        count = 1;
+    }
+    if (count > (uint64_t) shape->max_exp + 1) {
+        count = (uint64_t) shape->max_exp + 1;
+    }
+    shape->polys -= shape->polys > 0;
+    shape->monos -= count < shape->monos ? count : shape->monos;
+
+    poly_exp_t *exps = malloc(count * sizeof(poly_exp_t));
+    CHECK_PTR(exps);
+    if (!shape->reached) {
+        if (count > 1) {
+            GenExps(&replay->gen, exps, count - 1, 0, shape->max_exp - 1);
+        }
+        exps[count - 1] = shape->max_exp;
+        shape->reached = true;
+    } else {    // a lone x^0 would be read as its coefficient
+        GenExps(&replay->gen, exps, count,
+                count == 1 && shape->max_exp > 0 ? 1 : 0, shape->max_exp);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        fputs(i == 0 ? "(" : "+(", replay->script);
+        if (level + 1 < replay->depth && shape->coeffs > 0
+            && GenRandom(&replay->gen) % shape->coeffs
+               < replay->levels[level + 1].polys) {
+            shape->coeffs--;
+            ReplayPoly(replay, level + 1);
+        } else {
+            shape->coeffs -= shape->coeffs > 0;
+            ReplayCoeff(replay);
+        }
+        fprintf(replay->script, ",%d)", exps[i]);
+    }
+    free(exps);
+}
+
+/**
+ * Reads a number of a record.
+ * @param string : place of the number, moved past it
+ * @param max : highest valid value
+ * @param value : place for the number
+ * @return is the number valid
+ */
+static bool ReplayNumber(char **string, uint64_t max, uint64_t *value) {
+    char *last;
+
+    if (**string != ' ') {
+        return false;
+    }
+    errno = 0;
+    *value = strtoull(*string + 1, &last, DECIMAL_BASE);
+    if (errno != 0 || last == *string + 1 || *value > max) {
+        return false;
+    }
+    *string = last;
+    return true;
+}
+
+/**
+ * Reads a recorded shape of a literal and writes a random polynomial of it.
+ * @param replay : state of replaying
+ * @param line : recorded shape, after the tag
+ * @return is the shape valid
+ */
+static bool ReplayLiteral(Replay *replay, char *line) {
+    uint64_t depth, min_bits, max_bits;
+
+    if (!ReplayNumber(&line, MAX_DEPTH, &depth)
+        || !ReplayNumber(&line, SHAPE_BIT_BUCKETS - 1, &min_bits)
+        || !ReplayNumber(&line, SHAPE_BIT_BUCKETS - 1, &max_bits)
+        || min_bits > max_bits || (min_bits == 0) != (max_bits == 0)
+        || (depth > 0 && max_bits == 0)) {
+        return false;
+    }
+
+    if (depth > replay->reserved) {
+        replay->reserved = depth;
+        replay->levels = realloc(replay->levels,
+                                 depth * sizeof(ReplayLevel));
+        CHECK_PTR(replay->levels);
+    }
+    replay->depth = depth;
+    replay->min_bits = min_bits < MAX_BITS ? (unsigned) min_bits : MAX_BITS;
+    replay->max_bits = max_bits < MAX_BITS ? (unsigned) max_bits : MAX_BITS;
+
+    uint64_t previous_monos = 1;
+    for (size_t i = 0; i < depth; i++) {
+        uint64_t polys, monos, max_exp;
+        if (!ReplayNumber(&line, SIZE_MAX, &polys)
+            || !ReplayNumber(&line, SIZE_MAX, &monos)
+            || !ReplayNumber(&line, INT_MAX, &max_exp)
+            || polys == 0 || monos < polys || polys > previous_monos) {
+            return false;
+        }
+        replay->levels[i] = (ReplayLevel) {
+            .polys = polys, .monos = monos, .coeffs = monos,
+            .max_exp = (poly_exp_t) max_exp, .reached = false};
+        previous_monos = monos;
+    }
+    if (*line != '\n' && *line != NULL_CHAR) {
+        return false;
+    }
+
+    if (depth > 0) {
+        ReplayPoly(replay, 0);
+    } else if (max_bits > 0) {
+        ReplayCoeff(replay);
+    } else {
+        fputc('0', replay->script);
+    }
+    fputc('\n', replay->script);
+    return true;
+}
+
+bool WorkloadReplay(FILE *record, FILE *script, uint64_t seed) {
+    Replay replay = {.script = script, .depth = 0, .levels = NULL,
+                     .reserved = 0};
+    GenInit(&replay.gen, seed);
+    char *line = NULL;
+    size_t size = 0;
+    bool valid = getline(&line, &size, record) != -1
+                 && strcmp(line, RECORD_HEADER) == 0;
+
+    while (valid && getline(&line, &size, record) != -1) {
+        if (line[0] == COMMAND_TAG && line[1] == ' ') {
+            fputs(line + 2, script);
+        } else if (line[0] == WRONG_POLY_TAG && line[1] == '\n') {
+            fputs(WRONG_POLY_LINE, script);
+        } else {
+            valid = line[0] == POLY_TAG && ReplayLiteral(&replay, line + 1);
+        }
+    }
+
+    free(replay.levels);
+    free(line);
+    return valid;
+}
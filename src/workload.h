@@ -0,0 +1,62 @@
+/** @file
+  Interface of recording workloads of the calculator and of replaying them
+  as synthetic scripts.
+
+  @author Adam Al-Hosam <aa429136@students.mimuw.edu.pl>
+  @copyright Uniwersytet Warszawski
+  @date 2021
+*/
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "command.h"
+
+/**
+ * @brief Opens a file for the record of the workload.
+ * @details The record keeps every read line, so the command stream (with
+ * loops and macros) and the line numbers stay the same. Lines of commands
+ * are kept as they are, while polynomial literals are replaced by their
+ * shape: depth, range of bit lengths of coefficients and for each level
+ * the numbers of polynomials and monomials and the highest exponent.
+ * A record of a large script is therefore small.
+ * @param path : path of the file
+ * @return could the file be opened
+ */
+bool WorkloadRecordOpen(const char *path);
+
+/**
+ * Tells whether the workload is recorded.
+ * @return is it recorded
+ */
+bool WorkloadRecording(void);
+
+/**
+ * Records a single read line.
+ * @param[in] cmd : command parsed from the line
+ * @param[in] line : the line
+ */
+void WorkloadRecord(const Command *cmd, const char *line);
+
+/**
+ * Closes the file of the record if it is open.
+ */
+void WorkloadRecordClose(void);
+
+/**
+ * Synthesizes a script from a record. Lines of commands are written as
+ * they were and every literal is replaced by a random polynomial with
+ * the recorded shape, so the script has the same command mix, stack
+ * behaviour and shapes of polynomials as the recorded one. The same seed
+ * always gives the same script.
+ * @param record : record of a workload
+ * @param script : file for the script
+ * @param seed : seed of the random generator
+ * @return false if the record is not valid
+ */
+bool WorkloadReplay(FILE *record, FILE *script, uint64_t seed);
+
+#endif //WORKLOAD_H